@@ -1,6 +1,8 @@
 #include "stdafx.h"
 #include "Animation.h"
 
+#include <algorithm>
+
 namespace happy
 {
 	void Animation::setAnimation(const RenderingContext *pRenderContext, const vector<bb::mat4> &animation, const unsigned bones, const unsigned frames, const float framerate)
@@ -53,6 +55,22 @@ namespace happy
 		m_Looping = looping;
 	}
 
+	void Animation::setEvents(vector<AnimationEvent> events)
+	{
+		std::stable_sort(events.begin(), events.end(), [](const AnimationEvent &a, const AnimationEvent &b)
+		{
+			return a.m_Time < b.m_Time;
+		});
+
+		m_pEvents = make_shared<const vector<AnimationEvent>>(std::move(events));
+	}
+
+	void Animation::setRootMotion(const vector<bb::vec3> &positions)
+	{
+		// one root position per frame, in the same space as the bone matrices
+		m_pRootMotion = make_shared<const vector<bb::vec3>>(positions);
+	}
+
 	ID3D11Buffer* Animation::getFrame0(float time) const
 	{
 		unsigned frame = (unsigned)floorf(time * m_FrameRate);
@@ -75,4 +93,112 @@ namespace happy
 	{
 		return (time * m_FrameRate) - floorf(time * m_FrameRate);
 	}
+
+	float Animation::getDuration() const
+	{
+		// looping clips blend the last frame back into the first, clamped clips stop on the last frame
+		if (m_Looping) return m_pFrames->size() / m_FrameRate;
+		else           return (m_pFrames->size() - 1) / m_FrameRate;
+	}
+
+	void Animation::getEvents(float from, float to, vector<const AnimationEvent*> &events, bool includeFrom) const
+	{
+		if (!m_pEvents || m_pEvents->empty()) return;
+
+		if (from <= to)
+		{
+			getEventsForward(from, to, events, includeFrom);
+		}
+		else
+		{
+			// playing backwards crosses the same events in reverse order, from is the closed end already
+			size_t first = events.size();
+			getEventsForward(to, from, events, false);
+			std::reverse(events.begin() + first, events.end());
+		}
+	}
+
+	bb::vec3 Animation::getRootMotion(float from, float to) const
+	{
+		if (!m_pRootMotion || m_pRootMotion->empty()) return bb::vec3(0, 0, 0);
+
+		return getRootPosition(to) - getRootPosition(from);
+	}
+
+	void Animation::getEventsForward(float from, float to, vector<const AnimationEvent*> &events, bool includeFrom) const
+	{
+		auto &clip = *m_pEvents.get();
+		auto before = [](float time, const AnimationEvent &e) { return time < e.m_Time; };
+		auto start = [&](float time)
+		{
+			if (includeFrom) return std::lower_bound(clip.begin(), clip.end(), time, [](const AnimationEvent &e, float t) { return e.m_Time < t; });
+			return std::upper_bound(clip.begin(), clip.end(), time, before);
+		};
+		auto append = [&](vector<AnimationEvent>::const_iterator first, vector<AnimationEvent>::const_iterator last)
+		{
+			for (; first != last; ++first) events.push_back(&*first);
+		};
+
+		float duration = getDuration();
+
+		if (!m_Looping || duration <= 0)
+		{
+			from = max(0.0f, min(duration, from));
+			to = max(0.0f, min(duration, to));
+			append(start(from), std::upper_bound(clip.begin(), clip.end(), to, before));
+			return;
+		}
+
+		float cycleFrom = floorf(from / duration);
+		float cycleTo = floorf(to / duration);
+		float localFrom = from - cycleFrom * duration;
+		float localTo = to - cycleTo * duration;
+
+		if (cycleFrom == cycleTo)
+		{
+			append(start(localFrom), std::upper_bound(clip.begin(), clip.end(), localTo, before));
+			return;
+		}
+
+		// tail of the first cycle, every complete cycle in between, head of the last cycle
+		append(start(localFrom), clip.end());
+		for (float cycle = cycleFrom + 1; cycle < cycleTo; ++cycle)
+		{
+			append(clip.begin(), clip.end());
+		}
+		append(clip.begin(), std::upper_bound(clip.begin(), clip.end(), localTo, before));
+	}
+
+	bb::vec3 Animation::getRootPosition(float time) const
+	{
+		auto &root = *m_pRootMotion.get();
+		float duration = getDuration();
+		float cycles = 0;
+
+		if (m_Looping && duration > 0)
+		{
+			cycles = floorf(time / duration);
+			time -= cycles * duration;
+		}
+		else
+		{
+			time = max(0.0f, min(duration, time));
+		}
+
+		float frame = time * m_FrameRate;
+		unsigned count = (unsigned)root.size();
+		unsigned frame0 = min(count - 1, (unsigned)floorf(frame));
+		float blend = frame - floorf(frame);
+
+		if (!m_Looping || duration <= 0)
+		{
+			return bb::lerp(root[frame0], root[min(count - 1, frame0 + 1)], blend);
+		}
+
+		// like the poses, the last frame blends into the first one of the next cycle. That step moves the root at
+		//  the clip's average speed, so every completed cycle advances it by cycleDelta.
+		bb::vec3 cycleDelta = count > 1 ? (root.back() - root.front()) * (count / (float)(count - 1)) : bb::vec3(0, 0, 0);
+		bb::vec3 next = frame0 + 1 < count ? root[frame0 + 1] : root.front() + cycleDelta;
+		return bb::lerp(root[frame0], next, blend) + cycleDelta * cycles;
+	}
 }
\ No newline at end of file
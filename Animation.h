@@ -5,20 +5,40 @@
 
 namespace happy
 {
+	struct AnimationEvent
+	{
+		float  m_Time;
+		string m_Name;
+	};
+
 	class Animation
 	{
 	public:
 		void setAnimation(const RenderingContext *pRenderContext, const vector<bb::mat4> &animation, const unsigned bones, const unsigned frames, const float framerate);
 		void setLooping(bool looping);
+		void setEvents(vector<AnimationEvent> events);
+		void setRootMotion(const vector<bb::vec3> &positions);
 
 		ID3D11Buffer* getFrame0(float time) const;
 		ID3D11Buffer* getFrame1(float time) const;
 		float         getFrameBlend(float time) const;
+		float         getDuration() const;
+
+		// Appends every event crossed in the clip time interval (from, to], in playback order.
+		// includeFrom closes the interval at from, for the first evaluation after the clip was started.
+		// Looping clips report an event once for every cycle the interval covers.
+		void          getEvents(float from, float to, vector<const AnimationEvent*> &events, bool includeFrom = false) const;
+		bb::vec3      getRootMotion(float from, float to) const;
 
 	private:
+		void          getEventsForward(float from, float to, vector<const AnimationEvent*> &events, bool includeFrom) const;
+		bb::vec3      getRootPosition(float time) const;
+
 		float m_FrameRate;
 		bool  m_Looping;
 
 		shared_ptr<vector<ComPtr<ID3D11Buffer>>> m_pFrames;
+		shared_ptr<const vector<AnimationEvent>> m_pEvents;
+		shared_ptr<const vector<bb::vec3>>       m_pRootMotion;
 	};
 }
\ No newline at end of file
@@ -17,6 +17,13 @@ namespace happy
 		return target;
 	}
 
+	template <typename State>
+	static float resolveClipTime(const State &state, system_clock::time_point time)
+	{
+		std::chrono::duration<float, std::ratio<1, 1>> timer(time - state.m_Timer);
+		return state.m_TimerOffset + timer.count() * state.m_SpeedMultiplier;
+	}
+
 	void MeshController::setMesh(shared_ptr<RenderMesh> mesh)
 	{
 		m_Mesh = mesh;
@@ -69,10 +76,13 @@ namespace happy
 		state.m_Blender = start;
 		state.m_Timer = start;
 		state.m_SpeedMultiplier = 1;
+		state.m_TimerOffset = 0;
 		state.m_BlendDuration = 0;
 		state.m_BlendSource = 0;
 		state.m_BlendTarget = 0;
+		state.m_EvaluatedTime = 0;
 		state.m_Looped = false;
+		state.m_Evaluated = false;
 
 		m_States.push_back(state);
 		return (int)(m_States.size() - 1);
@@ -90,6 +100,11 @@ namespace happy
 	void MeshController::setAnimationTimer(int id, system_clock::time_point start, system_clock::duration offset)
 	{
 		m_States[id].m_Timer = start - offset;
+		m_States[id].m_TimerOffset = 0;
+
+		// the clip was moved explicitly, don't report events for the skipped part but do for the start itself
+		m_States[id].m_EvaluatedTime = resolveClipTime(m_States[id], start);
+		m_States[id].m_Evaluated = false;
 	}
 
 	void MeshController::setAnimationBlend(int id, float blend, system_clock::time_point start, float duration)
@@ -102,9 +117,19 @@ namespace happy
 		s.m_BlendDuration = duration;
 	}
 
+	void MeshController::setAnimationSpeed(int id, float multiplier, system_clock::time_point time)
+	{
+		auto &s = m_States[id];
+
+		// the clip continues from where it is at time, only the rate changes
+		s.m_TimerOffset = resolveClipTime(s, time);
+		s.m_Timer = time;
+		s.m_SpeedMultiplier = multiplier;
+	}
+
 	void MeshController::setAnimationSpeed(int id, float multiplier)
 	{
-		m_States[id].m_SpeedMultiplier = multiplier;
+		setAnimationSpeed(id, multiplier, system_clock::now());
 	}
 
 	void MeshController::resetAllAnimationBlends(system_clock::time_point start, float duration)
@@ -145,23 +170,58 @@ namespace happy
 
 		m_RenderItem.m_AnimationCount = min(2, (unsigned)influences.size());
 		float total = 0;
+		for (unsigned a = 0; a < m_RenderItem.m_AnimationCount; ++a)
+		{
+			total += influences[a].second;
+		}
+
+		m_TriggeredEvents.clear();
+		m_RootMotion = bb::vec3(0, 0, 0);
+
 		for (unsigned a = 0; a < m_RenderItem.m_AnimationCount; ++a)
 		{
 			auto &state = m_States[influences[a].first];
-			std::chrono::duration<float, std::ratio<1, 1>> timer(time - state.m_Timer);
 
-			float x = timer.count() * state.m_SpeedMultiplier;
+			float x = resolveClipTime(state, time);
 			m_RenderItem.m_CurrentFrames[a * 2 + 0] = state.m_Anim.getFrame0(x);
 			m_RenderItem.m_CurrentFrames[a * 2 + 1] = state.m_Anim.getFrame1(x);
 			m_RenderItem.m_CurrentBlendFrame[a] = state.m_Anim.getFrameBlend(x);
 
 			m_RenderItem.m_CurrentBlendAnimation[a] = influences[a].second;
-			total += influences[a].second;
+
+			// the first update after the clip started covers the start too, e.g. an event on frame 0
+			float weight = influences[a].second / total;
+
+			m_EventScratch.clear();
+			state.m_Anim.getEvents(state.m_EvaluatedTime, x, m_EventScratch, !state.m_Evaluated);
+			for (auto e : m_EventScratch)
+			{
+				m_TriggeredEvents.push_back({ (int)influences[a].first, weight, e });
+			}
+
+			m_RootMotion += state.m_Anim.getRootMotion(state.m_EvaluatedTime, x) * weight;
+		}
+
+		// advance every clip, including the ones that are blended out, so they resume without a backlog
+		for (auto &state : m_States)
+		{
+			state.m_EvaluatedTime = resolveClipTime(state, time);
+			state.m_Evaluated = true;
 		}
 
 		m_RenderItem.m_CurrentBlendAnimation = m_RenderItem.m_CurrentBlendAnimation * (1.0f / total);
 	}
 
+	const vector<TriggeredAnimationEvent>& MeshController::getTriggeredEvents() const
+	{
+		return m_TriggeredEvents;
+	}
+
+	bb::vec3 MeshController::getRootMotion() const
+	{
+		return m_RootMotion;
+	}
+
 	void MeshController::render(RenderQueue_Root &queue) const
 	{
 		if (m_Static)
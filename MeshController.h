@@ -34,6 +34,13 @@ namespace happy
 		bb::mat4 m_CurrentWorld;
 	};
 
+	struct TriggeredAnimationEvent
+	{
+		int                   m_Animation;
+		float                 m_Weight;
+		const AnimationEvent* m_Event;
+	};
+
 	class MeshController
 	{
 	public:
@@ -47,6 +54,7 @@ namespace happy
 
 		void setAnimationTimer(int id, system_clock::time_point start, system_clock::duration offset);
 		void setAnimationBlend(int id, float blend, system_clock::time_point start, float duration = 0);
+		void setAnimationSpeed(int id, float multiplier, system_clock::time_point time);
 		void setAnimationSpeed(int id, float multiplier);
 		void resetAllAnimationBlends(system_clock::time_point start, float duration = 0);
 		bb::mat4 &worldMatrix();
@@ -54,6 +62,10 @@ namespace happy
 		void update(system_clock::time_point time);
 		void render(RenderQueue_Root &queue) const;
 
+		// Events and blended root displacement of the playing animations between the previous and the last update
+		const vector<TriggeredAnimationEvent>& getTriggeredEvents() const;
+		bb::vec3 getRootMotion() const;
+
 	private:
 		struct anim_state
 		{
@@ -65,11 +77,14 @@ namespace happy
 			system_clock::time_point m_Blender;
 
 			float m_SpeedMultiplier;
+			float m_TimerOffset;     // clip time at m_Timer
 			float m_BlendSource;
 			float m_BlendTarget;
 			float m_BlendDuration;
+			float m_EvaluatedTime;   // clip time of the last update, or the start before the first one
 
 			bool m_Looped;
+			bool m_Evaluated;
 		};
 
 		shared_ptr<RenderMesh> m_Mesh;
@@ -78,5 +93,9 @@ namespace happy
 
 		SkinRenderItem m_RenderItem;
 		vector<anim_state> m_States;
+
+		vector<TriggeredAnimationEvent> m_TriggeredEvents;
+		vector<const AnimationEvent*> m_EventScratch;
+		bb::vec3 m_RootMotion = bb::vec3(0, 0, 0);
 	};
 }
\ No newline at end of file
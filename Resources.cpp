@@ -150,7 +150,7 @@ namespace happy
 
 				if (table.exists("sources")) for (auto &v : table.getFieldL("sources"))
 				{
-					auto &source = v.d;
+					auto &source = v.d();
 					sources.push_back(TextureLayer());
 					
 					sources.back().m_path = fileBase / source.getFieldS("file");
@@ -0,0 +1,729 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BVH_SSE2
+#endif
+
+namespace bb
+{
+	namespace
+	{
+		const int      bins = 16;
+		const uint32_t leafSize = 4;        // always a leaf
+		const uint32_t maxLeafSize = 16;    // a leaf when splitting does not pay off
+		const uint32_t parallelSize = 4096; // subtrees at least this large may be built on their own thread
+		const unsigned maxSahDepth = 48;    // deeper nodes split at the median, which bounds the traversal stacks
+		const int      stackSize = 128;
+
+		struct bounds
+		{
+			float min[3] = { INFINITY, INFINITY, INFINITY };
+			float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+			void grow(const float *mn, const float *mx)
+			{
+				for (int i = 0; i < 3; ++i)
+				{
+					min[i] = std::min(min[i], mn[i]);
+					max[i] = std::max(max[i], mx[i]);
+				}
+			}
+
+			void grow(const bounds &b) { grow(b.min, b.max); }
+
+			float area() const
+			{
+				float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+				return x < 0 ? 0 : x * y + y * z + z * x;
+			}
+		};
+
+		struct primitive_info
+		{
+			bounds box;
+			float  centre[3];
+		};
+
+		// zero direction components get a tiny one instead, so the slab tests never compute 0 * infinity
+		float reciprocal(float d)
+		{
+			const float tiny = 1e-20f;
+			if (fabsf(d) < tiny) d = d < 0 ? -tiny : tiny;
+			return 1 / d;
+		}
+
+		// entry of the ray into a box if it is not after tFar, otherwise infinity
+		inline float slab(const float *o, const float *inv, const float *mn, const float *mx, float tFar)
+		{
+			float tNear = 0;
+			for (int i = 0; i < 3; ++i)
+			{
+				float t0 = (mn[i] - o[i]) * inv[i];
+				float t1 = (mx[i] - o[i]) * inv[i];
+				tNear = std::max(tNear, std::min(t0, t1));
+				tFar = std::min(tFar, std::max(t0, t1));
+			}
+			return tNear <= tFar ? tNear : INFINITY;
+		}
+
+		// Moller-Trumbore, two sided, infinity when missed
+		inline float triangle(const float *o, const float *d, const vec3 &a, const vec3 &b, const vec3 &c)
+		{
+			float e1x = b.x - a.x, e1y = b.y - a.y, e1z = b.z - a.z;
+			float e2x = c.x - a.x, e2y = c.y - a.y, e2z = c.z - a.z;
+
+			float px = d[1] * e2z - d[2] * e2y;
+			float py = d[2] * e2x - d[0] * e2z;
+			float pz = d[0] * e2y - d[1] * e2x;
+			float det = e1x * px + e1y * py + e1z * pz;
+			if (det == 0) return INFINITY;
+			float invDet = 1 / det;
+
+			float sx = o[0] - a.x, sy = o[1] - a.y, sz = o[2] - a.z;
+			float u = (sx * px + sy * py + sz * pz) * invDet;
+			if (!(u >= 0 && u <= 1)) return INFINITY;
+
+			float qx = sy * e1z - sz * e1y;
+			float qy = sz * e1x - sx * e1z;
+			float qz = sx * e1y - sy * e1x;
+			float v = (d[0] * qx + d[1] * qy + d[2] * qz) * invDet;
+			if (!(v >= 0 && u + v <= 1)) return INFINITY;
+
+			float t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+			return t >= 0 ? t : INFINITY;
+		}
+
+		inline bool closer(float t, uint32_t primitive, const bvh::hit &best)
+		{
+			return t < best.m_T || (t == best.m_T && primitive < best.m_Primitive);
+		}
+	}
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Build
+
+	struct bvh::build_task
+	{
+		std::vector<node>           &nodes;
+		std::vector<uint32_t>       &order;
+		std::vector<primitive_info> &info;
+		std::atomic<int>            spareThreads;
+
+		build_task(std::vector<node> &nodes, std::vector<uint32_t> &order, std::vector<primitive_info> &info, int spare)
+			: nodes(nodes), order(order), info(info), spareThreads(spare) { }
+
+		// The node at index gets the primitives begin..end. Its descendants use the 2 * count - 2 slots from
+		//  free: its two children first, then the slots of the left child's subtree, then the right one's.
+		//  The layout does not depend on which thread builds what.
+		void subdivide(uint32_t index, uint32_t begin, uint32_t end, uint32_t free, unsigned depth)
+		{
+			uint32_t count = end - begin;
+			bounds box, centres;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				const primitive_info &p = info[order[i]];
+				box.grow(p.box);
+				centres.grow(p.centre, p.centre);
+			}
+
+			node &n = nodes[index];
+			memcpy(n.m_Min, box.min, sizeof(n.m_Min));
+			memcpy(n.m_Max, box.max, sizeof(n.m_Max));
+			n.m_First = begin;
+			n.m_Count = count;
+
+			if (count <= leafSize) return;
+
+			uint32_t middle = depth < maxSahDepth ? split(begin, end, box, centres) : end;
+			if (middle == begin) return;
+
+			if (middle == end)
+			{
+				// no useful plane: halve along the longest axis of the centres
+				int axis = 0;
+				for (int i = 1; i < 3; ++i)
+					if (centres.max[i] - centres.min[i] > centres.max[axis] - centres.min[axis]) axis = i;
+
+				middle = begin + count / 2;
+				std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](uint32_t a, uint32_t b)
+				{
+					float ca = info[a].centre[axis], cb = info[b].centre[axis];
+					return ca < cb || (ca == cb && a < b);
+				});
+			}
+
+			uint32_t left = middle - begin;
+			n.m_First = free;
+			n.m_Count = 0;
+
+			uint32_t leftFree = free + 2;
+			uint32_t rightFree = leftFree + 2 * left - 2;
+
+			if (end - middle >= parallelSize && claimThread())
+			{
+				std::thread right(&build_task::subdivide, this, free + 1, middle, end, rightFree, depth + 1);
+				subdivide(free, begin, middle, leftFree, depth + 1);
+				right.join();
+				spareThreads.fetch_add(1);
+			}
+			else
+			{
+				subdivide(free, begin, middle, leftFree, depth + 1);
+				subdivide(free + 1, middle, end, rightFree, depth + 1);
+			}
+		}
+
+		bool claimThread()
+		{
+			if (spareThreads.fetch_sub(1) > 0) return true;
+			spareThreads.fetch_add(1);
+			return false;
+		}
+
+		// binned SAH over all three axes. Returns begin for a leaf, end when no bin boundary separates the
+		//  primitives, otherwise the partition point.
+		uint32_t split(uint32_t begin, uint32_t end, const bounds &box, const bounds &centres)
+		{
+			uint32_t count = end - begin;
+			float bestCost = INFINITY;
+			int bestAxis = -1, bestBin = 0;
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float extent = centres.max[axis] - centres.min[axis];
+				if (!(extent > 0)) continue;
+
+				float scale = bins / extent;
+				bounds binBox[bins];
+				uint32_t binCount[bins] = {};
+
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					const primitive_info &p = info[order[i]];
+					int b = std::min(bins - 1, (int)((p.centre[axis] - centres.min[axis]) * scale));
+					binBox[b].grow(p.box);
+					binCount[b]++;
+				}
+
+				// areas and counts right of every boundary, then sweep from the left
+				float rightArea[bins];
+				uint32_t rightCount[bins];
+				bounds acc;
+				uint32_t n = 0;
+				for (int b = bins - 1; b > 0; --b)
+				{
+					acc.grow(binBox[b]);
+					n += binCount[b];
+					rightArea[b] = acc.area();
+					rightCount[b] = n;
+				}
+
+				acc = bounds();
+				n = 0;
+				for (int b = 0; b < bins - 1; ++b)
+				{
+					acc.grow(binBox[b]);
+					n += binCount[b];
+					if (n == 0 || rightCount[b + 1] == 0) continue;
+
+					float cost = acc.area() * n + rightArea[b + 1] * rightCount[b + 1];
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = b;
+					}
+				}
+			}
+
+			if (bestAxis < 0) return count <= maxLeafSize ? begin : end;
+
+			// a traversal step costs about as much as one primitive test
+			if (count <= maxLeafSize && box.area() + bestCost >= box.area() * count) return begin;
+
+			float min = centres.min[bestAxis];
+			float scale = bins / (centres.max[bestAxis] - min);
+			auto middle = std::partition(order.begin() + begin, order.begin() + end, [&](uint32_t i)
+			{
+				return std::min(bins - 1, (int)((info[i].centre[bestAxis] - min) * scale)) <= bestBin;
+			});
+			return (uint32_t)(middle - order.begin());
+		}
+	};
+
+	void bvh::buildBoxes(const vec3 *a, const vec3 *b, size_t count, unsigned threads)
+	{
+		m_Triangles = false;
+		m_A.assign(a, a + count);
+		m_B.assign(b, b + count);
+		m_C.clear();
+		m_Indices.clear();
+		build(threads);
+	}
+
+	void bvh::buildTriangles(const vec3 *vertices, const uint32_t *indices, size_t count, unsigned threads)
+	{
+		m_Triangles = true;
+		m_Indices.assign(indices, indices + count * 3);
+		m_A.resize(count);
+		m_B.resize(count);
+		m_C.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			m_A[i] = vertices[indices[i * 3 + 0]];
+			m_B[i] = vertices[indices[i * 3 + 1]];
+			m_C[i] = vertices[indices[i * 3 + 2]];
+		}
+		build(threads);
+	}
+
+	void bvh::primitiveBounds(uint32_t primitive, float *min, float *max) const
+	{
+		const vec3 &a = m_A[primitive], &b = m_B[primitive];
+		if (!m_Triangles)
+		{
+			min[0] = a.x; min[1] = a.y; min[2] = a.z;
+			max[0] = b.x; max[1] = b.y; max[2] = b.z;
+			return;
+		}
+
+		const vec3 &c = m_C[primitive];
+		min[0] = std::min(std::min(a.x, b.x), c.x); max[0] = std::max(std::max(a.x, b.x), c.x);
+		min[1] = std::min(std::min(a.y, b.y), c.y); max[1] = std::max(std::max(a.y, b.y), c.y);
+		min[2] = std::min(std::min(a.z, b.z), c.z); max[2] = std::max(std::max(a.z, b.z), c.z);
+	}
+
+	void bvh::build(unsigned threads)
+	{
+		uint32_t count = (uint32_t)m_A.size();
+		m_Nodes.clear();
+		m_Order.resize(count);
+		if (!count) return;
+
+		std::vector<primitive_info> info(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			primitive_info &p = info[i];
+			primitiveBounds(i, p.box.min, p.box.max);
+			for (int k = 0; k < 3; ++k)
+				p.centre[k] = (p.box.min[k] + p.box.max[k]) / 2;
+			m_Order[i] = i;
+		}
+
+		std::vector<node> nodes(2 * count - 1);
+		build_task task(nodes, m_Order, info, (int)std::max(threads, 1u) - 1);
+		task.subdivide(0, 0, count, 1, 0);
+
+		// leaves leave slots unused, copy the tree breadth first without them so children follow their parents
+		m_Nodes.reserve(nodes.size());
+		m_Nodes.push_back(nodes[0]);
+		for (size_t i = 0; i < m_Nodes.size(); ++i)
+		{
+			if (m_Nodes[i].m_Count) continue;
+
+			uint32_t first = m_Nodes[i].m_First;
+			m_Nodes[i].m_First = (uint32_t)m_Nodes.size();
+			m_Nodes.push_back(nodes[first]);
+			m_Nodes.push_back(nodes[first + 1]);
+		}
+	}
+
+	void bvh::refitBoxes(const vec3 *a, const vec3 *b)
+	{
+		std::copy(a, a + m_A.size(), m_A.begin());
+		std::copy(b, b + m_B.size(), m_B.begin());
+		refit();
+	}
+
+	void bvh::refitTriangles(const vec3 *vertices)
+	{
+		for (size_t i = 0; i < m_A.size(); ++i)
+		{
+			m_A[i] = vertices[m_Indices[i * 3 + 0]];
+			m_B[i] = vertices[m_Indices[i * 3 + 1]];
+			m_C[i] = vertices[m_Indices[i * 3 + 2]];
+		}
+		refit();
+	}
+
+	void bvh::refit()
+	{
+		// children come after their parents
+		for (size_t i = m_Nodes.size(); i-- > 0;)
+		{
+			node &n = m_Nodes[i];
+			bounds box;
+
+			if (n.m_Count)
+			{
+				for (uint32_t k = 0; k < n.m_Count; ++k)
+				{
+					float mn[3], mx[3];
+					primitiveBounds(m_Order[n.m_First + k], mn, mx);
+					box.grow(mn, mx);
+				}
+			}
+			else
+			{
+				box.grow(m_Nodes[n.m_First].m_Min, m_Nodes[n.m_First].m_Max);
+				box.grow(m_Nodes[n.m_First + 1].m_Min, m_Nodes[n.m_First + 1].m_Max);
+			}
+
+			memcpy(n.m_Min, box.min, sizeof(n.m_Min));
+			memcpy(n.m_Max, box.max, sizeof(n.m_Max));
+		}
+	}
+
+	bool bvh::operator==(const bvh &other) const
+	{
+		return m_Nodes.size() == other.m_Nodes.size() && m_Order == other.m_Order &&
+			memcmp(m_Nodes.data(), other.m_Nodes.data(), m_Nodes.size() * sizeof(node)) == 0;
+	}
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Single rays
+
+	bool bvh::intersect(const ray &r, hit &result, float maxT) const
+	{
+		result = { none, maxT };
+		if (m_Nodes.empty()) return false;
+
+		const float o[3] = { r.p0.x, r.p0.y, r.p0.z };
+		const float d[3] = { r.p1.x - r.p0.x, r.p1.y - r.p0.y, r.p1.z - r.p0.z };
+		const float inv[3] = { reciprocal(d[0]), reciprocal(d[1]), reciprocal(d[2]) };
+
+		// nodes to visit with their entry, skipped when something closer was found meanwhile
+		uint32_t stack[stackSize];
+		float    stackT[stackSize];
+		int top = 0;
+
+		const node &root = m_Nodes[0];
+		float t = slab(o, inv, root.m_Min, root.m_Max, maxT);
+		if (t == INFINITY) return false;
+
+		stack[top] = 0;
+		stackT[top++] = t;
+
+		while (top)
+		{
+			--top;
+			if (stackT[top] > result.m_T) continue;
+			const node *n = &m_Nodes[stack[top]];
+
+			for (;;)
+			{
+				if (n->m_Count)
+				{
+					for (uint32_t k = 0; k < n->m_Count; ++k)
+					{
+						uint32_t p = m_Order[n->m_First + k];
+						float tp = m_Triangles
+							? triangle(o, d, m_A[p], m_B[p], m_C[p])
+							: slab(o, inv, &m_A[p].x, &m_B[p].x, result.m_T);
+
+						if (tp < INFINITY && tp <= maxT && closer(tp, p, result))
+							result = { p, tp };
+					}
+					break;
+				}
+
+				const node *c0 = &m_Nodes[n->m_First], *c1 = c0 + 1;
+				float t0 = slab(o, inv, c0->m_Min, c0->m_Max, result.m_T);
+				float t1 = slab(o, inv, c1->m_Min, c1->m_Max, result.m_T);
+
+				if (t0 == INFINITY && t1 == INFINITY) break;
+				if (t1 < t0)
+				{
+					std::swap(c0, c1);
+					std::swap(t0, t1);
+				}
+
+				if (t1 != INFINITY)
+				{
+					stack[top] = (uint32_t)(c1 - m_Nodes.data());
+					stackT[top++] = t1;
+				}
+				n = c0;
+			}
+		}
+
+		return result.m_Primitive != none;
+	}
+
+	bool bvh::occluded(const ray &r, float maxT) const
+	{
+		if (m_Nodes.empty()) return false;
+
+		const float o[3] = { r.p0.x, r.p0.y, r.p0.z };
+		const float d[3] = { r.p1.x - r.p0.x, r.p1.y - r.p0.y, r.p1.z - r.p0.z };
+		const float inv[3] = { reciprocal(d[0]), reciprocal(d[1]), reciprocal(d[2]) };
+
+		uint32_t stack[stackSize];
+		int top = 0;
+		stack[top++] = 0;
+
+		while (top)
+		{
+			const node &n = m_Nodes[stack[--top]];
+			if (slab(o, inv, n.m_Min, n.m_Max, maxT) == INFINITY) continue;
+
+			if (!n.m_Count)
+			{
+				stack[top++] = n.m_First;
+				stack[top++] = n.m_First + 1;
+				continue;
+			}
+
+			for (uint32_t k = 0; k < n.m_Count; ++k)
+			{
+				uint32_t p = m_Order[n.m_First + k];
+				float tp = m_Triangles
+					? triangle(o, d, m_A[p], m_B[p], m_C[p])
+					: slab(o, inv, &m_A[p].x, &m_B[p].x, maxT);
+
+				if (tp < INFINITY && tp <= maxT) return true;
+			}
+		}
+
+		return false;
+	}
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Packets
+
+#ifdef BVH_SSE2
+	namespace
+	{
+		inline __m128 blend(__m128 mask, __m128 a, __m128 b)
+		{
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+		}
+
+		// unsigned a < b
+		inline __m128 lessUnsigned(__m128i a, __m128i b)
+		{
+			const __m128i sign = _mm_set1_epi32((int)0x80000000);
+			return _mm_castsi128_ps(_mm_cmplt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign)));
+		}
+
+		// Groups of four rays, in the same operations as the single ray tests so both give the same hits.
+		template <int Groups>
+		struct packet
+		{
+			__m128  o[3][Groups];
+			__m128  d[3][Groups];
+			__m128  inv[3][Groups];
+			__m128  best[Groups];
+			__m128i primitive[Groups];
+			__m128  active[Groups];
+
+			// lanes whose ray enters the box before their tFar
+			int enters(const float *mn, const float *mx, __m128 *mask) const
+			{
+				int any = 0;
+				for (int g = 0; g < Groups; ++g)
+				{
+					__m128 tNear = _mm_setzero_ps(), tFar = best[g];
+					for (int i = 0; i < 3; ++i)
+					{
+						__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(mn[i]), o[i][g]), inv[i][g]);
+						__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(mx[i]), o[i][g]), inv[i][g]);
+						tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+						tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+					}
+					mask[g] = _mm_and_ps(_mm_cmple_ps(tNear, tFar), active[g]);
+					any |= _mm_movemask_ps(mask[g]);
+				}
+				return any;
+			}
+
+			// entry of the lanes' rays into a box before their best, infinity otherwise
+			__m128 box(int g, const vec3 &a, const vec3 &b) const
+			{
+				const float *mn = &a.x, *mx = &b.x;
+				__m128 tNear = _mm_setzero_ps(), tFar = best[g];
+				for (int i = 0; i < 3; ++i)
+				{
+					__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(mn[i]), o[i][g]), inv[i][g]);
+					__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(mx[i]), o[i][g]), inv[i][g]);
+					tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+					tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+				}
+				return blend(_mm_cmple_ps(tNear, tFar), tNear, _mm_set1_ps(INFINITY));
+			}
+
+			__m128 triangle(int g, const vec3 &a, const vec3 &b, const vec3 &c) const
+			{
+				float e1x = b.x - a.x, e1y = b.y - a.y, e1z = b.z - a.z;
+				float e2x = c.x - a.x, e2y = c.y - a.y, e2z = c.z - a.z;
+				__m128 E1x = _mm_set1_ps(e1x), E1y = _mm_set1_ps(e1y), E1z = _mm_set1_ps(e1z);
+				__m128 E2x = _mm_set1_ps(e2x), E2y = _mm_set1_ps(e2y), E2z = _mm_set1_ps(e2z);
+				const __m128 *D[3] = { &d[0][g], &d[1][g], &d[2][g] };
+
+				__m128 px = _mm_sub_ps(_mm_mul_ps(*D[1], E2z), _mm_mul_ps(*D[2], E2y));
+				__m128 py = _mm_sub_ps(_mm_mul_ps(*D[2], E2x), _mm_mul_ps(*D[0], E2z));
+				__m128 pz = _mm_sub_ps(_mm_mul_ps(*D[0], E2y), _mm_mul_ps(*D[1], E2x));
+				__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(E1x, px), _mm_mul_ps(E1y, py)), _mm_mul_ps(E1z, pz));
+				__m128 invDet = _mm_div_ps(_mm_set1_ps(1), det);
+
+				__m128 sx = _mm_sub_ps(o[0][g], _mm_set1_ps(a.x));
+				__m128 sy = _mm_sub_ps(o[1][g], _mm_set1_ps(a.y));
+				__m128 sz = _mm_sub_ps(o[2][g], _mm_set1_ps(a.z));
+				__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+
+				__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, E1z), _mm_mul_ps(sz, E1y));
+				__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, E1x), _mm_mul_ps(sx, E1z));
+				__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, E1y), _mm_mul_ps(sy, E1x));
+				__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(*D[0], qx), _mm_mul_ps(*D[1], qy)), _mm_mul_ps(*D[2], qz)), invDet);
+				__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(E2x, qx), _mm_mul_ps(E2y, qy)), _mm_mul_ps(E2z, qz)), invDet);
+
+				const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+				__m128 ok = _mm_cmpneq_ps(det, zero);
+				ok = _mm_and_ps(ok, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+				ok = _mm_and_ps(ok, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+				ok = _mm_and_ps(ok, _mm_cmpge_ps(t, zero));
+				return blend(ok, t, _mm_set1_ps(INFINITY));
+			}
+		};
+	}
+
+	template <int Lanes>
+	void bvh::intersectPacket(const ray *rays, hit *results, float maxT, bool any) const
+	{
+		const int Groups = Lanes / 4;
+		packet<Groups> p;
+
+		for (int g = 0; g < Groups; ++g)
+		{
+			float o[3][4], d[3][4], inv[3][4];
+			for (int l = 0; l < 4; ++l)
+			{
+				const ray &r = rays[g * 4 + l];
+				o[0][l] = r.p0.x; o[1][l] = r.p0.y; o[2][l] = r.p0.z;
+				d[0][l] = r.p1.x - r.p0.x; d[1][l] = r.p1.y - r.p0.y; d[2][l] = r.p1.z - r.p0.z;
+				for (int i = 0; i < 3; ++i)
+					inv[i][l] = reciprocal(d[i][l]);
+			}
+
+			for (int i = 0; i < 3; ++i)
+			{
+				p.o[i][g] = _mm_loadu_ps(o[i]);
+				p.d[i][g] = _mm_loadu_ps(d[i]);
+				p.inv[i][g] = _mm_loadu_ps(inv[i]);
+			}
+			p.best[g] = _mm_set1_ps(maxT);
+			p.primitive[g] = _mm_set1_epi32((int)none);
+			p.active[g] = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		}
+
+		const float *dir = (const float*)&p.d[0][0];
+		uint32_t stack[stackSize];
+		int top = 0;
+		if (!m_Nodes.empty()) stack[top++] = 0;
+
+		__m128 mask[Groups];
+		while (top)
+		{
+			const node &n = m_Nodes[stack[--top]];
+			if (!p.enters(n.m_Min, n.m_Max, mask)) continue;
+
+			if (!n.m_Count)
+			{
+				// the child that is nearer along the first ray's direction is visited first
+				const node &c0 = m_Nodes[n.m_First], &c1 = m_Nodes[n.m_First + 1];
+				float along = 0;
+				for (int i = 0; i < 3; ++i)
+					along += (c0.m_Min[i] + c0.m_Max[i] - c1.m_Min[i] - c1.m_Max[i]) * dir[i * Groups * 4];
+
+				bool secondFirst = along > 0;
+				stack[top++] = n.m_First + (secondFirst ? 0 : 1);
+				stack[top++] = n.m_First + (secondFirst ? 1 : 0);
+				continue;
+			}
+
+			for (int g = 0; g < Groups; ++g)
+			{
+				if (!_mm_movemask_ps(mask[g])) continue;
+
+				for (uint32_t k = 0; k < n.m_Count; ++k)
+				{
+					uint32_t prim = m_Order[n.m_First + k];
+					__m128 t = m_Triangles ? p.triangle(g, m_A[prim], m_B[prim], m_C[prim]) : p.box(g, m_A[prim], m_B[prim]);
+
+					__m128i id = _mm_set1_epi32((int)prim);
+					__m128 better = _mm_or_ps(_mm_cmplt_ps(t, p.best[g]), _mm_and_ps(_mm_cmpeq_ps(t, p.best[g]), lessUnsigned(id, p.primitive[g])));
+					better = _mm_and_ps(better, _mm_and_ps(_mm_cmplt_ps(t, _mm_set1_ps(INFINITY)), _mm_cmple_ps(t, _mm_set1_ps(maxT))));
+					better = _mm_and_ps(better, mask[g]);
+
+					p.best[g] = blend(better, t, p.best[g]);
+					p.primitive[g] = _mm_castps_si128(blend(better, _mm_castsi128_ps(id), _mm_castsi128_ps(p.primitive[g])));
+
+					// a ray only looking for any hit is done
+					if (any) p.active[g] = _mm_andnot_ps(better, p.active[g]);
+				}
+			}
+
+			if (any)
+			{
+				int remaining = 0;
+				for (int g = 0; g < Groups; ++g)
+					remaining |= _mm_movemask_ps(p.active[g]);
+				if (!remaining) break;
+			}
+		}
+
+		for (int g = 0; g < Groups; ++g)
+		{
+			float best[4];
+			uint32_t primitive[4];
+			_mm_storeu_ps(best, p.best[g]);
+			_mm_storeu_si128((__m128i*)primitive, p.primitive[g]);
+
+			for (int l = 0; l < 4; ++l)
+				results[g * 4 + l] = { primitive[l], primitive[l] == none ? maxT : best[l] };
+		}
+	}
+#else
+	template <int Lanes>
+	void bvh::intersectPacket(const ray *rays, hit *results, float maxT, bool any) const
+	{
+		for (int l = 0; l < Lanes; ++l)
+		{
+			if (!any) intersect(rays[l], results[l], maxT);
+			else results[l] = { occluded(rays[l], maxT) ? 0u : none, maxT };
+		}
+	}
+#endif
+
+	void bvh::intersect4(const ray *rays, hit *results, float maxT) const
+	{
+		intersectPacket<4>(rays, results, maxT, false);
+	}
+
+	void bvh::intersect8(const ray *rays, hit *results, float maxT) const
+	{
+		intersectPacket<8>(rays, results, maxT, false);
+	}
+
+	void bvh::occluded4(const ray *rays, bool *results, float maxT) const
+	{
+		hit hits[4];
+		intersectPacket<4>(rays, hits, maxT, true);
+		for (int l = 0; l < 4; ++l)
+			results[l] = hits[l].m_Primitive != none;
+	}
+
+	void bvh::occluded8(const ray *rays, bool *results, float maxT) const
+	{
+		hit hits[8];
+		intersectPacket<8>(rays, hits, maxT, true);
+		for (int l = 0; l < 8; ++l)
+			results[l] = hits[l].m_Primitive != none;
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "vec3.h"
+#include "ray.h"
+
+namespace bb
+{
+	/*
+	 * Bounding volume hierarchy over boxes or triangles, built with binned SAH.
+	 * Rays run from p0 through p1 with t in units of p1 - p0, hits are reported for 0 <= t <= maxT: use
+	 *  maxT = 1 for segments such as line of sight. The nearest hit is the smallest t, ties go to the lower
+	 *  primitive index, so single rays and packets always agree. A ray starting inside a box hits it at t = 0.
+	 * Packets trace 4 or 8 rays together with SSE2 and are fastest for coherent rays, such as neighbouring
+	 *  pixels; they fall back to single rays without SSE2.
+	 */
+	class bvh
+	{
+	public:
+		static const uint32_t none = 0xffffffff;
+
+		struct hit
+		{
+			uint32_t m_Primitive;   // none when missed
+			float    m_T;
+		};
+
+		// box i is a[i]..b[i]
+		void buildBoxes(const vec3 *a, const vec3 *b, size_t count, unsigned threads = 1);
+
+		// triangle i is vertices[indices[3 * i]], vertices[indices[3 * i + 1]], vertices[indices[3 * i + 2]]
+		void buildTriangles(const vec3 *vertices, const uint32_t *indices, size_t count, unsigned threads = 1);
+
+		// new positions for the primitives of the last build, the tree is kept and only its bounds are updated.
+		// Queries get slower as the primitives move away from where they were built.
+		void refitBoxes(const vec3 *a, const vec3 *b);
+		void refitTriangles(const vec3 *vertices);
+
+		bool intersect(const ray &r, hit &result, float maxT = INFINITY) const;
+		bool occluded(const ray &r, float maxT = INFINITY) const;
+
+		void intersect4(const ray *rays, hit *results, float maxT = INFINITY) const;
+		void intersect8(const ray *rays, hit *results, float maxT = INFINITY) const;
+		void occluded4(const ray *rays, bool *results, float maxT = INFINITY) const;
+		void occluded8(const ray *rays, bool *results, float maxT = INFINITY) const;
+
+		size_t nodeCount() const { return m_Nodes.size(); }
+		bool   operator==(const bvh &other) const;
+
+	private:
+		// children of an inner node are m_First and m_First + 1, a leaf holds m_Count primitives from m_First
+		struct node
+		{
+			float    m_Min[3];
+			float    m_Max[3];
+			uint32_t m_First;
+			uint32_t m_Count;
+		};
+
+		struct build_task;
+
+		void build(unsigned threads);
+		void refit();
+		void primitiveBounds(uint32_t primitive, float *min, float *max) const;
+
+		template <int Lanes> void intersectPacket(const ray *rays, hit *results, float maxT, bool any) const;
+
+		std::vector<node>     m_Nodes;
+		std::vector<uint32_t> m_Order;       // primitives in leaf order
+
+		// the primitives of the last build
+		bool                  m_Triangles = false;
+		std::vector<vec3>     m_A;           // box minimum or first vertex
+		std::vector<vec3>     m_B;           // box maximum or second vertex
+		std::vector<vec3>     m_C;           // third vertex
+		std::vector<uint32_t> m_Indices;
+	};
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Random triangles traced with camera rays, as single rays, packets of 4 and 8 and for occlusion, against a
+	//  scan of every triangle, and random boxes picked with the BVH and with a rayAABBIntersection loop.
+	// Throws when the BVH and the scans or the packets and single rays disagree, or when builds with different
+	//  numbers of threads differ.
+	struct bvh_benchmark_report
+	{
+		size_t   triangles = 0;
+		size_t   boxes = 0;
+		unsigned maxThreads = 0;
+
+		std::vector<double> build_ms;    // for 1, 2, 4 ... maxThreads threads
+		double refit_ms = 0;
+
+		double scan_rays_per_second = 0;      // every triangle tested
+		double single_rays_per_second = 0;
+		double packet4_rays_per_second = 0;
+		double packet8_rays_per_second = 0;
+		double occluded_rays_per_second = 0;
+
+		double picking_loop_rays_per_second = 0;   // rayAABBIntersection with every box
+		double picking_bvh_rays_per_second = 0;
+
+		void print(std::ostream &out) const;
+	};
+
+	bvh_benchmark_report run_bvh_benchmark(size_t triangles = 100000, size_t boxes = 2000, unsigned maxThreads = 16);
+}
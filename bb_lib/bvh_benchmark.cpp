@@ -0,0 +1,290 @@
+#include "bvh.h"
+#include "intersection.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace bb
+{
+	using namespace std;
+
+	namespace
+	{
+		typedef chrono::steady_clock clock;
+
+		double seconds(clock::time_point a, clock::time_point b)
+		{
+			return chrono::duration<double>(b - a).count();
+		}
+
+		// Moller-Trumbore over every triangle, only here to check the BVH
+		bvh::hit scan(const ray &r, const vector<vec3> &vertices, const vector<uint32_t> &indices, float maxT)
+		{
+			bvh::hit best = { bvh::none, maxT };
+			vec3 d = r.p1 - r.p0;
+
+			for (uint32_t i = 0; i < indices.size() / 3; ++i)
+			{
+				const vec3 &a = vertices[indices[i * 3]], &b = vertices[indices[i * 3 + 1]], &c = vertices[indices[i * 3 + 2]];
+				vec3 e1 = b - a, e2 = c - a;
+				vec3 p(d.y * e2.z - d.z * e2.y, d.z * e2.x - d.x * e2.z, d.x * e2.y - d.y * e2.x);
+				float det = e1.x * p.x + e1.y * p.y + e1.z * p.z;
+				if (det == 0) continue;
+
+				vec3 s = r.p0 - a;
+				float u = (s.x * p.x + s.y * p.y + s.z * p.z) / det;
+				if (u < 0 || u > 1) continue;
+
+				vec3 q(s.y * e1.z - s.z * e1.y, s.z * e1.x - s.x * e1.z, s.x * e1.y - s.y * e1.x);
+				float v = (d.x * q.x + d.y * q.y + d.z * q.z) / det;
+				if (v < 0 || u + v > 1) continue;
+
+				float t = (e2.x * q.x + e2.y * q.y + e2.z * q.z) / det;
+				if (t >= 0 && t <= best.m_T) best = { i, t };
+			}
+			return best;
+		}
+
+		bvh::hit scan(const ray &r, const vector<vec3> &lo, const vector<vec3> &hi)
+		{
+			bvh::hit best = { bvh::none, INFINITY };
+			vec3 d = r.p1 - r.p0;
+
+			for (uint32_t i = 0; i < lo.size(); ++i)
+			{
+				float t0 = 0, t1 = INFINITY;
+				const float *o = &r.p0.x, *dir = &d.x, *a = &lo[i].x, *b = &hi[i].x;
+				for (int k = 0; k < 3; ++k)
+				{
+					float ta = (a[k] - o[k]) / dir[k], tb = (b[k] - o[k]) / dir[k];
+					t0 = std::max(t0, std::min(ta, tb));
+					t1 = std::min(t1, std::max(ta, tb));
+				}
+				if (t0 <= t1 && t0 < best.m_T) best = { i, t0 };
+			}
+			return best;
+		}
+
+		// the same hit up to rounding, the primitive may differ when two are about as near
+		bool close(const bvh::hit &a, const bvh::hit &b)
+		{
+			if ((a.m_Primitive == bvh::none) != (b.m_Primitive == bvh::none)) return false;
+			return a.m_Primitive == bvh::none || fabsf(a.m_T - b.m_T) <= 1e-4f * std::max(1.0f, a.m_T);
+		}
+
+		bool same(const bvh::hit &a, const bvh::hit &b)
+		{
+			return a.m_Primitive == b.m_Primitive && (a.m_Primitive == bvh::none || a.m_T == b.m_T);
+		}
+
+		void checkPackets(const bvh &tree, const vector<ray> &rays, const vector<bvh::hit> &single)
+		{
+			for (size_t i = 0; i + 8 <= rays.size(); i += 8)
+			{
+				bvh::hit four[8], eight[8];
+				tree.intersect4(&rays[i], four);
+				tree.intersect4(&rays[i + 4], four + 4);
+				tree.intersect8(&rays[i], eight);
+
+				for (int l = 0; l < 8; ++l)
+				{
+					if (!same(four[l], single[i + l]) || !same(eight[l], single[i + l]))
+						throw exception("bvh packets and single rays found different hits");
+				}
+			}
+		}
+	}
+
+	void bvh_benchmark_report::print(ostream &out) const
+	{
+		out << triangles << " triangles, " << boxes << " boxes\n";
+		for (size_t i = 0; i < build_ms.size(); ++i)
+			out << "build with " << std::min(1u << i, maxThreads) << " threads: " << build_ms[i] << " ms\n";
+		out << "refit: " << refit_ms << " ms\n";
+		out << "rays/s: scan " << scan_rays_per_second << ", single " << single_rays_per_second
+			<< ", packets of 4 " << packet4_rays_per_second << ", packets of 8 " << packet8_rays_per_second
+			<< ", occluded " << occluded_rays_per_second << "\n";
+		out << "picking rays/s: rayAABBIntersection loop " << picking_loop_rays_per_second << ", bvh " << picking_bvh_rays_per_second << "\n";
+	}
+
+	bvh_benchmark_report run_bvh_benchmark(size_t triangles, size_t boxes, unsigned maxThreads)
+	{
+		bvh_benchmark_report report;
+		report.triangles = triangles;
+		report.boxes = boxes;
+		report.maxThreads = std::max(maxThreads, 1u);
+
+		// small triangles scattered in a cube of 100
+		mt19937 random(1);
+		uniform_real_distribution<float> place(0, 100);
+		uniform_real_distribution<float> corner(-1.5f, 1.5f);
+
+		vector<vec3> vertices(triangles * 3);
+		vector<uint32_t> indices(triangles * 3);
+		for (size_t i = 0; i < triangles; ++i)
+		{
+			vec3 centre(place(random), place(random), place(random));
+			for (int k = 0; k < 3; ++k)
+			{
+				vertices[i * 3 + k] = vec3(centre.x + corner(random), centre.y + corner(random), centre.z + corner(random));
+				indices[i * 3 + k] = (uint32_t)(i * 3 + k);
+			}
+		}
+
+		// a camera in front of the cube, pixels in tiles of 4 by 2 so packets are neighbours
+		const int width = 256, height = 256;
+		vector<ray> rays;
+		rays.reserve(width * height);
+		for (int ty = 0; ty < height; ty += 2)
+			for (int tx = 0; tx < width; tx += 4)
+				for (int half = 0; half < 2; ++half)
+					for (int y = ty; y < ty + 2; ++y)
+						for (int x = tx + half * 2; x < tx + half * 2 + 2; ++x)
+						{
+							vec3 origin(50, -100, 50);
+							rays.push_back({ origin, vec3(origin.x + (x + 0.5f) / width - 0.5f, origin.y + 1, origin.z + (y + 0.5f) / height - 0.5f) });
+						}
+
+		// builds with more threads give the same tree
+		bvh tree;
+		for (unsigned threads = 1;; threads = std::min(threads * 2, report.maxThreads))
+		{
+			bvh other;
+			auto start = clock::now();
+			other.buildTriangles(vertices.data(), indices.data(), triangles, threads);
+			report.build_ms.push_back(seconds(start, clock::now()) * 1000);
+
+			if (threads == 1) tree = other;
+			else if (!(other == tree)) throw exception("bvh builds with different numbers of threads differ");
+			if (threads == report.maxThreads) break;
+		}
+
+		vector<bvh::hit> single(rays.size());
+		auto start = clock::now();
+		for (size_t i = 0; i < rays.size(); ++i)
+			tree.intersect(rays[i], single[i]);
+		report.single_rays_per_second = rays.size() / seconds(start, clock::now());
+
+		vector<bvh::hit> packets(rays.size());
+		start = clock::now();
+		for (size_t i = 0; i + 4 <= rays.size(); i += 4)
+			tree.intersect4(&rays[i], &packets[i]);
+		report.packet4_rays_per_second = rays.size() / seconds(start, clock::now());
+
+		start = clock::now();
+		for (size_t i = 0; i + 8 <= rays.size(); i += 8)
+			tree.intersect8(&rays[i], &packets[i]);
+		report.packet8_rays_per_second = rays.size() / seconds(start, clock::now());
+
+		checkPackets(tree, rays, single);
+
+		// the scan is slow, a sample of the rays is enough
+		const size_t sample = 64;
+		start = clock::now();
+		for (size_t i = 0; i < rays.size(); i += sample)
+		{
+			if (!close(scan(rays[i], vertices, indices, INFINITY), single[i]))
+				throw exception("bvh and scan found different hits");
+		}
+		report.scan_rays_per_second = (rays.size() / sample) / seconds(start, clock::now());
+
+		// occlusion in the front half of the cube
+		const float shadow = 150;
+		vector<char> blocked(rays.size());
+		start = clock::now();
+		for (size_t i = 0; i < rays.size(); ++i)
+			blocked[i] = tree.occluded(rays[i], shadow);
+		report.occluded_rays_per_second = rays.size() / seconds(start, clock::now());
+
+		for (size_t i = 0; i < rays.size(); i += 8)
+		{
+			bool eight[8];
+			tree.occluded8(&rays[i], eight, shadow);
+			for (int l = 0; l < 8; ++l)
+			{
+				bool expected = single[i + l].m_Primitive != bvh::none && single[i + l].m_T <= shadow;
+				if (eight[l] != expected || (blocked[i + l] != 0) != expected)
+					throw exception("bvh occlusion disagrees with the nearest hit");
+			}
+		}
+
+		// everything moves a little, the refitted tree still finds the same hits as a scan
+		uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+		for (vec3 &v : vertices)
+			v = vec3(v.x + jitter(random), v.y + jitter(random), v.z + jitter(random));
+
+		start = clock::now();
+		tree.refitTriangles(vertices.data());
+		report.refit_ms = seconds(start, clock::now()) * 1000;
+
+		for (size_t i = 0; i < rays.size(); ++i)
+			tree.intersect(rays[i], single[i]);
+		checkPackets(tree, rays, single);
+		for (size_t i = 0; i < rays.size(); i += sample * 4)
+		{
+			if (!close(scan(rays[i], vertices, indices, INFINITY), single[i]))
+				throw exception("refitted bvh and scan found different hits");
+		}
+
+		// picking boxes with rays from all around the cube
+		uniform_real_distribution<float> size(0.5f, 3);
+		uniform_real_distribution<float> angle(0, 6.2831853f);
+		vector<vec3> lo(boxes), hi(boxes);
+		for (size_t i = 0; i < boxes; ++i)
+		{
+			lo[i] = vec3(place(random), place(random), place(random));
+			hi[i] = vec3(lo[i].x + size(random), lo[i].y + size(random), lo[i].z + size(random));
+		}
+
+		bvh picking;
+		picking.buildBoxes(lo.data(), hi.data(), boxes);
+
+		const size_t picks = 16384;
+		vector<ray> pickRays(picks);
+		for (ray &r : pickRays)
+		{
+			float a = angle(random), b = angle(random);
+			r.p0 = vec3(50 + 150 * cosf(a) * cosf(b), 50 + 150 * sinf(a) * cosf(b), 50 + 150 * sinf(b));
+			r.p1 = vec3(place(random), place(random), place(random));
+		}
+
+		// the loop also reports boxes behind the start of the ray, only its speed is compared
+		uint32_t loopHits = 0;
+		start = clock::now();
+		for (const ray &r : pickRays)
+		{
+			float nearest = INFINITY;
+			for (size_t i = 0; i < boxes; ++i)
+			{
+				float t;
+				if (rayAABBIntersection(r, lo[i], hi[i], &t) && t >= 0) nearest = std::min(nearest, t);
+			}
+			loopHits += nearest != INFINITY;
+		}
+		report.picking_loop_rays_per_second = picks / seconds(start, clock::now());
+
+		uint32_t bvhHits = 0;
+		start = clock::now();
+		for (const ray &r : pickRays)
+		{
+			bvh::hit h;
+			bvhHits += picking.intersect(r, h);
+		}
+		report.picking_bvh_rays_per_second = picks / seconds(start, clock::now());
+
+		if (!bvhHits || !loopHits)
+			throw exception("no boxes were picked");
+
+		for (const ray &r : pickRays)
+		{
+			bvh::hit h;
+			picking.intersect(r, h);
+			if (!close(h, scan(r, lo, hi)))
+				throw exception("bvh and scan picked different boxes");
+		}
+
+		return report;
+	}
+}
@@ -0,0 +1,106 @@
+#include "hash_grid3.h"
+
+namespace bb
+{
+	hash_grid3::hash_grid3(float cellSize, unsigned buckets)
+		: m_CellSize(cellSize)
+		, m_InvCellSize(1 / cellSize)
+	{
+		// a power of two, so the hash is masked
+		unsigned count = 1;
+		while (count < buckets) count *= 2;
+		m_Buckets.resize(count);
+	}
+
+	int hash_grid3::cell(float v) const
+	{
+		// far away cells share the outermost one rather than overflowing
+		float c = floorf(v * m_InvCellSize);
+		return (int)std::max(-1e9f, std::min(c, 1e9f));
+	}
+
+	hash_grid3::cell_range hash_grid3::range(const vec3 &a, const vec3 &b) const
+	{
+		return { cell(a.x), cell(a.y), cell(a.z), cell(b.x), cell(b.y), cell(b.z) };
+	}
+
+	hash_grid3::handle hash_grid3::insert(const vec3 &a, const vec3 &b, void *ptr)
+	{
+		handle h;
+		if (!m_Free.empty())
+		{
+			h = m_Free.back();
+			m_Free.pop_back();
+		}
+		else
+		{
+			h = (handle)m_Objects.size();
+			m_Objects.emplace_back();
+		}
+
+		object &o = m_Objects[h];
+		o.m_Element = { a, b, ptr };
+		o.m_Cells = range(a, b);
+		o.m_Alive = true;
+
+		link(h);
+		return h;
+	}
+
+	void hash_grid3::remove(handle h)
+	{
+		unlink(h);
+		m_Objects[h].m_Alive = false;
+		m_Free.push_back(h);
+	}
+
+	void hash_grid3::move(handle h, const vec3 &a, const vec3 &b)
+	{
+		object &o = m_Objects[h];
+		o.m_Element.m_A = a;
+		o.m_Element.m_B = b;
+
+		cell_range cells = range(a, b);
+		if (cells == o.m_Cells) return;
+
+		unlink(h);
+		o.m_Cells = cells;
+		link(h);
+	}
+
+	void hash_grid3::link(handle h)
+	{
+		const cell_range &c = m_Objects[h].m_Cells;
+
+		for (int z = c.loZ; z <= c.hiZ; ++z)
+			for (int y = c.loY; y <= c.hiY; ++y)
+				for (int x = c.loX; x <= c.hiX; ++x)
+					m_Buckets[bucket(x, y, z)].push_back({ h, x, y, z });
+	}
+
+	void hash_grid3::unlink(handle h)
+	{
+		const cell_range &c = m_Objects[h].m_Cells;
+
+		for (int z = c.loZ; z <= c.hiZ; ++z)
+		{
+			for (int y = c.loY; y <= c.hiY; ++y)
+			{
+				for (int x = c.loX; x <= c.hiX; ++x)
+				{
+					auto &entries = m_Buckets[bucket(x, y, z)];
+					for (size_t i = 0; i < entries.size(); ++i)
+					{
+						const entry &e = entries[i];
+						if (e.m_Handle == h && e.m_X == x && e.m_Y == y && e.m_Z == z)
+						{
+							entries[i] = entries.back();
+							entries.pop_back();
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "spatial3.h"
+
+namespace bb
+{
+	/*
+	 * Unbounded uniform grid of cubic cells for persistent objects. The cells are hashed into a fixed number
+	 *  of buckets, so the world has no bounds and memory only depends on the number of objects.
+	 * An object is listed in every cell its box covers, which suits objects of about the cell size; use
+	 *  loose_octree when the sizes vary widely. Every query reports an object once.
+	 * Handles of removed objects are reused.
+	 */
+	class hash_grid3
+	{
+	public:
+		typedef uint32_t handle;
+		typedef element3 element;
+
+		explicit hash_grid3(float cellSize = 1, unsigned buckets = 4096);
+
+		handle insert(const vec3 &a, const vec3 &b, void *ptr);
+		void   remove(handle h);
+		void   move(handle h, const vec3 &a, const vec3 &b);   // only touches the buckets when the cells change
+
+		const element& get(handle h) const { return m_Objects[h].m_Element; }
+		size_t         size() const        { return m_Objects.size() - m_Free.size(); }
+
+		// objects whose box overlaps a..b
+		template <typename Visitor>
+		void visit(const vec3 &a, const vec3 &b, Visitor &&visitor) const
+		{
+			gather(range(a, b), [&](const element &e) { return boxesOverlap(e.m_A, e.m_B, a, b); }, visitor);
+		}
+
+		template <typename Visitor>
+		void visitSphere(const vec3 &centre, float radius, Visitor &&visitor) const
+		{
+			vec3 r(radius, radius, radius);
+			gather(range(centre - r, centre + r), [&](const element &e) { return boxSphereOverlap(e.m_A, e.m_B, centre, radius); }, visitor);
+		}
+
+		template <typename Visitor>
+		void visitFrustum(const frustum &f, Visitor &&visitor) const
+		{
+			gather(range(f.m_A, f.m_B), [&](const element &e) { return f.intersects(e.m_A, e.m_B); }, visitor);
+		}
+
+		// objects the segment r.p0..r.p1 touches, visitor(element, t) with t where it enters the box
+		template <typename Visitor>
+		void visitRay(const ray &r, Visitor &&visitor) const;
+
+	private:
+		struct cell_range
+		{
+			int loX, loY, loZ, hiX, hiY, hiZ;
+
+			bool contains(int x, int y, int z) const
+			{
+				return x >= loX && x <= hiX && y >= loY && y <= hiY && z >= loZ && z <= hiZ;
+			}
+
+			bool operator==(const cell_range &o) const
+			{
+				return loX == o.loX && loY == o.loY && loZ == o.loZ && hiX == o.hiX && hiY == o.hiY && hiZ == o.hiZ;
+			}
+
+			size_t count() const
+			{
+				return (size_t)(hiX - loX + 1) * (size_t)(hiY - loY + 1) * (size_t)(hiZ - loZ + 1);
+			}
+		};
+
+		struct object
+		{
+			element    m_Element;
+			cell_range m_Cells;
+			bool       m_Alive;
+		};
+
+		// an object in a bucket, with the cell it was listed for since cells share buckets
+		struct entry
+		{
+			handle m_Handle;
+			int    m_X, m_Y, m_Z;
+		};
+
+		int        cell(float v) const;
+		cell_range range(const vec3 &a, const vec3 &b) const;
+
+		size_t bucket(int x, int y, int z) const
+		{
+			return ((unsigned)x * 73856093u ^ (unsigned)y * 19349663u ^ (unsigned)z * 83492791u) & (m_Buckets.size() - 1);
+		}
+
+		void link(handle h);
+		void unlink(handle h);
+
+		// objects listed in the cells of q that pass test, each reported in the first cell of q it covers.
+		// Queries covering more cells than there are buckets test all objects instead.
+		template <typename Test, typename Visitor>
+		void gather(const cell_range &q, Test test, Visitor &visitor) const
+		{
+			if (q.count() > m_Buckets.size())
+			{
+				for (const auto &o : m_Objects)
+				{
+					if (o.m_Alive && test(o.m_Element)) visitor(o.m_Element);
+				}
+				return;
+			}
+
+			for (int z = q.loZ; z <= q.hiZ; ++z)
+			{
+				for (int y = q.loY; y <= q.hiY; ++y)
+				{
+					for (int x = q.loX; x <= q.hiX; ++x)
+					{
+						for (const auto &e : m_Buckets[bucket(x, y, z)])
+						{
+							if (e.m_X != x || e.m_Y != y || e.m_Z != z) continue;
+
+							const object &o = m_Objects[e.m_Handle];
+							if (x != std::max(o.m_Cells.loX, q.loX) || y != std::max(o.m_Cells.loY, q.loY) || z != std::max(o.m_Cells.loZ, q.loZ)) continue;
+
+							if (test(o.m_Element)) visitor(o.m_Element);
+						}
+					}
+				}
+			}
+		}
+
+		float m_CellSize;
+		float m_InvCellSize;
+
+		std::vector<std::vector<entry>> m_Buckets;
+		std::vector<object>             m_Objects;   // by handle
+		std::vector<handle>             m_Free;
+	};
+
+	template <typename Visitor>
+	void hash_grid3::visitRay(const ray &r, Visitor &&visitor) const
+	{
+		segment3 s(r);
+		cell_range q = range(
+			vec3(std::min(r.p0.x, r.p1.x), std::min(r.p0.y, r.p1.y), std::min(r.p0.z, r.p1.z)),
+			vec3(std::max(r.p0.x, r.p1.x), std::max(r.p0.y, r.p1.y), std::max(r.p0.z, r.p1.z)));
+
+		int x = cell(r.p0.x), y = cell(r.p0.y), z = cell(r.p0.z);
+		int stepX = r.p1.x >= r.p0.x ? 1 : -1, stepY = r.p1.y >= r.p0.y ? 1 : -1, stepZ = r.p1.z >= r.p0.z ? 1 : -1;
+		size_t steps = (size_t)(q.hiX - q.loX) + (size_t)(q.hiY - q.loY) + (size_t)(q.hiZ - q.loZ);
+
+		if (steps >= m_Buckets.size())
+		{
+			for (const auto &o : m_Objects)
+			{
+				if (!o.m_Alive) continue;
+
+				float t = s.entry(o.m_Element.m_A, o.m_Element.m_B);
+				if (t >= 0) visitor(o.m_Element, t);
+			}
+			return;
+		}
+
+		// t of the next cell boundary on each axis and the t between boundaries
+		auto next = [this](float p, float d, int c, int step)
+		{
+			return d == 0 ? INFINITY : ((c + (step > 0 ? 1 : 0)) * m_CellSize - p) / d;
+		};
+		float tX = next(r.p0.x, s.m_Dir.x, x, stepX), dX = s.m_Dir.x == 0 ? INFINITY : m_CellSize / fabsf(s.m_Dir.x);
+		float tY = next(r.p0.y, s.m_Dir.y, y, stepY), dY = s.m_Dir.y == 0 ? INFINITY : m_CellSize / fabsf(s.m_Dir.y);
+		float tZ = next(r.p0.z, s.m_Dir.z, z, stepZ), dZ = s.m_Dir.z == 0 ? INFINITY : m_CellSize / fabsf(s.m_Dir.z);
+
+		// the cells along a line enter the cells of a box once, an object is tested in the first of them.
+		// Every axis takes as many steps as the segment crosses cells on it, so rounding cannot leave the path.
+		int leftX = q.hiX - q.loX, leftY = q.hiY - q.loY, leftZ = q.hiZ - q.loZ;
+		int pX = x, pY = y, pZ = z;
+
+		for (size_t i = 0; i <= steps; ++i)
+		{
+			for (const auto &e : m_Buckets[bucket(x, y, z)])
+			{
+				if (e.m_X != x || e.m_Y != y || e.m_Z != z) continue;
+
+				const object &o = m_Objects[e.m_Handle];
+				if (i > 0 && o.m_Cells.contains(pX, pY, pZ)) continue;
+
+				float t = s.entry(o.m_Element.m_A, o.m_Element.m_B);
+				if (t >= 0) visitor(o.m_Element, t);
+			}
+
+			pX = x; pY = y; pZ = z;
+
+			float cX = leftX ? tX : INFINITY, cY = leftY ? tY : INFINITY, cZ = leftZ ? tZ : INFINITY;
+			if (cX <= cY && cX <= cZ && leftX) { x += stepX; tX += dX; leftX--; }
+			else if (cY <= cZ && leftY)        { y += stepY; tY += dY; leftY--; }
+			else if (leftZ)                    { z += stepZ; tZ += dZ; leftZ--; }
+		}
+	}
+}
@@ -0,0 +1,183 @@
+#include "loose_octree.h"
+
+#include <cmath>
+
+namespace bb
+{
+	namespace
+	{
+		void checkFinite(const vec3 &a, const vec3 &b)
+		{
+			if (!std::isfinite(a.x) || !std::isfinite(a.y) || !std::isfinite(a.z) ||
+				!std::isfinite(b.x) || !std::isfinite(b.y) || !std::isfinite(b.z))
+				throw std::exception("loose_octree: box is not finite");
+		}
+	}
+
+	loose_octree::loose_octree(const vec3 &centre, float halfSize, unsigned maxDepth, float maxHalfSize)
+		: m_Centre(centre)
+		, m_Half(halfSize)
+		, m_MaxHalf(std::max(halfSize, maxHalfSize))
+		, m_MaxDepth(std::min(maxDepth, 30u))   // walk() keeps at most 7 nodes per level on its stack
+	{
+		m_Nodes.push_back({ m_Centre, m_Half, 0, -1, { -1, -1, -1, -1, -1, -1, -1, -1 }, 0, {} });
+	}
+
+	bool loose_octree::fitsRoot(const vec3 &a, const vec3 &b, float half) const
+	{
+		float extent = std::max(std::max(b.x - a.x, b.y - a.y), b.z - a.z) / 2;
+
+		return extent <= half &&
+			fabsf((a.x + b.x) / 2 - m_Centre.x) <= half &&
+			fabsf((a.y + b.y) / 2 - m_Centre.y) <= half &&
+			fabsf((a.z + b.z) / 2 - m_Centre.z) <= half;
+	}
+
+	void loose_octree::grow(const vec3 &a, const vec3 &b)
+	{
+		// ends at the latest once m_Half reaches m_MaxHalf, which place() checked a..b fits
+		while (!fitsRoot(a, b, m_Half))
+			m_Half *= 2;
+
+		m_Nodes.clear();
+		m_Nodes.push_back({ m_Centre, m_Half, 0, -1, { -1, -1, -1, -1, -1, -1, -1, -1 }, 0, {} });
+		m_Outside.clear();
+
+		for (handle h = 0; h < (handle)m_Objects.size(); ++h)
+		{
+			if (m_Objects[h].m_Alive) place(h);
+		}
+	}
+
+	void loose_octree::place(handle h)
+	{
+		const element &e = m_Objects[h].m_Element;
+		if (fitsRoot(e.m_A, e.m_B, m_Half))
+		{
+			link(h);
+		}
+		else if (fitsRoot(e.m_A, e.m_B, m_MaxHalf))
+		{
+			grow(e.m_A, e.m_B);
+		}
+		else
+		{
+			object &o = m_Objects[h];
+			o.m_Node = -1;
+			o.m_Slot = (unsigned)m_Outside.size();
+			m_Outside.push_back(h);
+		}
+	}
+
+	loose_octree::handle loose_octree::insert(const vec3 &a, const vec3 &b, void *ptr)
+	{
+		checkFinite(a, b);
+
+		handle h;
+		if (!m_Free.empty())
+		{
+			h = m_Free.back();
+			m_Free.pop_back();
+		}
+		else
+		{
+			h = (handle)m_Objects.size();
+			m_Objects.emplace_back();
+		}
+
+		object &o = m_Objects[h];
+		o.m_Element = { a, b, ptr };
+		o.m_Alive = true;
+
+		place(h);
+		return h;
+	}
+
+	void loose_octree::remove(handle h)
+	{
+		unlink(h);
+		m_Objects[h].m_Alive = false;
+		m_Free.push_back(h);
+	}
+
+	void loose_octree::move(handle h, const vec3 &a, const vec3 &b)
+	{
+		checkFinite(a, b);
+
+		object &o = m_Objects[h];
+		o.m_Element.m_A = a;
+		o.m_Element.m_B = b;
+
+		// stay while the box is inside the loose bounds and has not shrunk well below the node's size
+		if (o.m_Node >= 0)
+		{
+			const node &n = m_Nodes[o.m_Node];
+			float loose = n.m_Half * 2;
+			float extent = std::max(std::max(b.x - a.x, b.y - a.y), b.z - a.z) / 2;
+
+			if (a.x >= n.m_Centre.x - loose && b.x <= n.m_Centre.x + loose &&
+				a.y >= n.m_Centre.y - loose && b.y <= n.m_Centre.y + loose &&
+				a.z >= n.m_Centre.z - loose && b.z <= n.m_Centre.z + loose &&
+				(extent > n.m_Half / 4 || n.m_Depth == m_MaxDepth)) return;
+		}
+
+		unlink(h);
+		place(h);
+	}
+
+	void loose_octree::link(handle h)
+	{
+		const element &e = m_Objects[h].m_Element;
+		vec3 c((e.m_A.x + e.m_B.x) / 2, (e.m_A.y + e.m_B.y) / 2, (e.m_A.z + e.m_B.z) / 2);
+		float extent = std::max(std::max(e.m_B.x - e.m_A.x, e.m_B.y - e.m_A.y), e.m_B.z - e.m_A.z) / 2;
+
+		int index = 0;
+		for (;;)
+		{
+			m_Nodes[index].m_Count++;
+
+			const node &n = m_Nodes[index];
+			if (n.m_Depth == m_MaxDepth || extent > n.m_Half / 2) break;
+
+			int i = (c.x >= n.m_Centre.x ? 1 : 0) | (c.y >= n.m_Centre.y ? 2 : 0) | (c.z >= n.m_Centre.z ? 4 : 0);
+			int child = n.m_Children[i];
+
+			if (child < 0)
+			{
+				float half = n.m_Half / 2;
+				vec3 centre(
+					n.m_Centre.x + (i & 1 ? half : -half),
+					n.m_Centre.y + (i & 2 ? half : -half),
+					n.m_Centre.z + (i & 4 ? half : -half));
+
+				node created = { centre, half, n.m_Depth + 1, index, { -1, -1, -1, -1, -1, -1, -1, -1 }, 0, {} };
+
+				child = (int)m_Nodes.size();
+				m_Nodes[index].m_Children[i] = child;
+				m_Nodes.push_back(created);
+			}
+
+			index = child;
+		}
+
+		object &o = m_Objects[h];
+		node &n = m_Nodes[index];
+		o.m_Node = index;
+		o.m_Slot = (unsigned)n.m_Objects.size();
+		n.m_Objects.push_back(h);
+	}
+
+	void loose_octree::unlink(handle h)
+	{
+		const object &o = m_Objects[h];
+		std::vector<handle> &list = o.m_Node >= 0 ? m_Nodes[o.m_Node].m_Objects : m_Outside;
+
+		handle last = list.back();
+		list[o.m_Slot] = last;
+		m_Objects[last].m_Slot = o.m_Slot;
+		list.pop_back();
+
+		for (int index = o.m_Node; index >= 0; index = m_Nodes[index].m_Parent)
+			m_Nodes[index].m_Count--;
+	}
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vector>
+
+#include "spatial3.h"
+
+namespace bb
+{
+	/*
+	 * Loose octree for persistent objects of widely varying sizes. Every node's loose bounds are twice its cell,
+	 *  so an object lives in exactly one node: the deepest one whose cell holds its centre and is not smaller than
+	 *  its extent. Moving objects stay in their node while they still fit its loose bounds.
+	 * The root grows, and the objects are placed again, when an object falls outside of it. It grows up to
+	 *  maxHalfSize, so a single far outlier can not push every other object into a few deep nodes; objects
+	 *  outside of that are kept in a list every query tests. Boxes that are not finite are rejected.
+	 * Handles of removed objects are reused, nodes are kept for reuse.
+	 * Objects go as deep as their size allows, so maxDepth should stop at cells about the spacing of the
+	 *  objects; deeper cells hold one object each at the end of a chain of nodes every query has to walk.
+	 */
+	class loose_octree
+	{
+	public:
+		typedef uint32_t handle;
+		typedef element3 element;
+
+		loose_octree(const vec3 &centre = vec3(0, 0, 0), float halfSize = 1024, unsigned maxDepth = 10, float maxHalfSize = 65536);
+
+		handle insert(const vec3 &a, const vec3 &b, void *ptr);
+		void   remove(handle h);
+		void   move(handle h, const vec3 &a, const vec3 &b);
+
+		const element& get(handle h) const { return m_Objects[h].m_Element; }
+		size_t         size() const        { return m_Objects.size() - m_Free.size(); }
+
+		// objects whose box overlaps a..b
+		template <typename Visitor>
+		void visit(const vec3 &a, const vec3 &b, Visitor &&visitor) const
+		{
+			walk([&](const vec3 &na, const vec3 &nb) { return boxesOverlap(na, nb, a, b); },
+				[&](const vec3 &na, const vec3 &nb) { return boxContains(a, b, na, nb); }, visitor);
+		}
+
+		template <typename Visitor>
+		void visitSphere(const vec3 &centre, float radius, Visitor &&visitor) const
+		{
+			walk([&](const vec3 &na, const vec3 &nb) { return boxSphereOverlap(na, nb, centre, radius); },
+				[&](const vec3 &na, const vec3 &nb) { return sphereContainsBox(centre, radius, na, nb); }, visitor);
+		}
+
+		template <typename Visitor>
+		void visitFrustum(const frustum &f, Visitor &&visitor) const
+		{
+			walk([&](const vec3 &na, const vec3 &nb) { return f.intersects(na, nb); },
+				[&](const vec3 &na, const vec3 &nb) { return f.contains(na, nb); }, visitor);
+		}
+
+		// objects the segment r.p0..r.p1 touches, visitor(element, t) with t where it enters the box
+		template <typename Visitor>
+		void visitRay(const ray &r, Visitor &&visitor) const
+		{
+			segment3 s(r);
+			walk([&](const vec3 &na, const vec3 &nb) { return s.entry(na, nb) >= 0; },
+				[](const vec3 &, const vec3 &) { return false; }, [&](const element &e)
+			{
+				float t = s.entry(e.m_A, e.m_B);
+				if (t >= 0) visitor(e, t);
+			});
+		}
+
+	private:
+		struct node
+		{
+			vec3     m_Centre;
+			float    m_Half;           // of the cell, the loose bounds are twice as large
+			unsigned m_Depth;
+			int      m_Parent;
+			int      m_Children[8];    // -1 when not created
+			unsigned m_Count;          // objects in this node and below
+
+			std::vector<handle> m_Objects;
+		};
+
+		struct object
+		{
+			element  m_Element;
+			int      m_Node;           // -1 outside of the root
+			unsigned m_Slot;           // in the node's m_Objects, or in m_Outside
+			bool     m_Alive;
+		};
+
+		bool fitsRoot(const vec3 &a, const vec3 &b, float half) const;
+		void grow(const vec3 &a, const vec3 &b);
+		void place(handle h);
+		void link(handle h);
+		void unlink(handle h);
+
+		// nodes whose loose bounds pass test, the objects in them that pass the same test on their box.
+		// Objects stay inside the loose bounds of their node, so when contains holds for a node's loose bounds
+		//  its objects and those below it are reported without testing them.
+		template <typename Test, typename Contains, typename Visitor>
+		void walk(Test test, Contains contains, Visitor &&visitor) const
+		{
+			int stack[8 * 32];   // node index * 2, plus 1 below a node that is inside
+			int top = 0;
+			stack[top++] = 0;
+
+			while (top)
+			{
+				int entry = stack[--top];
+				const node &n = m_Nodes[entry >> 1];
+				if (!n.m_Count) continue;
+
+				bool inside = (entry & 1) != 0;
+				if (!inside)
+				{
+					float loose = n.m_Half * 2;
+					vec3 a(n.m_Centre.x - loose, n.m_Centre.y - loose, n.m_Centre.z - loose);
+					vec3 b(n.m_Centre.x + loose, n.m_Centre.y + loose, n.m_Centre.z + loose);
+					if (!test(a, b)) continue;
+
+					inside = contains(a, b);
+				}
+
+				for (handle h : n.m_Objects)
+				{
+					const element &e = m_Objects[h].m_Element;
+					if (inside || test(e.m_A, e.m_B)) visitor(e);
+				}
+
+				for (int child : n.m_Children)
+				{
+					if (child >= 0) stack[top++] = child * 2 + (inside ? 1 : 0);
+				}
+			}
+
+			for (handle h : m_Outside)
+			{
+				const element &e = m_Objects[h].m_Element;
+				if (test(e.m_A, e.m_B)) visitor(e);
+			}
+		}
+
+		vec3     m_Centre;
+		float    m_Half;
+		float    m_MaxHalf;
+		unsigned m_MaxDepth;
+
+		std::vector<node>   m_Nodes;     // the root first
+		std::vector<object> m_Objects;   // by handle
+		std::vector<handle> m_Outside;   // too far away for the root at its largest
+		std::vector<handle> m_Free;
+	};
+}
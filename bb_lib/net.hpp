@@ -1,15 +1,24 @@
 #pragma once
 
+#include <deque>
 #include <memory>
 #include <string>
+#include <typeinfo>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "serialize.hpp"
+#include "vec2.h"
 #include "net_visitors.hpp"
 #include "net_node.hpp"
 #include "net_context.hpp"
+#include "net_interest.hpp"
+#include "net_message_buffer.hpp"
+#include "net_pool.hpp"
 #include "net_server_client.hpp"
 #include "net_server_node.hpp"
 #include "net_server.hpp"
+#include "net_rpc.hpp"
 #include "net_client_node.hpp"
-#include "net_client.hpp"
\ No newline at end of file
+#include "net_client.hpp"
+#include "net_snapshot.hpp"
\ No newline at end of file
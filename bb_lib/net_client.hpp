@@ -13,9 +13,15 @@ namespace bb
 
 			client(std::istream& svr_in, std::ostream& svr_out)
 				: m_svr_in(svr_in, this)
-				, m_svr_out(svr_out) { }
+				, m_svr_out(svr_out)
+				, m_svr_stream(svr_out) { }
 
-			virtual ~client() { }
+			virtual ~client()
+			{
+				// nodes can outlive the client, they must not unregister themselves anymore
+				for (auto &x : m_nodes)
+					x.second->detach();
+			}
 
 			using node_base_type = client_node_base<Deserializer, Serializer>;
 
@@ -31,7 +37,9 @@ namespace bb
 			template <class T>
 			void register_node_type()
 			{
-				m_factories.emplace(std::string(T::node_type()), std::make_shared<sub_factory<T>>());
+				auto factory = std::make_shared<sub_factory<T>>();
+				auto it = m_factories.emplace(intern_type(T::node_type()), factory).first;
+				if (strcmp(it->second->name(), T::node_type())) throw std::runtime_error("type id collision");
 			}
 
 			void update()
@@ -41,23 +49,37 @@ namespace bb
 					node_id id;
 					m_svr_in("node", id);
 
-					if (m_root.get())
+					if (id == snapshot_node)
+					{
+						// end of a snapshot, everything before it has been applied
+						uint32_t seq;
+						m_svr_in("seq", seq);
+						acknowledge(seq);
+					}
+					else if (id == reply_node)
+					{
+						uint32_t call;
+						m_svr_in("call", call);
+
+						auto it = m_calls.find(call);
+						if (it == m_calls.end()) throw std::runtime_error("unexpected rpc reply");
+
+						auto read = std::move(it->second);
+						m_calls.erase(it);
+						read(m_svr_in);
+					}
+					else if (m_root.get())
 					{
 						// find appropriate node
-						auto it = m_objects.find(id);
-						if (it == m_objects.end())
+						auto node = find(id);
+						if (!node)
 						{
-							throw std::exception("node not found");
+							throw std::runtime_error("node not found");
 						}
 
-						if (auto node = it->second.lock())
-						{
-							deserialize(m_svr_in, node);
-						}
-						else
-						{
-							throw std::exception("node expired!!!");
-						}
+						update_op op = deserialize_node(m_svr_in, *node);
+						if (op == update_op::Leave) node->m_in_interest = false;
+						else if (op == update_op::Replace) node->m_in_interest = true;
 					}
 					else
 					{
@@ -69,49 +91,120 @@ namespace bb
 
 			std::shared_ptr<polymorphic_node> get_root() { return m_root; }
 
+			// send the rpcs written since the last flush as one packet
+			void flush() { m_svr_stream.flush(); }
+
+			// calls still waiting for their reply
+			size_t pending_calls() const { return m_calls.size(); }
+
+			// last complete snapshot received in snapshot mode
+			uint32_t get_snapshot() const { return m_snapshot; }
+
+			// called after each complete snapshot, e.g. to record states in a snapshot_history
+			std::function<void(uint32_t)> on_snapshot;
+
 		private:
 			friend node_base_type;
 
 			class sub_factory_base
 			{
 			public:
-				virtual std::shared_ptr<polymorphic_node> make_node(context*, const char*, node_id) const = 0;
+				virtual ~sub_factory_base() { }
+
+				virtual std::shared_ptr<polymorphic_node> make_node(context*, node_id) = 0;
+				virtual type_id name() const = 0;
 			};
 
+			// nodes of one type come from a pool, a node that is dropped leaves its memory for the next one
 			template <class T>
 			class sub_factory : public sub_factory_base
 			{
-				std::shared_ptr<polymorphic_node> make_node(context* context, const char* type_id, node_id node_id) const override
+			public:
+				sub_factory()
+					: m_pool(std::make_shared<node_pool>()) { }
+
+				std::shared_ptr<polymorphic_node> make_node(context* context, node_id node_id) override
 				{
-					return std::make_shared<node<T, node_base_type, std::false_type>>(context, type_id, node_id);
+					using node_type = node<T, node_base_type, std::false_type>;
+					return std::allocate_shared<node_type>(pool_allocator<node_type>(m_pool), context, T::node_type(), node_id);
 				}
+
+				type_id name() const override { return T::node_type(); }
+
+			private:
+				std::shared_ptr<node_pool> m_pool;
 			};
 
-			std::shared_ptr<polymorphic_node> resolve(const char *tid, size_t nid) override
+			template <typename R>
+			rpc_future<R> expect(uint32_t& id)
 			{
-				std::shared_ptr<polymorphic_node> x = nullptr;
+				// 0 is reserved for calls without a reply
+				if (++m_call_counter == 0) ++m_call_counter;
+				id = m_call_counter;
 
-				auto it = m_objects.find(nid);
-				if (it != m_objects.end()) x = it->second.lock();
+				auto state = std::make_shared<typename rpc_future<R>::state>();
+				m_calls[id] = [state](Deserializer& ser) { rpc_future<R>::read(ser, *state); };
 
-				if (x.get() == nullptr)
-				{
-					// make node using registered factory
-					x = m_factories.at(tid)->make_node(this, tid, nid);
+				return rpc_future<R>(state);
+			}
+
+			void acknowledge(uint32_t seq)
+			{
+				node_id     id = snapshot_node;
+				std::string ack = "ack";
+				m_svr_out("node", id);
+				m_svr_out("rpc", ack);
+				m_svr_out("seq", seq);
+
+				m_snapshot = seq;
+				if (on_snapshot) on_snapshot(seq);
+			}
+
+			// the client only holds the nodes it was sent, keyed by the server's ids.
+			// nodes remove themselves when they are destroyed, see release
+			node_base_type* find(node_id nid) const
+			{
+				auto it = m_nodes.find(nid);
+				return it != m_nodes.end() ? it->second : nullptr;
+			}
 
-					// register the new node
-					m_objects[nid] = x;
+			void release(node_id nid)
+			{
+				m_nodes.erase(nid);
+			}
+
+			std::shared_ptr<polymorphic_node> resolve(type_key tid, size_t nid) override
+			{
+				if (auto x = find(nid))
+				{
+					if (x->get_type_key() != tid) throw std::runtime_error("node_id/type_id mismatch");
+					return x->shared_from_this();
 				}
 
-				if (strcmp(x->get_type_id(), tid)) throw std::exception("node_id/type_id mismatch");
+				// ids from the wire, the reserved ones never name a node
+				if (nid == snapshot_node || nid == reply_node) throw std::runtime_error("invalid node id");
+
+				// make node using registered factory
+				auto it = m_factories.find(tid);
+				if (it == m_factories.end()) throw std::runtime_error("node type not registered");
+
+				auto x = it->second->make_node(this, nid);
+
+				// register the new node
+				m_nodes[nid] = dynamic_cast<node_base_type*>(x.get());
 
 				return x;
 			}
 
 			Deserializer m_svr_in;
 			Serializer m_svr_out;
+			std::ostream& m_svr_stream;
 			std::shared_ptr<polymorphic_node> m_root;
-			std::unordered_map<std::string, std::shared_ptr<sub_factory_base>> m_factories;
+			uint32_t m_snapshot = 0;
+			uint32_t m_call_counter = 0;
+			std::unordered_map<uint32_t, std::function<void(Deserializer&)>> m_calls;
+			std::unordered_map<node_id, node_base_type*> m_nodes;
+			std::unordered_map<type_key, std::shared_ptr<sub_factory_base>> m_factories;
 		};
 	}
 }
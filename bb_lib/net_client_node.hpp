@@ -4,6 +4,8 @@ namespace bb
 {
 	namespace net
 	{
+		template <typename Deserializer, typename Serializer> class client;
+
 		template <typename Deserializer, typename Serializer>
 		class client_node_base : public context::node_base
 		{
@@ -12,18 +14,47 @@ namespace bb
 				: context::node_base(context, type_id, node_id)
 				, m_svr_out(((client<Deserializer, Serializer>*)context)->m_svr_out) { }
 
-			virtual ~client_node_base() { }
+			virtual ~client_node_base()
+			{
+				if (m_context) ((client<Deserializer, Serializer>*)m_context)->release(m_node_id);
+			}
 
 			template <typename... ARGS>
 			void rpc(const char* tag, ARGS&... args)
+			{
+				write_call(tag, 0, args...);
+			}
+
+			// rpc with a reply, the future resolves in client::update() once the reply arrives
+			template <typename R, typename... ARGS>
+			rpc_future<R> call(const char* tag, ARGS&... args)
+			{
+				uint32_t id;
+				auto future = ((client<Deserializer, Serializer>*)m_context)->template expect<R>(id);
+				write_call(tag, id, args...);
+				return future;
+			}
+
+			// false after the node left the area of interest (server::enable_interest), its members keep
+			//  the last state received until it enters again and is sent in full
+			bool in_interest() const { return m_in_interest; }
+
+		private:
+			friend class client<Deserializer, Serializer>;
+
+			// the client is going away before this node
+			void detach() { m_context = nullptr; }
+
+			template <typename... ARGS>
+			void write_call(const char* tag, uint32_t id, ARGS&... args)
 			{
 				std::string rpcTag = tag;
 				m_svr_out("node", m_node_id);
 				m_svr_out("rpc", rpcTag);
+				m_svr_out("call", id);
 				serializeArgs(0, args...);
 			}
 
-		private:
 			void serializeArgs(int argNumber) { }
 
 			template <typename T, typename... ARGS>
@@ -35,6 +66,8 @@ namespace bb
 			}
 
 			Serializer& m_svr_out;
+
+			bool        m_in_interest = true;
 		};
 	}
 }
\ No newline at end of file
@@ -21,12 +21,9 @@ namespace bb
 				virtual ~node_base() { }
 
 				context*    m_context;
-				std::string m_type_id;
+				type_id     m_type_id;
 				node_id     m_node_id;
 			};
-
-		protected:
-			std::unordered_map<node_id, std::weak_ptr<polymorphic_node>> m_objects;
 		};
 	}
 }
\ No newline at end of file
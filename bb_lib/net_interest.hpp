@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+namespace bb
+{
+	namespace net
+	{
+		/*
+		 * Positions of spatial nodes for interest management.
+		 * Each node stays in the bucket of its cell until set_position moves it to another cell, so a tick
+		 *  costs one update per moved node and every client region is a local query. The cost per client
+		 *  depends on the density around it rather than the size of the world.
+		 * Positions outside the rectangle are kept in the border cells.
+		 */
+		class interest_grid
+		{
+		public:
+			interest_grid(vec2 a, vec2 b, unsigned resolution, unsigned max_interval)
+				: m_origin(a)
+				, m_size(b - a)
+				, m_resolution(resolution < 1 ? 1 : resolution)
+				, m_max_interval(max_interval < 1 ? 1 : max_interval)
+				, m_cells(m_resolution * m_resolution) { }
+
+			void set_position(node_id id, vec2 pos)
+			{
+				unsigned cell = cell_x(pos.x) + cell_y(pos.y) * m_resolution;
+
+				auto it = m_slots.find(id);
+				if (it == m_slots.end())
+				{
+					m_slots[id] = { cell, (unsigned)m_cells[cell].size() };
+					m_cells[cell].push_back({ id, pos });
+					return;
+				}
+
+				slot& s = it->second;
+				if (s.cell == cell)
+				{
+					m_cells[cell][s.index].pos = pos;
+					return;
+				}
+
+				erase(s);
+				s.cell = cell;
+				s.index = (unsigned)m_cells[cell].size();
+				m_cells[cell].push_back({ id, pos });
+			}
+
+			void remove(node_id id)
+			{
+				auto it = m_slots.find(id);
+				if (it == m_slots.end()) return;
+
+				erase(it->second);
+				m_slots.erase(it);
+			}
+
+			// visit the nodes within radius of centre
+			template <typename Fn>
+			void visit(vec2 centre, float radius, Fn fn) const
+			{
+				float radius2 = radius * radius;
+
+				unsigned loX = cell_x(centre.x - radius), hiX = cell_x(centre.x + radius);
+				unsigned loY = cell_y(centre.y - radius), hiY = cell_y(centre.y + radius);
+
+				for (unsigned y = loY; y <= hiY; ++y)
+				{
+					for (unsigned x = loX; x <= hiX; ++x)
+					{
+						for (const entry& e : m_cells[x + y * m_resolution])
+						{
+							float distance2 = (e.pos - centre).mag2();
+							if (distance2 <= radius2) fn(e.id, sqrtf(distance2));
+						}
+					}
+				}
+			}
+
+			// nodes further away are updated every interval ticks in snapshot mode, up to max_interval at the edge
+			unsigned interval(float distance, float radius) const
+			{
+				if (m_max_interval == 1 || radius <= 0) return 1;
+
+				float t = distance / radius;
+				return 1 + (unsigned)(t * (m_max_interval - 1) + 0.5f);
+			}
+
+			size_t size() const { return m_slots.size(); }
+
+		private:
+			struct entry
+			{
+				node_id id;
+				vec2    pos;
+			};
+
+			struct slot
+			{
+				unsigned cell;
+				unsigned index;
+			};
+
+			// swap with the last entry of the cell, the moved entry takes over the index
+			void erase(const slot& s)
+			{
+				auto &bucket = m_cells[s.cell];
+				if (s.index + 1 != bucket.size())
+				{
+					bucket[s.index] = bucket.back();
+					m_slots[bucket[s.index].id].index = s.index;
+				}
+				bucket.pop_back();
+			}
+
+			// clamped to the grid, NaN ends up in the first cell
+			unsigned cell(float v, float origin, float size) const
+			{
+				float c = (v - origin) / size * m_resolution;
+				if (!(c >= 0)) return 0;
+				if (c >= m_resolution - 1) return m_resolution - 1;
+				return (unsigned)c;
+			}
+
+			unsigned cell_x(float x) const { return cell(x, m_origin.x, m_size.x); }
+			unsigned cell_y(float y) const { return cell(y, m_origin.y, m_size.y); }
+
+			vec2                              m_origin;
+			vec2                              m_size;
+			unsigned                          m_resolution;
+			unsigned                          m_max_interval;
+			std::vector<std::vector<entry>>   m_cells;   // per cell, the nodes in it
+			std::unordered_map<node_id, slot> m_slots;   // per node, its cell and index in that cell
+		};
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+namespace bb
+{
+	namespace net
+	{
+		//------------------------------------------------------------------------------------------------------------
+		// Output stream that collects one outgoing message at a time.
+		// Clearing keeps the allocated memory, so building a message doesn't allocate once the buffer has grown.
+		class message_buffer : public std::ostream
+		{
+		public:
+			message_buffer()
+				: std::ostream(nullptr)
+			{
+				rdbuf(&m_buffer);
+			}
+
+			const char* data() const { return m_buffer.m_data.data(); }
+			size_t      size() const { return m_buffer.m_data.size(); }
+
+			void clear() { m_buffer.m_data.clear(); }
+
+		private:
+			struct buffer : public std::streambuf
+			{
+				int_type overflow(int_type c) override
+				{
+					if (!traits_type::eq_int_type(c, traits_type::eof()))
+						m_data.push_back(traits_type::to_char_type(c));
+
+					return traits_type::not_eof(c);
+				}
+
+				std::streamsize xsputn(const char* s, std::streamsize n) override
+				{
+					m_data.append(s, (size_t)n);
+					return n;
+				}
+
+				std::string m_data;
+			};
+
+			buffer m_buffer;
+		};
+	}
+}
\ No newline at end of file
@@ -14,6 +14,12 @@ namespace bb
 		// Typedefs
 		typedef size_t node_id;
 
+		// node id of the snapshot terminator and acknowledgement messages in snapshot mode
+		static const node_id snapshot_node = (node_id)-1;
+
+		// node id of rpc replies
+		static const node_id reply_node = (node_id)-2;
+
 		typedef const char* type_id;
 				
 		//------------------------------------------------------------------------------------------------------------
@@ -35,20 +41,33 @@ namespace bb
 				this->pm_reflect_rpc(visitor);
 			}
 
-			virtual context* get_context() = 0;
-			virtual node_id  get_node_id() = 0;
-			virtual type_id  get_type_id() = 0;
+			virtual context*  get_context() = 0;
+			virtual node_id   get_node_id() = 0;
+			virtual type_id   get_type_id() = 0;
+			virtual type_key  get_type_key() = 0;
+			virtual member_id get_member_id(const char* tag) = 0;
+			virtual member_id get_member_id(const void* member) = 0;
 		private:
 			virtual void     pm_reflect(BinarySerializer& visitor) = 0;
 			virtual void     pm_reflect(BinaryDeserializer& visitor) = 0;
 			virtual void     pm_reflect(TextSerializer& visitor) = 0;
 			virtual void     pm_reflect(TextDeserializer& visitor) = 0;
+			virtual void     pm_reflect(BufferSerializer& visitor) = 0;
+			virtual void     pm_reflect(BufferDeserializer& visitor) = 0;
+			virtual void     pm_reflect(CompactSerializer& visitor) = 0;
+			virtual void     pm_reflect(CompactDeserializer& visitor) = 0;
 			virtual void     pm_reflect(update_visitor<BinarySerializer>& visitor) = 0;
 			virtual void     pm_reflect(update_visitor<BinaryDeserializer>& visitor) = 0;
 			virtual void     pm_reflect(update_visitor<TextSerializer>& visitor) = 0;
 			virtual void     pm_reflect(update_visitor<TextDeserializer>& visitor) = 0;
+			virtual void     pm_reflect(update_visitor<BufferSerializer>& visitor) = 0;
+			virtual void     pm_reflect(update_visitor<BufferDeserializer>& visitor) = 0;
+			virtual void     pm_reflect(update_visitor<CompactSerializer>& visitor) = 0;
+			virtual void     pm_reflect(update_visitor<CompactDeserializer>& visitor) = 0;
 			virtual void     pm_reflect_rpc(rpc_visitor<BinaryDeserializer>& visitor) = 0;
 			virtual void     pm_reflect_rpc(rpc_visitor<TextDeserializer>& visitor) = 0;
+			virtual void     pm_reflect_rpc(rpc_visitor<BufferDeserializer>& visitor) = 0;
+			virtual void     pm_reflect_rpc(rpc_visitor<CompactDeserializer>& visitor) = 0;
 		};
 				
 		//------------------------------------------------------------------------------------------------------------
@@ -91,6 +110,178 @@ namespace bb
 			polymorphic_node* node_base = nullptr;
 		};
 
+		//------------------------------------------------------------------------------------------------------------
+		// Member table. Lists the members of a node type in reflect order, built once per type
+		//  by running reflect on the first instance. Members are identified by their offset in the object.
+		// Lookups by tag or offset go through hash indices, member_modify is called for every change.
+		template <typename USER_IMPL>
+		class member_table
+		{
+		public:
+			struct member
+			{
+				const char* tag;
+				size_t      offset;
+			};
+
+			static const member_table& get(USER_IMPL& object)
+			{
+				static member_table table(object);
+				return table;
+			}
+
+			member_id find(const char* tag) const
+			{
+				auto it = m_by_tag.find(intern_type(tag));
+				if (it != m_by_tag.end() && strcmp(m_members[it->second].tag, tag) == 0) return it->second;
+
+				throw std::runtime_error("member not found");
+			}
+
+			member_id find(size_t offset) const
+			{
+				auto it = m_by_offset.find(offset);
+				if (it != m_by_offset.end()) return it->second;
+
+				throw std::runtime_error("member not found");
+			}
+
+			const std::vector<member>& members() const { return m_members; }
+
+			// false if reflect visits something that doesn't live inside the object, offsets are useless then
+			bool valid() const { return m_valid; }
+
+			// reflect visitor that fills the table
+			template <typename T>
+			void operator()(const char* tag, T& x)
+			{
+				size_t offset = (size_t)((char*)&x - (char*)m_object);
+				if ((char*)&x < (char*)m_object || offset >= sizeof(USER_IMPL)) m_valid = false;
+
+				m_members.push_back({ tag, offset });
+			}
+
+		private:
+			member_table(USER_IMPL& object)
+				: m_object(&object)
+			{
+				object.reflect(*this);
+
+				if (m_members.size() >= invalid_member) throw std::runtime_error("too many members");
+
+				for (size_t i = 0; i < m_members.size(); ++i)
+				{
+					if (!m_by_tag.emplace(intern_type(m_members[i].tag), (member_id)i).second) throw std::runtime_error("duplicate member tag or tag hash");
+					m_by_offset.emplace(m_members[i].offset, (member_id)i);
+				}
+			}
+
+			std::vector<member> m_members;
+			std::unordered_map<type_key, member_id> m_by_tag;
+			std::unordered_map<size_t, member_id>   m_by_offset;
+			USER_IMPL*          m_object;
+			bool                m_valid = true;
+		};
+
+		//------------------------------------------------------------------------------------------------------------
+		// Update dispatch table. Jumps straight to the updated member instead of walking reflect.
+		template <typename USER_IMPL, typename VISITOR>
+		class member_dispatch_table
+		{
+		public:
+			static const member_dispatch_table& get(USER_IMPL& object)
+			{
+				static member_dispatch_table table(object);
+				return table;
+			}
+
+			void dispatch(USER_IMPL& object, VISITOR& visitor) const
+			{
+				if (visitor.m_member >= m_entries.size()) throw std::runtime_error("member not found");
+
+				auto &entry = m_entries[visitor.m_member];
+				entry.fn(visitor, entry.tag, (char*)&object + entry.offset);
+			}
+
+		private:
+			typedef void(*dispatch_fn)(VISITOR& visitor, const char* tag, void* member);
+
+			struct entry
+			{
+				const char* tag;
+				size_t      offset;
+				dispatch_fn fn;
+			};
+
+			template <typename T>
+			static void apply(VISITOR& visitor, const char* tag, void* member)
+			{
+				visitor.apply(tag, *reinterpret_cast<T*>(member));
+			}
+
+			struct builder
+			{
+				std::vector<entry>& entries;
+				size_t              index;
+
+				template <typename T>
+				void operator()(const char* tag, T& x)
+				{
+					entries[index].fn = &apply<T>;
+					index++;
+				}
+			};
+
+			member_dispatch_table(USER_IMPL& object)
+			{
+				auto &table = member_table<USER_IMPL>::get(object);
+				for (auto &m : table.members())
+					m_entries.push_back({ m.tag, m.offset, nullptr });
+
+				builder b = { m_entries, 0 };
+				object.reflect(b);
+			}
+
+			std::vector<entry> m_entries;
+		};
+
+		//------------------------------------------------------------------------------------------------------------
+		// RPC method table. Maps the tags in reflect_rpc to their position, built once per node type
+		//  so a call costs a single hash lookup instead of a string compare against every rpc.
+		template <typename USER_IMPL, typename VISITOR>
+		class rpc_table
+		{
+		public:
+			static const rpc_table& get(USER_IMPL& object, VISITOR& visitor)
+			{
+				static rpc_table table(object, visitor);
+				return table;
+			}
+
+			unsigned find(const std::string& tag) const
+			{
+				auto it = m_index.find(tag);
+				if (it == m_index.end()) throw std::runtime_error("rpc not found");
+
+				return it->second;
+			}
+
+		private:
+			rpc_table(USER_IMPL& object, VISITOR& visitor)
+			{
+				std::vector<std::string> tags;
+
+				VISITOR collector(visitor.m_serializer, "");
+				collector.m_collect = &tags;
+				object.reflect_rpc(collector);
+
+				for (unsigned i = 0; i < tags.size(); ++i)
+					if (!m_index.emplace(tags[i], i).second) throw std::runtime_error("duplicate tag detected");
+			}
+
+			std::unordered_map<std::string, unsigned> m_index;
+		};
+
 		//------------------------------------------------------------------------------------------------------------
 		// Node wrapper. Wraps around a node object, thereby declaring it as a node.
 		// Dispatches all visitors to the wrapped object
@@ -125,10 +316,12 @@ namespace bb
 			 *    }
 			 *
 			 *    Note that members are visited using a /tag/, this is required so that the reflect system
-			 *     can find the same member later on. It is important that the order of tags remains the same.
+			 *     can find the same member later on. It is important that the order of tags remains the same,
+			 *     updates identify a member by its position in reflect.
 			 *
 			 * 2) Nodes require a static function that returns their type as a unique string.
-			 *    This type is used to construct matching nodes of the proper type.
+			 *    This type is used to construct matching nodes of the proper type,
+			 *     on the wire it is sent as a hash (see intern_type) which must be unique as well.
 			 *    If you have dedicated server and client node types,
 			 *     make sure their reflect(...) and node_type() match!
 			 *
@@ -138,28 +331,45 @@ namespace bb
 			 *    template <typename VISITOR>
 			 *    void reflect_rpc(VISITOR& visitor)
 			 *    {
-			 *        visitor("rpcName", [&](VISITOR::Params& params)
+			 *        visitor("rpcName", [&](typename VISITOR::Params& params)
 			 *        {
 			 *            int a, b, c;
 			 *            params.get(a, b, c);
 			 *        });
 			 *    }
+			 *
+			 *    A handler may return a value, clients that use call<R>(...) instead of rpc(...) get it back:
+			 *
+			 *        visitor("sum", [&](typename VISITOR::Params& params) -> int { ... return a + b; });
 			 */
 
-			context* get_context() override                                            { return m_context; }
-			node_id  get_node_id() override                                            { return m_node_id; }
-			type_id  get_type_id() override                                            { return usr_type::node_type(); }
+			context*  get_context() override                                           { return this->m_context; }
+			node_id   get_node_id() override                                           { return this->m_node_id; }
+			type_id   get_type_id() override                                           { return usr_type::node_type(); }
+			type_key  get_type_key() override                                          { static const type_key key = intern_type(usr_type::node_type()); return key; }
+			member_id get_member_id(const char* tag) override                          { return member_table<usr_type>::get(*this).find(tag); }
+			member_id get_member_id(const void* member) override                       { return member_table<usr_type>::get(*this).find((size_t)((const char*)member - (const char*)static_cast<usr_type*>(this))); }
 		private:
 			void     pm_reflect(BinarySerializer& visitor) override                    { usr_type::reflect(visitor); }
 			void     pm_reflect(BinaryDeserializer& visitor) override                  { usr_type::reflect(visitor); }
 			void     pm_reflect(TextSerializer& visitor) override                      { usr_type::reflect(visitor); }
 			void     pm_reflect(TextDeserializer& visitor) override                    { usr_type::reflect(visitor); }
-			void     pm_reflect(update_visitor<BinarySerializer>& visitor) override    { usr_type::reflect(visitor); }
-			void     pm_reflect(update_visitor<BinaryDeserializer>& visitor) override  { usr_type::reflect(visitor); }
-			void     pm_reflect(update_visitor<TextSerializer>& visitor) override      { usr_type::reflect(visitor); }
-			void     pm_reflect(update_visitor<TextDeserializer>& visitor) override    { usr_type::reflect(visitor); }
+			void     pm_reflect(BufferSerializer& visitor) override                    { usr_type::reflect(visitor); }
+			void     pm_reflect(BufferDeserializer& visitor) override                  { usr_type::reflect(visitor); }
+			void     pm_reflect(CompactSerializer& visitor) override                   { usr_type::reflect(visitor); }
+			void     pm_reflect(CompactDeserializer& visitor) override                 { usr_type::reflect(visitor); }
+			void     pm_reflect(update_visitor<BinarySerializer>& visitor) override    { _update(visitor); }
+			void     pm_reflect(update_visitor<BinaryDeserializer>& visitor) override  { _update(visitor); }
+			void     pm_reflect(update_visitor<TextSerializer>& visitor) override      { _update(visitor); }
+			void     pm_reflect(update_visitor<TextDeserializer>& visitor) override    { _update(visitor); }
+			void     pm_reflect(update_visitor<BufferSerializer>& visitor) override    { _update(visitor); }
+			void     pm_reflect(update_visitor<BufferDeserializer>& visitor) override  { _update(visitor); }
+			void     pm_reflect(update_visitor<CompactSerializer>& visitor) override   { _update(visitor); }
+			void     pm_reflect(update_visitor<CompactDeserializer>& visitor) override { _update(visitor); }
 			void     pm_reflect_rpc(rpc_visitor<BinaryDeserializer>& visitor) override { _rpc<gen_rpc>(visitor); }
 			void     pm_reflect_rpc(rpc_visitor<TextDeserializer>& visitor) override   { _rpc<gen_rpc>(visitor); }
+			void     pm_reflect_rpc(rpc_visitor<BufferDeserializer>& visitor) override { _rpc<gen_rpc>(visitor); }
+			void     pm_reflect_rpc(rpc_visitor<CompactDeserializer>& visitor) override { _rpc<gen_rpc>(visitor); }
 
 			template <typename IMPL>
 			typename std::enable_if<!std::is_base_of<server_utils_tag, IMPL>::value>::type _link_svr() { /*...*/ }
@@ -170,27 +380,44 @@ namespace bb
 			template <typename IMPL>
 			typename std::enable_if<std::is_base_of<server_utils_tag, IMPL>::value>::type _link_svr()
 			{
-				usr_type::svrsvc = dynamic_cast<usr_type::server_node_base*>(this);
+				usr_type::svrsvc = dynamic_cast<typename usr_type::server_node_base*>(this);
 				usr_type::node_base = usr_type::svrsvc;
 			}
 
 			template <typename IMPL>
 			typename std::enable_if<std::is_base_of<client_utils_tag, IMPL>::value>::type _link_clt()
 			{
-				usr_type::cltsvc = dynamic_cast<usr_type::client_node_base*>(this);
+				usr_type::cltsvc = dynamic_cast<typename usr_type::client_node_base*>(this);
 				usr_type::node_base = usr_type::cltsvc;
 			}
 
+			template <typename VISITOR>
+			void _update(VISITOR& visitor)
+			{
+				usr_type& self = *this;
+
+				if (member_table<usr_type>::get(self).valid())
+				{
+					member_dispatch_table<usr_type, VISITOR>::get(self).dispatch(self, visitor);
+				}
+				else
+				{
+					usr_type::reflect(visitor);
+				}
+			}
+
 			template <typename GEN, typename VISITOR>
 			typename std::enable_if<std::is_same<GEN, std::false_type>::value, void>::type _rpc(VISITOR& visitor)
 			{
-				throw std::exception("unsupported operation");
+				throw std::runtime_error("unsupported operation");
 			}
 
 			template <typename GEN, typename VISITOR>
 			typename std::enable_if<std::is_same<GEN, std::true_type>::value, void>::type _rpc(VISITOR& visitor)
 			{
 				// If you get compiler errors, your node might be invalid. Scroll up for a manual.
+				usr_type& self = *this;
+				visitor.m_index = rpc_table<usr_type, VISITOR>::get(self, visitor).find(visitor.m_tag);
 				usr_type::reflect_rpc(visitor);
 			}
 		};
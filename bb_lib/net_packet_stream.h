@@ -0,0 +1,70 @@
+#pragma once
+
+#include <functional>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace bb
+{
+	namespace net
+	{
+		/*
+		 * Stream buffers that connect the stream based serializers to packet transports.
+		 * Received payload is appended to the input side and read by the deserializers without blocking,
+		 *  everything written to the output side between two flushes is handed to the transport as one packet.
+		 */
+		class packet_input_buffer : public std::streambuf
+		{
+		public:
+			void append(const char* data, size_t size)
+			{
+				// drop what the deserializers already consumed, the rest moves to the front
+				size_t consumed = gptr() - eback();
+				m_data.erase(m_data.begin(), m_data.begin() + consumed);
+				m_data.insert(m_data.end(), data, data + size);
+
+				setg(m_data.data(), m_data.data(), m_data.data() + m_data.size());
+			}
+
+		private:
+			std::vector<char> m_data;
+		};
+
+		class packet_output_buffer : public std::streambuf
+		{
+		public:
+			using sink = std::function<void(const char* data, size_t size)>;
+
+			packet_output_buffer(sink send)
+				: m_send(send) { }
+
+		protected:
+			int_type overflow(int_type c) override
+			{
+				if (!traits_type::eq_int_type(c, traits_type::eof()))
+					m_packet.push_back(traits_type::to_char_type(c));
+
+				return traits_type::not_eof(c);
+			}
+
+			std::streamsize xsputn(const char* s, std::streamsize n) override
+			{
+				m_packet.append(s, (size_t)n);
+				return n;
+			}
+
+			int sync() override
+			{
+				if (!m_packet.empty()) m_send(m_packet.data(), m_packet.size());
+
+				m_packet.clear();
+				return 0;
+			}
+
+		private:
+			sink        m_send;
+			std::string m_packet;
+		};
+	}
+}
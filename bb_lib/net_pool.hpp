@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+
+namespace bb
+{
+	namespace net
+	{
+		/*
+		 * Free list of equally sized blocks, used to allocate client nodes of one type.
+		 * Blocks are carved from chunks that live as long as the pool, released blocks are reused
+		 *  by the next allocation, so a resync that replaces a large part of the world mostly recycles memory.
+		 */
+		class node_pool
+		{
+		public:
+			node_pool(size_t chunk_blocks = 64)
+				: m_chunk_blocks(chunk_blocks) { }
+
+			void* allocate(size_t size)
+			{
+				// the first allocation fixes the block size, other sizes bypass the pool
+				if (!m_block) m_block = (size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+				if (size > m_block) return ::operator new(size);
+
+				if (m_free.empty()) grow();
+
+				void* p = m_free.back();
+				m_free.pop_back();
+				return p;
+			}
+
+			void deallocate(void* p, size_t size)
+			{
+				if (size > m_block) ::operator delete(p);
+				else m_free.push_back(p);
+			}
+
+			size_t capacity() const { return m_chunks.size() * m_chunk_blocks; }
+			size_t available() const { return m_free.size(); }
+
+		private:
+			void grow()
+			{
+				m_chunks.emplace_back(new max_align_block[m_block / sizeof(max_align_block) * m_chunk_blocks]);
+
+				char* chunk = reinterpret_cast<char*>(m_chunks.back().get());
+				for (size_t i = m_chunk_blocks; i-- > 0;)
+					m_free.push_back(chunk + i * m_block);
+			}
+
+			struct alignas(std::max_align_t) max_align_block { char data[alignof(std::max_align_t)]; };
+
+			size_t                                           m_block = 0;
+			size_t                                           m_chunk_blocks;
+			std::vector<void*>                               m_free;
+			std::vector<std::unique_ptr<max_align_block[]>>  m_chunks;
+		};
+
+		// Allocator for std::allocate_shared, every copy (including the one kept in the control block) shares the pool
+		template <typename T>
+		class pool_allocator
+		{
+		public:
+			using value_type = T;
+
+			pool_allocator(std::shared_ptr<node_pool> pool)
+				: m_pool(pool) { }
+
+			template <typename U>
+			pool_allocator(const pool_allocator<U>& other)
+				: m_pool(other.m_pool) { }
+
+			T* allocate(size_t n)              { return static_cast<T*>(m_pool->allocate(n * sizeof(T))); }
+			void deallocate(T* p, size_t n)    { m_pool->deallocate(p, n * sizeof(T)); }
+
+			template <typename U> bool operator==(const pool_allocator<U>& other) const { return m_pool == other.m_pool; }
+			template <typename U> bool operator!=(const pool_allocator<U>& other) const { return m_pool != other.m_pool; }
+
+		private:
+			template <typename U> friend class pool_allocator;
+
+			std::shared_ptr<node_pool> m_pool;
+		};
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+namespace bb
+{
+	namespace net
+	{
+		/*
+		 * Reply of an rpc made with client_node_base::call.
+		 * Calls are pipelined: keep issuing them, client::flush() sends everything written so far
+		 *  as one packet and client::update() resolves the futures as the replies come in.
+		 */
+		template <typename R>
+		class rpc_future
+		{
+		public:
+			struct state
+			{
+				bool                           ready = false;
+				R                              value;
+				std::function<void(const R&)>  callback;
+
+				void resolve()
+				{
+					ready = true;
+					if (callback) callback(value);
+				}
+			};
+
+			rpc_future(std::shared_ptr<state> s)
+				: m_state(s) { }
+
+			bool ready() const { return m_state->ready; }
+
+			const R& get() const
+			{
+				if (!m_state->ready) throw std::runtime_error("rpc reply not received");
+				return m_state->value;
+			}
+
+			// runs fn when the reply arrives, or right away if it already did
+			void then(std::function<void(const R&)> fn)
+			{
+				if (m_state->ready) fn(m_state->value);
+				else m_state->callback = fn;
+			}
+
+			template <typename Deserializer>
+			static void read(Deserializer& ser, state& s)
+			{
+				type_key type;
+				ser("type", type);
+				if (type != result_type<R>()) throw std::runtime_error("rpc reply type mismatch");
+
+				ser("val", s.value);
+				s.resolve();
+			}
+
+		private:
+			std::shared_ptr<state> m_state;
+		};
+
+		template <>
+		class rpc_future<void>
+		{
+		public:
+			struct state
+			{
+				bool                  ready = false;
+				std::function<void()> callback;
+
+				void resolve()
+				{
+					ready = true;
+					if (callback) callback();
+				}
+			};
+
+			rpc_future(std::shared_ptr<state> s)
+				: m_state(s) { }
+
+			bool ready() const { return m_state->ready; }
+
+			void then(std::function<void()> fn)
+			{
+				if (m_state->ready) fn();
+				else m_state->callback = fn;
+			}
+
+			template <typename Deserializer>
+			static void read(Deserializer& ser, state& s)
+			{
+				type_key type;
+				ser("type", type);
+				if (type != result_type<void>()) throw std::runtime_error("rpc reply type mismatch");
+
+				s.resolve();
+			}
+
+		private:
+			std::shared_ptr<state> m_state;
+		};
+	}
+}
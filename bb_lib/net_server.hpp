@@ -12,9 +12,20 @@ namespace bb
 			using Serializer = SERIALIZER;
 			using server_client_type = server_client<Deserializer, Serializer>;
 
+			// traffic sent to clients since the last flush()
+			struct tick_stats
+			{
+				size_t bytes = 0;
+				size_t messages = 0;
+				size_t merged = 0;
+			};
+
 			server() 
 				: m_node_id_counter(0)
-				, m_message_serializer(m_message_buffer) {}
+				, m_message_serializer(m_message_buffer)
+			{
+				m_reference_ids.set_references_only(true);
+			}
 			
 			using node_base_type = server_node_base<Deserializer, Serializer>;
 
@@ -27,7 +38,7 @@ namespace bb
 				node_type<T> n = std::make_shared<node<T, node_base_type, std::true_type>>(this, T::node_type(), m_node_id_counter++);
 				if (parent)
 				{
-					n->m_referenced_by.push_back(std::dynamic_pointer_cast<node_base_type>(parent));
+					n->add_referrer(std::dynamic_pointer_cast<node_base_type>(parent));
 				}
 				m_objects[n->get_node_id()] = n;
 				return n;
@@ -46,45 +57,489 @@ namespace bb
 
 				auto client = std::make_shared<server_client<Deserializer, Serializer>>(clt_in, clt_out, clt_root);
 
-				clt_root->m_owner = client.get();
+				clt_root->set_owner(client.get());
+				m_clients.push_back(client);
+				m_all_regions = false;
 				clt_root->resync();
 
 				return client;
 			}
 
+			/*
+			 * In batching mode changes are queued per client and only sent by flush().
+			 * Queued changes that are completely overwritten by a later change are dropped.
+			 */
+			void set_batching(bool batching)
+			{
+				if (m_batching && !batching) flush();
+				m_batching = batching;
+			}
+
+			/*
+			 * In snapshot mode member changes only mark the member dirty for the subscribed clients.
+			 * flush() then sends every dirty or unacknowledged member whose state differs from what the
+			 *  client last acknowledged, followed by a terminator the client acknowledges.
+			 * A client that leaves more than max_unacked snapshots unacknowledged gets a full resync.
+			 */
+			void set_snapshots(bool snapshots, size_t max_unacked = 32)
+			{
+				m_snapshot_mode = snapshots;
+				m_max_unacked = max_unacked;
+			}
+
+			/*
+			 * Interest management: nodes with a position (server_node_base::set_position) only send changes
+			 *  to subscribed clients whose region contains them, clients without a region receive everything.
+			 * A node that enters a region is sent in full, a node that leaves it is sent as update_op::Leave,
+			 *  after which the client keeps its last state until it enters again (client_node_base::in_interest).
+			 * In snapshot mode nodes further away are updated less often, every max_interval ticks at the edge
+			 *  of the region.
+			 */
+			void enable_interest(vec2 a, vec2 b, unsigned resolution, unsigned max_interval = 1)
+			{
+				m_interest.reset(new interest_grid(a, b, resolution, max_interval));
+
+				// nodes positioned before interest management was enabled
+				for (auto &x : m_objects)
+				{
+					auto node = std::dynamic_pointer_cast<node_base_type, polymorphic_node>(x.second.lock());
+					if (node && node->m_spatial) m_interest->set_position(x.first, node->m_position);
+				}
+			}
+
+			void set_interest_region(server_client_type* clt, vec2 centre, float radius)
+			{
+				clt->m_has_region = true;
+				clt->m_region_centre = centre;
+				clt->m_region_radius = radius;
+			}
+
+			// end of a network tick: send everything that was queued and start counting a new tick
+			void flush()
+			{
+				m_tick_count++;
+
+				bool all_regions = true;
+				m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(), [&](std::weak_ptr<server_client_type>& ptr)
+				{
+					if (auto clt = ptr.lock())
+					{
+						flush_client(*clt);
+						if (m_snapshot_mode)
+						{
+							send_snapshot(*clt);
+							send_replies(*clt);
+						}
+
+						// after the tick's changes, they may introduce the nodes that enter the region
+						if (m_interest)
+						{
+							update_interest(*clt);
+							flush_client(*clt);
+						}
+						all_regions = all_regions && clt->m_has_region;
+						return false;
+					}
+
+					return true;
+				}), m_clients.end());
+
+				// from now on changes of nodes outside every region can be dropped right away
+				m_all_regions = m_interest && all_regions;
+
+				m_last_tick = m_tick;
+				m_tick = tick_stats();
+			}
+
+			// traffic of the last completed tick
+			const tick_stats& get_tick_stats() const { return m_last_tick; }
+
 			void update_client(server_client<Deserializer, Serializer>* clt)
 			{
+				std::shared_ptr<polymorphic_node> node;
+				node_id                           node_id_cached = snapshot_node;
+				bool                              replied = false;
+
 				while (clt->m_clt_in)
 				{
 					node_id id;
 					std::string tag;
+					uint32_t call;
 					clt->m_clt_in("node", id);
 					clt->m_clt_in("rpc", tag);
 
-					// find appropriate node
-					auto it = m_objects.find(id);
-					if (it == m_objects.end())
+					if (id == snapshot_node)
 					{
-						throw std::exception("node not found");
+						uint32_t seq;
+						clt->m_clt_in("seq", seq);
+						acknowledge(*clt, seq);
+						continue;
 					}
 
-					if (auto node = it->second.lock())
+					clt->m_clt_in("call", call);
+
+					// batched calls usually go to the same node, skip the lookup then
+					if (!node || id != node_id_cached)
 					{
-						node->reflect_rpc(rpc_visitor<Deserializer>(clt->m_clt_in, tag.c_str()));
+						// find appropriate node
+						auto it = m_objects.find(id);
+						if (it == m_objects.end())
+						{
+							throw std::runtime_error("node not found");
+						}
+
+						node = it->second.lock();
+						if (!node)
+						{
+							throw std::runtime_error("node expired!!!");
+						}
+						node_id_cached = id;
 					}
-					else
+
+					rpc_visitor<Deserializer> visitor(clt->m_clt_in, tag.c_str());
+					node->reflect_rpc(visitor);
+
+					if (call)
 					{
-						throw std::exception("node expired!!!");
+						reply(*clt, call, visitor.m_result);
+						replied = true;
 					}
 				}
+
+				// all replies to a batch of calls go out together
+				if (replied && !m_batching && !m_snapshot_mode) clt->m_clt_out.flush();
 			}
 
 		private:
 			friend node_base_type;
 
+			using pending_message = typename server_client_type::pending_message;
+
+			// hand the message in m_message_buffer to a subscriber
+			void deliver(server_client_type* clt, node_id node, update_op op, member_id member, bool references)
+			{
+				if (m_snapshot_mode && op != update_op::Replace && op != update_op::Leave)
+				{
+					mark_dirty(*clt, member_key(node, member));
+				}
+				else if (m_batching)
+				{
+					clt->m_pending_messages.push_back({ node, member, op, references, false, clt->m_pending.size(), m_message_buffer.size() });
+					clt->m_pending.append(m_message_buffer.data(), m_message_buffer.size());
+				}
+				else
+				{
+					clt->m_clt_out.write(m_message_buffer.data(), m_message_buffer.size());
+					clt->m_clt_out.flush();
+
+					m_tick.bytes += m_message_buffer.size();
+					m_tick.messages++;
+				}
+			}
+
+			// replies never overtake the changes a call made: in snapshot mode they wait for the next snapshot,
+			//  in batching mode they are queued like other messages
+			void reply(server_client_type& clt, uint32_t call, rpc_result& result)
+			{
+				node_id id = reply_node;
+				m_message_serializer("node", id);
+				m_message_serializer("call", call);
+
+				type_key type = result.type();
+				m_message_serializer("type", type);
+				if (!result.empty()) result.write(m_message_serializer);
+
+				if (m_snapshot_mode)
+				{
+					clt.m_replies.append(m_message_buffer.data(), m_message_buffer.size());
+				}
+				else if (m_batching)
+				{
+					clt.m_pending_messages.push_back({ reply_node, invalid_member, update_op::Update, true, false, clt.m_pending.size(), m_message_buffer.size() });
+					clt.m_pending.append(m_message_buffer.data(), m_message_buffer.size());
+				}
+				else
+				{
+					clt.m_clt_out.write(m_message_buffer.data(), m_message_buffer.size());
+
+					m_tick.bytes += m_message_buffer.size();
+					m_tick.messages++;
+				}
+
+				m_message_buffer.clear();
+			}
+
+			void send_replies(server_client_type& clt)
+			{
+				if (clt.m_replies.empty()) return;
+
+				clt.m_clt_out.write(clt.m_replies.data(), clt.m_replies.size());
+				clt.m_clt_out.flush();
+
+				m_tick.bytes += clt.m_replies.size();
+				m_tick.messages++;
+				clt.m_replies.clear();
+			}
+
+			void flush_client(server_client_type& clt)
+			{
+				auto &messages = clt.m_pending_messages;
+				if (messages.empty()) return;
+
+				// walk backwards, a message is superseded by a later replace of its node or a later update of its member.
+				// messages that carry node references are always kept, they may introduce nodes that later messages need.
+				m_replaced_nodes.clear();
+				m_updated_members.clear();
+				for (size_t i = messages.size(); i-- > 0;)
+				{
+					auto &msg = messages[i];
+					size_t key = member_key(msg.node, msg.member);
+
+					if (!msg.references && (m_replaced_nodes.count(msg.node) || m_updated_members.count(key)))
+					{
+						msg.superseded = true;
+						m_tick.merged++;
+					}
+
+					if (msg.op == update_op::Replace) m_replaced_nodes.insert(msg.node);
+					if (msg.op == update_op::Update)  m_updated_members.insert(key);
+				}
+
+				for (auto &msg : messages)
+				{
+					if (msg.superseded) continue;
+
+					clt.m_clt_out.write(&clt.m_pending[msg.offset], msg.size);
+
+					m_tick.bytes += msg.size;
+					m_tick.messages++;
+				}
+				clt.m_clt_out.flush();
+
+				clt.m_pending.clear();
+				messages.clear();
+			}
+
+			static size_t member_key(node_id node, member_id member) { return node * 0x10000 + member; }
+
+			bool relevant(server_client_type* clt, node_id node) const
+			{
+				return !m_interest || !clt->m_has_region || clt->m_visible.count(node) != 0;
+			}
+
+			// distant nodes skip snapshots, staggered by node id
+			bool due(server_client_type& clt, node_id node) const
+			{
+				auto it = clt.m_visible.find(node);
+				return it == clt.m_visible.end() || it->second <= 1 || (m_tick_count + node) % it->second == 0;
+			}
+
+			std::shared_ptr<node_base_type> find_node(node_id id) const
+			{
+				auto it = m_objects.find(id);
+				if (it == m_objects.end()) return nullptr;
+				return std::dynamic_pointer_cast<node_base_type, polymorphic_node>(it->second.lock());
+			}
+
+			void update_interest(server_client_type& clt)
+			{
+				if (!clt.m_has_region) return;
+
+				clt.m_visible_next.clear();
+				m_expired.clear();
+				m_interest->visit(clt.m_region_centre, clt.m_region_radius, [&](node_id id, float distance)
+				{
+					auto node = find_node(id);
+					if (!node)
+					{
+						// destroyed nodes leave the grid the first time a region finds them
+						m_expired.push_back(id);
+						return;
+					}
+
+					if (clt.m_visible_next.count(id)) return;
+					clt.m_visible_next[id] = m_interest->interval(distance, clt.m_region_radius);
+
+					// entered the region, the client may have missed changes
+					if (clt.m_visible.count(id) == 0)
+					{
+						node->m_watchers++;
+						if (node->subscribed(&clt)) node->replace(&clt);
+					}
+				});
+
+				for (node_id id : m_expired) m_interest->remove(id);
+
+				for (auto &x : clt.m_visible)
+				{
+					if (clt.m_visible_next.count(x.first)) continue;
+
+					auto node = find_node(x.first);
+					if (!node) continue;
+
+					node->m_watchers--;
+					if (node->subscribed(&clt)) node->leave(&clt);
+				}
+				std::swap(clt.m_visible, clt.m_visible_next);
+			}
+
+			void send_snapshot(server_client_type& clt)
+			{
+				if (clt.m_snapshots.size() >= m_max_unacked)
+				{
+					// the client stopped acknowledging, start over from a full state
+					clt.m_snapshots.clear();
+					clt.m_baseline.clear();
+					clt.m_dirty.clear();
+					clt.m_dirty_set.clear();
+
+					if (auto root = std::dynamic_pointer_cast<node_base_type, polymorphic_node>(clt.m_root))
+						root->resync();
+					return;
+				}
+
+				// members that were sent but not acknowledged are compared again, the earlier send may be lost.
+				// after those the dirty members follow in the order they changed, a change that introduces
+				//  a node to the client then comes before the changes of that node.
+				m_candidates.clear();
+				m_seen.clear();
+				for (auto &snap : clt.m_snapshots)
+					for (auto &member : snap.members)
+						if (m_seen.insert(member.first).second) m_candidates.push_back(member.first);
+
+				for (size_t key : clt.m_dirty)
+					if (m_seen.insert(key).second) m_candidates.push_back(key);
+
+				clt.m_dirty.clear();
+				clt.m_dirty_set.clear();
+
+				bool unacked = !clt.m_snapshots.empty();
+
+				typename server_client_type::snapshot snap;
+				m_references.clear();
+				m_payloads.clear();
+				for (size_t key : m_candidates)
+				{
+					node_id   id = key / 0x10000;
+					member_id member = (member_id)(key % 0x10000);
+
+					if (!due(clt, id))
+					{
+						mark_dirty(clt, key);
+						continue;
+					}
+
+					auto it = m_objects.find(id);
+					auto node = it != m_objects.end() ? it->second.lock() : nullptr;
+					if (!node)
+					{
+						clt.m_baseline.erase(key);
+						continue;
+					}
+
+					update_op update = update_op::Update;
+					update_visitor<Serializer> visitor(m_message_serializer, member, update, nullptr, nullptr, nullptr);
+					m_message_serializer("node", id);
+					m_message_serializer("op", update);
+					m_message_serializer("member", member);
+					node->reflect(visitor);
+
+					std::string state(m_message_buffer.data(), m_message_buffer.size());
+					m_message_buffer.clear();
+
+					// referenced nodes are written in full but have baselines of their own,
+					//  members that refer to nodes are compared by the ids they refer to
+					std::string compared;
+					if (visitor.m_references)
+					{
+						m_reference_ids.clear();
+						update_visitor<BufferSerializer> ids(m_reference_ids, member, update, nullptr, nullptr, nullptr);
+						node->reflect(ids);
+						compared.assign(m_reference_ids.data(), m_reference_ids.size());
+					}
+
+					// field level delta: unchanged members are skipped
+					auto baseline = clt.m_baseline.find(key);
+					if (baseline != clt.m_baseline.end() && baseline->second == (visitor.m_references ? compared : state))
+						continue;
+
+					snap.members.emplace_back(key, visitor.m_references ? std::move(compared) : state);
+					m_payloads.push_back(std::move(state));
+					m_references.push_back(visitor.m_references);
+				}
+
+				// members that reference nodes go first, they may introduce nodes the others update
+				for (int pass = 0; pass < 2; ++pass)
+				{
+					for (size_t i = 0; i < snap.members.size(); ++i)
+					{
+						if (m_references[i] != (pass == 0)) continue;
+
+						auto &state = m_payloads[i];
+						clt.m_clt_out.write(state.data(), state.size());
+						m_tick.bytes += state.size();
+						m_tick.messages++;
+					}
+				}
+
+				// nothing changed and the client is up to date, skip the terminator too
+				if (snap.members.empty() && !unacked) return;
+
+				snap.seq = ++clt.m_snapshot_seq;
+
+				node_id terminator = snapshot_node;
+				m_message_serializer("node", terminator);
+				m_message_serializer("seq", snap.seq);
+				clt.m_clt_out.write(m_message_buffer.data(), m_message_buffer.size());
+				clt.m_clt_out.flush();
+				m_tick.bytes += m_message_buffer.size();
+				m_message_buffer.clear();
+
+				clt.m_snapshots.push_back(std::move(snap));
+			}
+
+			static void mark_dirty(server_client_type& clt, size_t key)
+			{
+				if (clt.m_dirty_set.insert(key).second) clt.m_dirty.push_back(key);
+			}
+
+			// the client applied everything up to seq, that state becomes the baseline
+			void acknowledge(server_client_type& clt, uint32_t seq)
+			{
+				while (!clt.m_snapshots.empty() && clt.m_snapshots.front().seq <= seq)
+				{
+					for (auto &member : clt.m_snapshots.front().members)
+						clt.m_baseline[member.first] = std::move(member.second);
+
+					clt.m_snapshots.pop_front();
+				}
+			}
+
+			std::unordered_map<node_id, std::weak_ptr<polymorphic_node>> m_objects;
+
 			node_id            m_node_id_counter;
-			std::ostringstream m_message_buffer;
+			message_buffer     m_message_buffer;
 			Serializer         m_message_serializer;
+
+			bool               m_batching = false;
+			bool               m_snapshot_mode = false;
+			size_t             m_max_unacked = 32;
+			size_t             m_tick_count = 0;
+			bool               m_all_regions = false;   // every client has an interest region, see flush()
+
+			std::unique_ptr<interest_grid>                 m_interest;
+			std::vector<size_t>                            m_candidates;
+			std::unordered_set<size_t>                     m_seen;
+			std::vector<node_id>                           m_expired;
+			std::vector<bool>                              m_references;
+			std::vector<std::string>                       m_payloads;
+			BufferSerializer                               m_reference_ids;
+			tick_stats         m_tick;
+			tick_stats         m_last_tick;
+
+			std::vector<std::weak_ptr<server_client_type>> m_clients;
+			std::unordered_set<node_id>                    m_replaced_nodes;
+			std::unordered_set<size_t>                     m_updated_members;
 		};
 	}
 }
\ No newline at end of file
@@ -29,9 +29,47 @@ namespace bb
 			friend node_type;
 			friend server_type;
 
+			// message waiting for the next flush in batching mode, located in m_pending
+			struct pending_message
+			{
+				node_id   node;
+				member_id member;
+				update_op op;
+				bool      references;
+				bool      superseded;
+				size_t    offset;
+				size_t    size;
+			};
+
+			// members sent in a snapshot that the client did not acknowledge yet
+			struct snapshot
+			{
+				uint32_t                                    seq;
+				std::vector<std::pair<size_t, std::string>> members;
+			};
+
 			Deserializer  m_clt_in;
 			std::ostream &m_clt_out;
 			std::shared_ptr<polymorphic_node> m_root;
+
+			std::string                  m_pending;
+			std::vector<pending_message> m_pending_messages;
+
+			// rpc replies in snapshot mode, they follow the snapshot with the changes the calls made
+			std::string                  m_replies;
+
+			std::vector<size_t>                     m_dirty;        // in the order the members changed
+			std::unordered_set<size_t>              m_dirty_set;
+			std::unordered_map<size_t, std::string> m_baseline;
+			std::deque<snapshot>                    m_snapshots;
+			uint32_t                                m_snapshot_seq = 0;
+
+			// area of interest, nodes in m_visible map to their update interval
+			bool                                  m_has_region = false;
+			vec2                                  m_region_centre;
+			float                                 m_region_radius = 0;
+			std::unordered_map<node_id, unsigned> m_visible;
+			std::unordered_map<node_id, unsigned> m_visible_next;
 		};
 	}
 }
\ No newline at end of file
@@ -1,7 +1,5 @@
 #pragma once
 
-#include <Windows.h>
-#include <sstream>
 #include <algorithm>
 
 namespace bb
@@ -20,107 +18,98 @@ namespace bb
 
 			server_node_base(context* context, const char* type_id, node_id node_id)
 				: context::node_base(context, type_id, node_id)
+				, m_server((server_type*)context)
 				, m_message_buffer(((server_type*)context)->m_message_buffer)
 				, m_message_serializer(((server_type*)context)->m_message_serializer)
 				, m_owner(nullptr) { }
 
-			virtual ~server_node_base() { }
+			virtual ~server_node_base()
+			{
+				for (auto &x : m_referencing)
+				{
+					if (auto target = x.second.lock())
+					{
+						target->m_referenced_by.erase(this);
+						target->invalidate();
+					}
+				}
+				for (auto &x : m_referenced_by)
+				{
+					if (auto referrer = x.second.lock()) referrer->m_referencing.erase(this);
+				}
+			}
 
 			void resync()
 			{
-				// resync only serializes what we already have, 
-				//  no reference resolving required because they are server side only.
+				write_replace();
+				send(update_op::Replace, invalid_member, true);
+			}
 
-				update_op replace = update_op::Replace;
-				m_message_serializer("node", m_node_id);
-				m_message_serializer("op", replace);
-				m_message_serializer("val", shared_from_this());
-				send();
+			// position for interest management, kept until server::enable_interest when that comes later
+			void set_position(vec2 pos)
+			{
+				m_spatial = true;
+				m_position = pos;
+				if (m_server->m_interest) m_server->m_interest->set_position(m_node_id, pos);
 			}
 
 			template <typename T>
 			void member_modify(const char *tag, T& x)
 			{
-				update_visitor<Serializer> visitor(m_message_serializer, tag, update_op::Update, nullptr, (void*)&x, this);
-				m_message_serializer("node", m_node_id);
-				m_message_serializer("op", visitor.m_operation);
-				m_message_serializer("tag", visitor.m_tag);
-				reflect(visitor);
-				send();
+				update(get_member_id(tag), update_op::Update, nullptr, (void*)&x);
+			}
+
+			// identify the member by address instead of tag, e.g. member_modify(m_foo, newFoo)
+			template <typename T>
+			void member_modify(T& member, T& x)
+			{
+				update(get_member_id((const void*)&member), update_op::Update, nullptr, (void*)&x);
+			}
+
+			// identify the member by an id from get_member_id, looked up once, e.g. in a static
+			template <typename T>
+			void member_modify(member_id member, T& x)
+			{
+				update(member, update_op::Update, nullptr, (void*)&x);
 			}
 
 			template <typename T>
 			void vector_push_back(const char *tag, T& x)
 			{
-				update_visitor<Serializer> visitor(m_message_serializer, tag, update_op::AppendVector, nullptr, (void*)&x, this);
-				m_message_serializer("node", m_node_id);
-				m_message_serializer("op", visitor.m_operation);
-				m_message_serializer("tag", visitor.m_tag);
-				reflect(visitor);
-				send();
+				update(get_member_id(tag), update_op::AppendVector, nullptr, (void*)&x);
 			}
 
 			template <typename T>
 			void vector_insert(const char* tag, size_t index, T& x)
 			{
-				update_visitor<Serializer> visitor(m_message_serializer, tag, update_op::InsertVector, (void*)&index, (void*)&x, this);
-				m_message_serializer("node", m_node_id);
-				m_message_serializer("op", visitor.m_operation);
-				m_message_serializer("tag", visitor.m_tag);
-				reflect(visitor);
-				send();
+				update(get_member_id(tag), update_op::InsertVector, (void*)&index, (void*)&x);
 			}
 
 			void vector_erase(const char* tag, size_t index)
 			{
-				update_visitor<Serializer> visitor(m_message_serializer, tag, update_op::EraseMap, (void*)&index, nullptr, this);
-				m_message_serializer("node", m_node_id);
-				m_message_serializer("op", visitor.m_operation);
-				m_message_serializer("tag", visitor.m_tag);
-				reflect(visitor);
-				send();
+				update(get_member_id(tag), update_op::EraseMap, (void*)&index, nullptr);
 			}
 
 			void vector_clear(const char* tag)
 			{
-				update_visitor<Serializer> visitor(m_message_serializer, tag, update_op::ClearMap, nullptr, nullptr, this);
-				m_message_serializer("node", m_node_id);
-				m_message_serializer("op", visitor.m_operation);
-				m_message_serializer("tag", visitor.m_tag);
-				reflect(visitor);
-				send();
+				update(get_member_id(tag), update_op::ClearMap, nullptr, nullptr);
 			}
 
 			template <typename K, typename V>
 			void map_insert(const char* tag, size_t index, K& key, V& value)
 			{
-				update_visitor<Serializer> visitor(m_message_serializer, tag, update_op::InsertMap, (void*)&key, (void*)&value, this);
-				m_message_serializer("node", m_node_id);
-				m_message_serializer("op", visitor.m_operation);
-				m_message_serializer("tag", visitor.m_tag);
-				reflect(visitor);
-				send();
+				update(get_member_id(tag), update_op::InsertMap, (void*)&key, (void*)&value);
 			}
 
 			template <typename K>
 			void map_erase(const char* tag, K& key)
 			{
-				update_visitor<Serializer> visitor(m_message_serializer, tag, update_op::EraseMap, (void*)key, nullptr, this);
-				m_message_serializer("node", m_node_id);
-				m_message_serializer("op", visitor.m_operation);
-				m_message_serializer("tag", visitor.m_tag);
-				reflect(visitor);
-				send();
+				update(get_member_id(tag), update_op::EraseMap, (void*)key, nullptr);
 			}
 
 			void map_clear(const char* tag)
 			{
-				update_visitor<Serializer> visitor(m_message_serializer, tag, update_op::ClearMap, nullptr, nullptr, this);
-				m_message_serializer("node", m_node_id);
-				m_message_serializer("op", visitor.m_operation);
-				m_message_serializer("tag", visitor.m_tag);
-				reflect(visitor);
-				send();
+				update(get_member_id(tag), update_op::ClearMap, nullptr, nullptr);
 			}
 			
 		private:
@@ -129,84 +118,240 @@ namespace bb
 			void unref(std::shared_ptr<polymorphic_node> node) override
 			{
 				if (auto x = std::dynamic_pointer_cast<self_type, polymorphic_node>(node))
-				{
-					// remove my reference from x
-					for (auto i = x->m_referenced_by.begin(); i != x->m_referenced_by.end(); ++i)
-					{
-						auto j = i->lock();
-						if (j.get() == this)
-						{
-							x->m_referenced_by.erase(i);
-							return;
-						}
-					}
+				{
+					// remove my reference from x once the update is done, the new value may refer to x again
+					m_unrefs.push_back(x);
 				}
 				else
 				{
-					if (node.get()) throw std::exception("unable to cast to server node");
+					if (node.get()) throw std::runtime_error("unable to cast to server node");
 				}
 			}
 
 			void ref(std::shared_ptr<polymorphic_node> node) override
 			{
 				if (auto x = std::dynamic_pointer_cast<self_type, polymorphic_node>(node))
-				{
-					// add my reference to x
-					for (auto &i : x->m_referenced_by)
+				{
+					// x replaced by itself, nothing changes
+					auto it = std::find(m_unrefs.begin(), m_unrefs.end(), x);
+					if (it != m_unrefs.end())
 					{
-						auto j = i.lock();
-						if (j.get() == this) return;
+						m_unrefs.erase(it);
+						return;
 					}
 
-					x->m_referenced_by.push_back(std::dynamic_pointer_cast<self_type, polymorphic_node>(shared_from_this()));
+					// add my reference to x
+					x->add_referrer(std::dynamic_pointer_cast<self_type, polymorphic_node>(shared_from_this()));
 				}
 				else
 				{
-					if (node.get()) throw std::exception("unable to cast to server node");
+					if (node.get()) throw std::runtime_error("unable to cast to server node");
 				}
 			}
 			
-			template <typename Fn>
-			void visit_subscribers(Fn visit)
+			void write_replace()
+			{
+				// resync only serializes what we already have, 
+				//  no reference resolving required because they are server side only.
+
+				update_op replace = update_op::Replace;
+				m_message_serializer("node", m_node_id);
+				m_message_serializer("op", replace);
+				auto self = shared_from_this();
+				m_message_serializer("val", self);
+			}
+
+			// full state for a single client, e.g. when the node enters its area of interest
+			void replace(client_type* clt)
+			{
+				write_replace();
+				m_server->deliver(clt, m_node_id, update_op::Replace, invalid_member, true);
+				m_message_buffer.clear();
+			}
+
+			// left the area of interest of a single client
+			void leave(client_type* clt)
+			{
+				update_op leave = update_op::Leave;
+				m_message_serializer("node", m_node_id);
+				m_message_serializer("op", leave);
+				m_server->deliver(clt, m_node_id, update_op::Leave, invalid_member, false);
+				m_message_buffer.clear();
+			}
+
+			bool subscribed(client_type* clt)
+			{
+				auto &list = subscribers();
+				return std::binary_search(list.begin(), list.end(), clt);
+			}
+
+			void update(member_id member, update_op op, void* key, void* value)
+			{
+				update_visitor<Serializer> visitor(m_message_serializer, member, op, key, value, this);
+				m_message_serializer("node", m_node_id);
+				m_message_serializer("op", visitor.m_operation);
+				m_message_serializer("member", visitor.m_member);
+				reflect(visitor);
+
+				for (auto &x : m_unrefs) x->remove_referrer(this);
+				m_unrefs.clear();
+
+				send(op, member, visitor.m_references);
+			}
+
+			/*
+			 * Subscribers are the owner plus the subscribers of every node that references this one.
+			 * The flattened list is cached until the owner or the referrers of this node, or of any node
+			 *  referencing it, change. Invalidation follows the references downwards and stops at nodes
+			 *  that are already invalid, their own references are invalid as well.
+			 */
+			void invalidate()
 			{
-				if (m_owner) visit(m_owner);
+				if (!m_subscribers_valid) return;
+				m_subscribers_valid = false;
 
-				m_referenced_by.erase(std::remove_if(m_referenced_by.begin(), m_referenced_by.end(), [&](std::weak_ptr<self_type>& ptr)
+				for (auto it = m_referencing.begin(); it != m_referencing.end();)
 				{
-					if (auto ref = ptr.lock())
+					if (auto target = it->second.lock())
+					{
+						target->invalidate();
+						++it;
+					}
+					else
 					{
-						ref->visit_subscribers(visit);
-						return false;
+						it = m_referencing.erase(it);
 					}
+				}
+			}
+
+			void add_referrer(const std::shared_ptr<self_type>& x)
+			{
+				if (!x) return;
 
-					return true;
-				}), m_referenced_by.end());
+				auto &slot = m_referenced_by[x.get()];
+				if (!slot.expired()) return;
+
+				slot = x;
+				x->m_referencing[this] = std::dynamic_pointer_cast<self_type, polymorphic_node>(shared_from_this());
+				invalidate();
+			}
+
+			void remove_referrer(self_type* x)
+			{
+				if (!m_referenced_by.erase(x)) return;
+
+				x->m_referencing.erase(this);
+				invalidate();
+			}
+
+			void set_owner(client_type* owner)
+			{
+				if (m_owner == owner) return;
+
+				m_owner = owner;
+				invalidate();
+			}
+
+			static bool& cycle_detected()
+			{
+				static bool detected = false;
+				return detected;
+			}
+
+			const std::vector<client_type*>& subscribers()
+			{
+				if (m_collecting)
+				{
+					// reference cycle, whoever asked gets a partial list and must not cache it
+					cycle_detected() = true;
+					return m_subscribers;
+				}
+
+				if (m_subscribers_valid) return m_subscribers;
+
+				bool outer_cycle = cycle_detected();
+				cycle_detected() = false;
+				m_collecting = true;
+
+				m_subscribers.clear();
+				if (m_owner) m_subscribers.push_back(m_owner);
+
+				for (auto it = m_referenced_by.begin(); it != m_referenced_by.end();)
+				{
+					if (auto ref = it->second.lock())
+					{
+						auto &inherited = ref->subscribers();
+						m_subscribers.insert(m_subscribers.end(), inherited.begin(), inherited.end());
+						++it;
+					}
+					else
+					{
+						it = m_referenced_by.erase(it);
+					}
+				}
+
+				// a client reachable along several paths gets each message once
+				std::sort(m_subscribers.begin(), m_subscribers.end());
+				m_subscribers.erase(std::unique(m_subscribers.begin(), m_subscribers.end()), m_subscribers.end());
+
+				m_collecting = false;
+				m_subscribers_valid = !cycle_detected();
+				cycle_detected() = outer_cycle || cycle_detected();
+
+				return m_subscribers;
+			}
+
+			template <typename Fn>
+			void visit_subscribers(Fn visit)
+			{
+				for (auto subscriber : subscribers())
+					visit(subscriber);
 			}
 			
-			void send()
+			void send(update_op op, member_id member, bool references)
 			{
-				// send buffer to all subscribers
-				m_message_buffer.flush();
-				OutputDebugString(m_message_buffer.str().c_str());
+				// outside every region, no client receives it
+				if (m_spatial && m_watchers == 0 && m_server->m_all_regions)
+				{
+					m_message_buffer.clear();
+					return;
+				}
 
+				// send buffer to all subscribers
 				visit_subscribers([&](client_type* subscriber)
 				{
-					subscriber->m_clt_out.write(m_message_buffer.str().c_str(), m_message_buffer.str().length());
-					subscriber->m_clt_out.flush();
+					if (m_spatial && !m_server->relevant(subscriber, m_node_id)) return;
+
+					m_server->deliver(subscriber, m_node_id, op, member, references);
 				});
 
 				// clear contents
-				std::ostringstream empty;
-				m_message_buffer.swap(empty);
+				m_message_buffer.clear();
 			}
 
-			std::ostringstream& m_message_buffer;
+			server_type*        m_server;
+
+			message_buffer&     m_message_buffer;
 
 			Serializer&         m_message_serializer;
 
 			client_type*        m_owner;
 
-			std::vector<std::weak_ptr<self_type>> m_referenced_by;
+			bool                m_spatial = false;
+
+			unsigned            m_watchers = 0;   // client regions that contain the node
+
+			vec2                m_position;
+
+			std::unordered_map<self_type*, std::weak_ptr<self_type>> m_referenced_by;
+			std::unordered_map<self_type*, std::weak_ptr<self_type>> m_referencing;
+
+			// old values replaced by the running update, dropped after it unless referenced again
+			std::vector<std::shared_ptr<self_type>> m_unrefs;
+
+			std::vector<client_type*> m_subscribers;
+			bool                      m_subscribers_valid = false;
+			bool                      m_collecting = false;
 		};
 	}
 }
\ No newline at end of file
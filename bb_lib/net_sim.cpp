@@ -0,0 +1,114 @@
+#include "net_sim.h"
+
+#include <algorithm>
+
+namespace bb
+{
+	namespace net
+	{
+		//------------------------------------------------------------------------
+		sim_endpoint::sim_endpoint(sim_network* network)
+			: m_network(network)
+			, m_out_buffer([this](const char* data, size_t size) { m_network->send(this, data, size); })
+			, m_in(&m_in_buffer)
+			, m_out(&m_out_buffer) { }
+
+		//------------------------------------------------------------------------
+		sim_network::sim_network(uint64_t seed)
+			: m_random(seed ? seed : 1) { }
+
+		sim_network::endpoint_pair sim_network::connect(const sim_link_config& a_to_b, const sim_link_config& b_to_a)
+		{
+			std::shared_ptr<sim_endpoint> a(new sim_endpoint(this));
+			std::shared_ptr<sim_endpoint> b(new sim_endpoint(this));
+
+			m_links.push_back(link());
+			m_links.back().config = a_to_b;
+			m_links.back().to = b.get();
+			a->m_outgoing = m_links.size() - 1;
+
+			m_links.push_back(link());
+			m_links.back().config = b_to_a;
+			m_links.back().to = a.get();
+			b->m_outgoing = m_links.size() - 1;
+
+			m_endpoints.push_back(a);
+			m_endpoints.push_back(b);
+
+			return endpoint_pair(a, b);
+		}
+
+		void sim_network::advance(double dt)
+		{
+			// everything written since the last advance leaves now
+			for (auto &endpoint : m_endpoints)
+				endpoint->m_out.flush();
+
+			double target = m_now + dt;
+
+			while (!m_packets.empty() && m_packets.top().arrival <= target)
+			{
+				packet p = m_packets.top();
+				m_packets.pop();
+				m_now = p.arrival;
+
+				link &l = m_links[p.via];
+				if (p.seq != l.next_deliver)
+				{
+					// overtook an earlier packet, wait for it like TCP would
+					l.early.emplace(p.seq, std::move(p.data));
+					l.to->m_stats.packets_held_back++;
+					continue;
+				}
+
+				deliver(l, p.data);
+
+				for (auto it = l.early.begin(); it != l.early.end() && it->first == l.next_deliver; it = l.early.erase(it))
+					deliver(l, it->second);
+			}
+
+			m_now = target;
+		}
+
+		void sim_network::send(sim_endpoint* from, const char* data, size_t size)
+		{
+			link &l = m_links[from->m_outgoing];
+			auto &config = l.config;
+
+			// bandwidth cap: packets queue behind each other on the link
+			double departure = (std::max)(m_now, l.free_at);
+			if (config.bandwidth > 0) departure += size / config.bandwidth;
+			l.free_at = departure;
+
+			double arrival = departure + config.latency + config.jitter * random();
+			while (config.loss > 0 && random() < config.loss)
+			{
+				arrival += config.retransmit;
+				from->m_stats.packets_lost++;
+			}
+
+			m_packets.push({ arrival, m_order++, from->m_outgoing, l.next_send++, std::string(data, size) });
+
+			from->m_stats.bytes_sent += size;
+			from->m_stats.packets_sent++;
+		}
+
+		void sim_network::deliver(link& l, const std::string& data)
+		{
+			l.to->m_in_buffer.append(data.data(), data.size());
+			l.to->m_in.clear();
+			l.to->m_stats.bytes_received += data.size();
+			l.to->m_stats.packets_received++;
+			l.next_deliver++;
+		}
+
+		double sim_network::random()
+		{
+			// xorshift64*, same sequence on every platform
+			m_random ^= m_random >> 12;
+			m_random ^= m_random << 25;
+			m_random ^= m_random >> 27;
+			return (double)((m_random * 2685821657736338717ull) >> 11) / (double)(1ull << 53);
+		}
+	}
+}
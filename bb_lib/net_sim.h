@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "net_packet_stream.h"
+
+namespace bb
+{
+	namespace net
+	{
+		class sim_network;
+
+		// One direction of a simulated connection
+		struct sim_link_config
+		{
+			double latency = 0.05;    // seconds
+			double jitter = 0.0;      // uniform extra delay in [0, jitter] seconds, packets can arrive out of order
+			double loss = 0.0;        // chance a packet is lost, it arrives one retransmit delay later
+			double retransmit = 0.2;  // seconds
+			double bandwidth = 0.0;   // bytes per second, 0 is unlimited
+		};
+
+		/*
+		 * End of a simulated connection, in() and out() plug into server::add_client or a client.
+		 * Like TCP the link is reliable and ordered: loss shows up as delay and packets that arrive
+		 *  early are held back until the ones before them are in.
+		 */
+		class sim_endpoint
+		{
+		public:
+			struct stats
+			{
+				size_t bytes_sent = 0;
+				size_t packets_sent = 0;
+				size_t packets_lost = 0;
+				size_t bytes_received = 0;
+				size_t packets_received = 0;
+				size_t packets_held_back = 0;
+			};
+
+			std::istream& in()  { return m_in; }
+			std::ostream& out() { return m_out; }
+
+			const stats& get_stats() const { return m_stats; }
+
+		private:
+			friend class sim_network;
+
+			sim_endpoint(sim_network* network);
+
+			sim_network*         m_network;
+			size_t               m_outgoing = 0;   // index of the link to the other end
+			stats                m_stats;
+
+			packet_input_buffer  m_in_buffer;
+			packet_output_buffer m_out_buffer;
+			std::istream         m_in;
+			std::ostream         m_out;
+		};
+
+		/*
+		 * In-process network driven by a virtual clock.
+		 * Packets written between two advance() calls leave at the current virtual time,
+		 *  advance() moves the clock and delivers everything that arrives before the new time.
+		 * Runs are deterministic for a given seed.
+		 */
+		class sim_network
+		{
+		public:
+			sim_network(uint64_t seed = 1);
+
+			using endpoint_pair = std::pair<std::shared_ptr<sim_endpoint>, std::shared_ptr<sim_endpoint>>;
+
+			// connection between two new endpoints, first -> second uses a_to_b
+			endpoint_pair connect(const sim_link_config& a_to_b, const sim_link_config& b_to_a);
+
+			void advance(double dt);
+
+			double now() const       { return m_now; }
+			size_t in_flight() const { return m_packets.size(); }
+
+		private:
+			friend class sim_endpoint;
+
+			struct link
+			{
+				sim_link_config                 config;
+				sim_endpoint*                   to;
+				double                          free_at = 0;
+				uint64_t                        next_send = 0;
+				uint64_t                        next_deliver = 0;
+				std::map<uint64_t, std::string> early;
+			};
+
+			struct packet
+			{
+				double      arrival;
+				uint64_t    order;
+				size_t      via;
+				uint64_t    seq;
+				std::string data;
+
+				bool operator>(const packet& b) const { return arrival != b.arrival ? arrival > b.arrival : order > b.order; }
+			};
+
+			void   send(sim_endpoint* from, const char* data, size_t size);
+			void   deliver(link& l, const std::string& data);
+			double random();
+
+			double   m_now = 0;
+			uint64_t m_order = 0;
+			uint64_t m_random;
+
+			std::vector<std::shared_ptr<sim_endpoint>>                                 m_endpoints;
+			std::deque<link>                                                           m_links;
+			std::priority_queue<packet, std::vector<packet>, std::greater<packet>>     m_packets;
+		};
+
+		//------------------------------------------------------------------------------------------------------------
+		// Benchmark driver: N simulated clients against a scripted server scenario.
+		struct sim_benchmark_config
+		{
+			unsigned        clients = 16;
+			unsigned        entities = 256;
+			unsigned        tick_rate = 60;
+			unsigned        active_ticks = 600;   // ticks during which the scenario changes the world
+			unsigned        max_ticks = 1200;     // gives up on convergence after this
+			float           moving = 1;           // share of the entities that move, the others rewrite the same position
+			bool            batching = true;
+			bool            snapshots = false;
+			float           world_size = 0;          // > 0 spreads the entities over a square this size instead of around the origin
+			float           interest_radius = 0;     // > 0 enables interest management, every client sees this far around its spot
+			unsigned        interest_interval = 1;   // max_interval for server::enable_interest
+			sim_link_config link;
+			uint64_t        seed = 1;
+		};
+
+		struct sim_benchmark_report
+		{
+			double initial_bytes_per_client = 0;    // the world in full, before the scenario starts
+			double bytes_per_client_per_second = 0; // while the scenario runs
+			double server_ms_per_tick = 0;         // wall clock, scenario step and flush
+			double server_ms_per_tick_max = 0;
+			double convergence_time = -1;          // virtual seconds from the last change until all clients match, -1 if never
+			size_t packets_lost = 0;
+			double entity_density = 0;             // entities per square unit, 0 without world_size
+			double visible_per_client = 0;         // entities within a client's region at the end, 0 without interest
+
+			void print(std::ostream& out) const;
+		};
+
+		sim_benchmark_report run_sim_benchmark(const sim_benchmark_config& config);
+	}
+}
@@ -0,0 +1,283 @@
+#include "net.hpp"
+#include "net_sim.h"
+
+#include <chrono>
+#include <cmath>
+
+namespace bb
+{
+	namespace net
+	{
+		namespace
+		{
+			using SimClient = client<BinaryDeserializer, BinarySerializer>;
+			using SimServer = server<BinaryDeserializer, BinarySerializer>;
+
+			class SimEntity : public node_utils<SimServer, SimClient>
+			{
+			public:
+				virtual ~SimEntity() { }
+
+				float m_X = 0;
+				float m_Y = 0;
+				int   m_Health = 100;
+
+				template <typename VISITOR>
+				void reflect(VISITOR& visit)
+				{
+					visit("x", m_X);
+					visit("y", m_Y);
+					visit("health", m_Health);
+				}
+
+				static type_id node_type() { return "SimEntity"; }
+			};
+
+			class SimWorld : public node_utils<SimServer, SimClient>
+			{
+			public:
+				virtual ~SimWorld() { }
+
+				std::vector<std::shared_ptr<SimEntity>> m_Entities;
+
+				template <typename VISITOR>
+				void reflect(VISITOR& visit)
+				{
+					visit("entities", m_Entities);
+				}
+
+				static type_id node_type() { return "SimWorld"; }
+			};
+
+			class SvrSimEntity : public SimEntity
+			{
+			public:
+				template <typename VISITOR>
+				void reflect_rpc(VISITOR&) { }
+			};
+
+			class SvrSimWorld : public SimWorld
+			{
+			public:
+				template <typename VISITOR>
+				void reflect_rpc(VISITOR&) { }
+			};
+
+			struct sim_client
+			{
+				std::shared_ptr<sim_endpoint>                  server_end;
+				std::shared_ptr<sim_endpoint>                  client_end;
+				std::unique_ptr<SimClient>                     client;
+				std::shared_ptr<SimServer::server_client_type> connection;
+				vec2                                           centre;
+				float                                          radius = 0;
+			};
+
+			// evenly spread points in [0, size)^2, the R2 sequence
+			vec2 spread(unsigned i, float size)
+			{
+				double u = i * 0.7548776662466927;
+				double v = i * 0.5698402909980532;
+				return vec2((float)(u - floor(u)) * size, (float)(v - floor(v)) * size);
+			}
+
+			// entities wander on circles around their home, every 30 ticks a tenth of them takes damage.
+			// the ones that don't move still write their position every tick, like a physics step would
+			void step(std::vector<SimServer::node_type<SvrSimEntity>>& entities, const std::vector<vec2>& homes, float radius, float moving, bool spatial, unsigned tick)
+			{
+				for (size_t i = 0; i < entities.size(); ++i)
+				{
+					auto &e = entities[i];
+					bool moves = (float)(i % 100) < moving * 100;
+					float phase = (float)i + (moves ? tick : 0) * 0.01f * (float)(i % 7 + 1);
+					float x = homes[i].x + radius * cosf(phase);
+					float y = homes[i].y + radius * sinf(phase);
+					if (spatial) e->set_position(vec2(x, y));
+					e->member_modify("x", x);
+					e->member_modify("y", y);
+
+					if (tick % 30 == 0 && i % 10 == tick / 30 % 10)
+					{
+						int health = (e->m_Health + 90) % 100;
+						e->member_modify("health", health);
+					}
+				}
+			}
+
+			// with a region, only the entities inside it have to match
+			bool visible(const sim_client& c, const SimEntity& e)
+			{
+				if (c.radius <= 0) return true;
+
+				return (vec2(e.m_X, e.m_Y) - c.centre).mag2() <= c.radius * c.radius;
+			}
+
+			bool converged(std::vector<sim_client>& clients, std::vector<SimServer::node_type<SvrSimEntity>>& entities)
+			{
+				for (auto &c : clients)
+				{
+					auto world = c.client->cast<SimWorld>(c.client->get_root());
+					if (!world || world->m_Entities.size() != entities.size()) return false;
+
+					for (size_t i = 0; i < entities.size(); ++i)
+					{
+						auto &a = world->m_Entities[i];
+						auto &b = entities[i];
+						if (!a) return false;
+						if (!visible(c, *b)) continue;
+						if (a->m_X != b->m_X || a->m_Y != b->m_Y || a->m_Health != b->m_Health) return false;
+					}
+				}
+
+				return true;
+			}
+		}
+
+		void sim_benchmark_report::print(std::ostream& out) const
+		{
+			out << "initial per client:   " << initial_bytes_per_client << " B\n";
+			out << "bandwidth per client: " << bytes_per_client_per_second << " B/s after that\n";
+			out << "server time per tick: " << server_ms_per_tick << " ms (max " << server_ms_per_tick_max << " ms)\n";
+			out << "packets lost:         " << packets_lost << "\n";
+			if (entity_density > 0)     out << "entity density:       " << entity_density << " per square unit\n";
+			if (visible_per_client > 0) out << "visible per client:   " << visible_per_client << " entities\n";
+			if (convergence_time < 0) out << "convergence:          not reached\n";
+			else                      out << "convergence:          " << convergence_time << " s\n";
+		}
+
+		sim_benchmark_report run_sim_benchmark(const sim_benchmark_config& config)
+		{
+			sim_benchmark_report report;
+			sim_network network(config.seed);
+
+			SimServer server;
+			server.set_batching(config.batching);
+			server.set_snapshots(config.snapshots);
+
+			// entities wander a twentieth of the world around their home, at most 50 units so a larger world at the
+			//  same density looks the same from every spot, or on one circle around the origin.
+			// interest cells are about as large as a region
+			bool  spatial = config.world_size > 0;
+			float wander = spatial ? (std::min)(config.world_size / 20, 50.0f) : 100.0f;
+			bool  interest = spatial && config.interest_radius > 0;
+			if (interest)
+			{
+				vec2 margin(wander, wander);
+				unsigned resolution = (std::max)(1u, (unsigned)((config.world_size + 2 * wander) / config.interest_radius));
+				server.enable_interest(vec2(0, 0) - margin, vec2(config.world_size, config.world_size) + margin, resolution, config.interest_interval);
+			}
+
+			std::vector<sim_client> clients(config.clients);
+			for (auto &c : clients)
+			{
+				auto ends = network.connect(config.link, config.link);
+				c.server_end = ends.first;
+				c.client_end = ends.second;
+
+				c.client.reset(new SimClient(c.client_end->in(), c.client_end->out()));
+				c.client->register_node_type<SimWorld>();
+				c.client->register_node_type<SimEntity>();
+
+				c.connection = server.add_client<SvrSimWorld>(c.server_end->in(), c.server_end->out());
+
+				if (interest)
+				{
+					// clients take the spots between the entity homes
+					c.centre = spread(config.entities + (unsigned)(&c - clients.data()), config.world_size);
+					c.radius = config.interest_radius;
+					server.set_interest_region(c.connection.get(), c.centre, c.radius);
+				}
+			}
+
+			std::vector<SimServer::node_type<SvrSimEntity>> entities;
+			std::vector<std::shared_ptr<SimEntity>>         list;
+			std::vector<vec2>                               homes;
+			for (unsigned i = 0; i < config.entities; ++i)
+			{
+				entities.push_back(server.make_node<SvrSimEntity>(nullptr));
+				list.push_back(entities.back());
+				homes.push_back(spatial ? spread(i, config.world_size) : vec2(0, 0));
+			}
+
+			for (auto &c : clients)
+				c.connection->get_root<SvrSimWorld>()->member_modify("entities", list);
+
+			double dt = 1.0 / config.tick_rate;
+
+			// the world reaches every client and is acknowledged before the scenario starts, snapshot mode
+			//  sends it again every tick until then. those bytes are reported on their own
+			unsigned warmup = 2 + (unsigned)ceil(2 * (config.link.latency + config.link.jitter) / dt);
+			for (unsigned i = 0; i < warmup; ++i)
+			{
+				for (auto &c : clients)
+					server.update_client(c.connection.get());
+				server.flush();
+				network.advance(dt);
+				for (auto &c : clients)
+					c.client->update();
+			}
+
+			size_t initial = 0;
+			for (auto &c : clients) initial += c.server_end->get_stats().bytes_sent;
+			if (config.clients) report.initial_bytes_per_client = (double)initial / config.clients;
+
+			double last_change = network.now();
+			double total_ms = 0;
+			unsigned tick = 0;
+
+			for (; tick < config.max_ticks; ++tick)
+			{
+				auto start = std::chrono::steady_clock::now();
+
+				if (tick < config.active_ticks)
+				{
+					step(entities, homes, wander, config.moving, interest, tick);
+					last_change = network.now();
+				}
+
+				for (auto &c : clients)
+					server.update_client(c.connection.get());
+				server.flush();
+
+				double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				total_ms += ms;
+				report.server_ms_per_tick_max = (std::max)(report.server_ms_per_tick_max, ms);
+
+				network.advance(dt);
+
+				for (auto &c : clients)
+					c.client->update();
+
+				if (tick + 1 >= config.active_ticks && converged(clients, entities))
+				{
+					report.convergence_time = network.now() - last_change;
+					tick++;
+					break;
+				}
+			}
+
+			size_t bytes = 0;
+			for (auto &c : clients)
+			{
+				bytes += c.server_end->get_stats().bytes_sent;
+				report.packets_lost += c.server_end->get_stats().packets_lost + c.client_end->get_stats().packets_lost;
+			}
+
+			double seconds = tick * dt;
+			if (seconds > 0 && config.clients) report.bytes_per_client_per_second = (bytes - initial) / seconds / config.clients;
+			if (tick) report.server_ms_per_tick = total_ms / tick;
+
+			if (spatial) report.entity_density = config.entities / ((double)config.world_size * config.world_size);
+			if (interest && config.clients)
+			{
+				size_t count = 0;
+				for (auto &c : clients)
+					for (auto &e : entities)
+						if (visible(c, *e)) count++;
+				report.visible_per_client = (double)count / config.clients;
+			}
+
+			return report;
+		}
+	}
+}
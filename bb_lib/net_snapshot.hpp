@@ -0,0 +1,49 @@
+#pragma once
+
+namespace bb
+{
+	namespace net
+	{
+		/*
+		 * Client side history of a replicated value in snapshot mode.
+		 * Push the value from client::on_snapshot with the receive time, then sample it
+		 *  slightly in the past (render time = now - interpolation delay) to interpolate between snapshots.
+		 */
+		template <typename T>
+		class snapshot_history
+		{
+		public:
+			snapshot_history(size_t capacity = 32)
+				: m_capacity(capacity) { }
+
+			// times must be increasing
+			void push(double time, const T& x)
+			{
+				if (m_entries.size() == m_capacity) m_entries.pop_front();
+				m_entries.emplace_back(time, x);
+			}
+
+			// interpolate between the snapshots around time, clamps to the oldest and newest one
+			bool sample(double time, T& x) const
+			{
+				if (m_entries.empty()) return false;
+
+				if (time <= m_entries.front().first) { x = m_entries.front().second; return true; }
+				if (time >= m_entries.back().first)  { x = m_entries.back().second;  return true; }
+
+				auto b = std::upper_bound(m_entries.begin(), m_entries.end(), time, [](double t, const std::pair<double, T>& e) { return t < e.first; });
+				auto a = b - 1;
+
+				float t = (float)((time - a->first) / (b->first - a->first));
+				x = a->second + (b->second - a->second) * t;
+				return true;
+			}
+
+			void clear() { m_entries.clear(); }
+
+		private:
+			size_t                          m_capacity;
+			std::deque<std::pair<double, T>> m_entries;
+		};
+	}
+}
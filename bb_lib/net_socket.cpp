@@ -0,0 +1,470 @@
+#include "net_socket.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+#endif
+
+namespace bb
+{
+	namespace net
+	{
+		namespace
+		{
+			const size_t   frame_header_size = 4;
+			const size_t   max_events = 256;
+
+#ifdef _WIN32
+			const int      send_flags = 0;
+
+			bool would_block() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+			void close_socket(intptr_t s) { closesocket((SOCKET)s); }
+
+			void set_non_blocking(intptr_t s)
+			{
+				u_long mode = 1;
+				ioctlsocket((SOCKET)s, FIONBIO, &mode);
+			}
+#else
+#ifdef MSG_NOSIGNAL
+			const int      send_flags = MSG_NOSIGNAL;
+#else
+			const int      send_flags = 0;
+#endif
+
+			bool would_block() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+			void close_socket(intptr_t s) { ::close((int)s); }
+
+			void set_non_blocking(intptr_t s)
+			{
+				fcntl((int)s, F_SETFL, fcntl((int)s, F_GETFL, 0) | O_NONBLOCK);
+			}
+#endif
+
+			intptr_t to_handle(decltype(::socket(0, 0, 0)) s)
+			{
+#ifdef _WIN32
+				return s == INVALID_SOCKET ? -1 : (intptr_t)s;
+#else
+				return (intptr_t)s;
+#endif
+			}
+
+			void write_length(char* out, uint32_t x)
+			{
+				out[0] = (char)(x);
+				out[1] = (char)(x >> 8);
+				out[2] = (char)(x >> 16);
+				out[3] = (char)(x >> 24);
+			}
+
+			uint32_t read_length(const char* in)
+			{
+				const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+				return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+			}
+		}
+
+		//------------------------------------------------------------------------
+		socket_connection::socket_connection(socket_transport* transport, intptr_t socket)
+			: m_transport(transport)
+			, m_socket(socket)
+			, m_out_buffer([this](const char* data, size_t size) { if (connected()) m_transport->queue(this, data, size); })
+			, m_in(&m_in_buffer)
+			, m_out(&m_out_buffer) { }
+
+		void socket_connection::close()
+		{
+			if (connected()) m_transport->close(this);
+		}
+
+		//------------------------------------------------------------------------
+		socket_transport::socket_transport()
+		{
+#ifdef _WIN32
+			WSADATA data;
+			if (WSAStartup(MAKEWORD(2, 2), &data) != 0) throw std::runtime_error("WSAStartup failed");
+#endif
+#ifdef __linux__
+			m_poller = epoll_create1(0);
+			if (m_poller == -1) throw std::runtime_error("epoll_create1 failed");
+#endif
+			m_scratch.resize(64 * 1024);
+		}
+
+		socket_transport::~socket_transport()
+		{
+			on_disconnect = nullptr;
+
+			while (!m_connections.empty())
+				close(m_connections.begin()->first);
+
+			if (m_listener != -1) close_socket(m_listener);
+#ifdef __linux__
+			::close((int)m_poller);
+#endif
+#ifdef _WIN32
+			WSACleanup();
+#endif
+		}
+
+		void socket_transport::listen(uint16_t port, int backlog)
+		{
+			if (m_listener != -1) throw std::runtime_error("transport is already listening");
+
+			intptr_t s = to_handle(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+			if (s == -1) throw std::runtime_error("could not create socket");
+
+			int reuse = 1;
+			setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+			sockaddr_in addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(INADDR_ANY);
+			addr.sin_port = htons(port);
+
+			if (bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(s, backlog) != 0)
+			{
+				close_socket(s);
+				throw std::runtime_error("could not listen on port");
+			}
+
+			set_non_blocking(s);
+			m_listener = s;
+
+#ifdef __linux__
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.ptr = nullptr;
+			epoll_ctl((int)m_poller, EPOLL_CTL_ADD, (int)s, &ev);
+#endif
+		}
+
+		std::shared_ptr<socket_connection> socket_transport::connect(const std::string& host, uint16_t port)
+		{
+			addrinfo hints;
+			memset(&hints, 0, sizeof(hints));
+			hints.ai_family = AF_INET;
+			hints.ai_socktype = SOCK_STREAM;
+
+			addrinfo* result = nullptr;
+			if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+				throw std::runtime_error("could not resolve host");
+
+			intptr_t s = -1;
+			for (addrinfo* ai = result; ai && s == -1; ai = ai->ai_next)
+			{
+				s = to_handle(::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol));
+				if (s != -1 && ::connect(s, ai->ai_addr, (int)ai->ai_addrlen) != 0)
+				{
+					close_socket(s);
+					s = -1;
+				}
+			}
+			freeaddrinfo(result);
+
+			if (s == -1) throw std::runtime_error("could not connect");
+
+			return add(s);
+		}
+
+		void socket_transport::fail(socket_connection* conn)
+		{
+			if (conn->m_failed) return;
+
+			conn->m_failed = true;
+			m_failed.push_back(conn);
+		}
+
+		void socket_transport::close_failed()
+		{
+			// close() runs on_disconnect, which may fail other connections
+			while (!m_failed.empty())
+			{
+				socket_connection* conn = m_failed.back();
+				m_failed.pop_back();
+				close(conn);
+			}
+		}
+
+		std::shared_ptr<socket_connection> socket_transport::add(intptr_t socket)
+		{
+			set_non_blocking(socket);
+
+			int nodelay = 1;
+			setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+
+			std::shared_ptr<socket_connection> conn(new socket_connection(this, socket));
+			m_connections[conn.get()] = conn;
+
+#ifdef __linux__
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.ptr = conn.get();
+			epoll_ctl((int)m_poller, EPOLL_CTL_ADD, (int)socket, &ev);
+#endif
+			return conn;
+		}
+
+		void socket_transport::close(socket_connection* conn)
+		{
+			if (!conn->connected()) return;
+
+#ifdef __linux__
+			epoll_ctl((int)m_poller, EPOLL_CTL_DEL, (int)conn->m_socket, nullptr);
+#endif
+			close_socket(conn->m_socket);
+			conn->m_socket = -1;
+			conn->m_send.clear();
+			conn->m_send_offset = 0;
+
+			// keep the connection alive until the current poll() is done with it
+			auto it = m_connections.find(conn);
+			if (it == m_connections.end()) return;
+
+			m_closed.push_back(it->second);
+			m_connections.erase(it);
+
+			if (on_disconnect) on_disconnect(m_closed.back());
+		}
+
+		void socket_transport::accept()
+		{
+			for (;;)
+			{
+				intptr_t s = to_handle(::accept(m_listener, nullptr, nullptr));
+				if (s == -1) break;
+
+				auto conn = add(s);
+				if (on_accept) on_accept(conn);
+			}
+		}
+
+		void socket_transport::receive(socket_connection* conn)
+		{
+			bool closed = false;
+
+			for (;;)
+			{
+				auto n = recv(conn->m_socket, m_scratch.data(), (int)m_scratch.size(), 0);
+				if (n > 0)
+				{
+					conn->m_recv.insert(conn->m_recv.end(), m_scratch.data(), m_scratch.data() + n);
+					m_stats.bytes_received += n;
+
+					if ((size_t)n < m_scratch.size()) break;
+				}
+				else
+				{
+					closed = n == 0 || !would_block();
+					break;
+				}
+			}
+
+			// reassemble frames, a partial frame stays in m_recv until the rest arrives
+			size_t offset = conn->m_recv_offset;
+			bool   received = false;
+
+			while (conn->m_recv.size() - offset >= frame_header_size)
+			{
+				uint32_t size = read_length(&conn->m_recv[offset]);
+				if (size > m_max_frame_size)
+				{
+					close(conn);
+					return;
+				}
+
+				if (conn->m_recv.size() - offset - frame_header_size < size) break;
+
+				conn->m_in_buffer.append(&conn->m_recv[offset + frame_header_size], size);
+				offset += frame_header_size + size;
+				received = true;
+				m_stats.frames_received++;
+			}
+
+			if (offset == conn->m_recv.size())
+			{
+				conn->m_recv.clear();
+				offset = 0;
+			}
+			else if (offset > conn->m_recv.size() / 2)
+			{
+				conn->m_recv.erase(conn->m_recv.begin(), conn->m_recv.begin() + offset);
+				offset = 0;
+			}
+			conn->m_recv_offset = offset;
+
+			// a deserializer that ran dry left eof set, there is more to read now
+			if (received) conn->m_in.clear();
+
+			if (closed) close(conn);
+		}
+
+		void socket_transport::send(socket_connection* conn)
+		{
+			while (conn->queued())
+			{
+				auto n = ::send(conn->m_socket, conn->m_send.data() + conn->m_send_offset, (int)conn->queued(), send_flags);
+				if (n > 0)
+				{
+					conn->m_send_offset += n;
+					m_stats.bytes_sent += n;
+				}
+				else
+				{
+					// send() also runs inside the caller's out().flush(), the event loop closes the connection
+					if (!would_block()) fail(conn);
+					break;
+				}
+			}
+
+			if (conn->m_failed) return;
+
+			if (conn->queued() == 0)
+			{
+				conn->m_send.clear();
+				conn->m_send_offset = 0;
+			}
+			else if (conn->m_send_offset > conn->m_send.size() / 2)
+			{
+				conn->m_send.erase(conn->m_send.begin(), conn->m_send.begin() + conn->m_send_offset);
+				conn->m_send_offset = 0;
+			}
+
+			watch_writable(conn, conn->queued() != 0);
+		}
+
+		void socket_transport::queue(socket_connection* conn, const char* data, size_t size)
+		{
+			if (size > m_max_frame_size) throw std::runtime_error("frame too large");
+			if (conn->m_failed) return;
+
+			size_t offset = conn->m_send.size();
+			conn->m_send.resize(offset + frame_header_size + size);
+			write_length(&conn->m_send[offset], (uint32_t)size);
+			memcpy(&conn->m_send[offset + frame_header_size], data, size);
+			m_stats.frames_sent++;
+
+			// write through when nothing is waiting, otherwise the event loop drains the queue
+			if (!conn->m_writable_interest) send(conn);
+		}
+
+		void socket_transport::watch_writable(socket_connection* conn, bool writable)
+		{
+			if (conn->m_writable_interest == writable) return;
+			conn->m_writable_interest = writable;
+
+#ifdef __linux__
+			epoll_event ev;
+			ev.events = (uint32_t)EPOLLIN | (writable ? (uint32_t)EPOLLOUT : 0u);
+			ev.data.ptr = conn;
+			epoll_ctl((int)m_poller, EPOLL_CTL_MOD, (int)conn->m_socket, &ev);
+#endif
+		}
+
+		void socket_transport::poll(int timeout_ms)
+		{
+			// messages written without an explicit flush (client rpcs) go out as one frame
+			std::vector<socket_connection*> pending;
+			pending.reserve(m_connections.size());
+			for (auto &it : m_connections)
+				pending.push_back(it.first);
+
+			for (auto conn : pending)
+				if (conn->connected()) conn->m_out.flush();
+
+			close_failed();
+
+#ifdef __linux__
+			epoll_event events[max_events];
+			int count = epoll_wait((int)m_poller, events, (int)max_events, timeout_ms);
+
+			for (int i = 0; i < count; ++i)
+			{
+				socket_connection* conn = static_cast<socket_connection*>(events[i].data.ptr);
+				if (conn == nullptr)
+				{
+					accept();
+					continue;
+				}
+
+				if (!conn->connected()) continue;
+
+				if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+					receive(conn);
+
+				if (conn->connected() && (events[i].events & EPOLLOUT))
+					send(conn);
+			}
+#else
+			std::vector<pollfd>             fds;
+			std::vector<socket_connection*> conns;
+			fds.reserve(m_connections.size() + 1);
+			conns.reserve(m_connections.size() + 1);
+
+			if (m_listener != -1)
+			{
+				fds.push_back({ (decltype(pollfd::fd))m_listener, POLLIN, 0 });
+				conns.push_back(nullptr);
+			}
+
+			for (auto &it : m_connections)
+			{
+				fds.push_back({ (decltype(pollfd::fd))it.first->m_socket, (short)(POLLIN | (it.first->queued() ? POLLOUT : 0)), 0 });
+				conns.push_back(it.first);
+			}
+
+#ifdef _WIN32
+			// WSAPoll returns at once without sockets, wait like the other pollers do
+			int count = 0;
+			if (!fds.empty()) count = WSAPoll(fds.data(), (ULONG)fds.size(), timeout_ms);
+			else if (timeout_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+#else
+			int count = ::poll(fds.data(), (nfds_t)fds.size(), timeout_ms);
+#endif
+			for (size_t i = 0; count > 0 && i < fds.size(); ++i)
+			{
+				if (fds[i].revents == 0) continue;
+				count--;
+
+				socket_connection* conn = conns[i];
+				if (conn == nullptr)
+				{
+					accept();
+					continue;
+				}
+
+				if (!conn->connected()) continue;
+
+				if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+					receive(conn);
+
+				if (conn->connected() && (fds[i].revents & POLLOUT))
+					send(conn);
+			}
+#endif
+			close_failed();
+			m_closed.clear();
+		}
+	}
+}
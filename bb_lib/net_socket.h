@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "net_packet_stream.h"
+
+namespace bb
+{
+	namespace net
+	{
+		class socket_transport;
+
+		/*
+		 * A non-blocking TCP connection owned by a socket_transport.
+		 * Everything written to out() between two flushes is sent as one length-prefixed frame,
+		 *  the payload of received frames is appended to in().
+		 * The streams plug straight into server::add_client(conn->in(), conn->out()) or a client.
+		 */
+		class socket_connection
+		{
+		public:
+			std::istream& in()  { return m_in; }
+			std::ostream& out() { return m_out; }
+
+			bool   connected() const { return m_socket != -1; }
+			size_t queued() const    { return m_send.size() - m_send_offset; }
+
+			// drops queued data, in() keeps whatever was received before
+			void close();
+
+		private:
+			friend class socket_transport;
+
+			socket_connection(socket_transport* transport, intptr_t socket);
+
+			socket_transport* m_transport;
+			intptr_t          m_socket;
+			bool              m_writable_interest = false;
+			bool              m_failed = false;     // closed by the next poll()
+
+			packet_input_buffer  m_in_buffer;
+			packet_output_buffer m_out_buffer;
+			std::istream      m_in;
+			std::ostream      m_out;
+
+			std::vector<char> m_recv;
+			size_t            m_recv_offset = 0;
+			std::vector<char> m_send;
+			size_t            m_send_offset = 0;
+		};
+
+		/*
+		 * Single threaded event loop for non-blocking TCP connections (epoll on Linux, WSAPoll on Windows).
+		 * Call poll() from the network thread, it accepts connections, reassembles incoming frames
+		 *  and drains the per-connection send queues.
+		 */
+		class socket_transport
+		{
+		public:
+			struct stats
+			{
+				size_t frames_sent = 0;
+				size_t frames_received = 0;
+				size_t bytes_sent = 0;
+				size_t bytes_received = 0;
+			};
+
+			using connection_callback = std::function<void(const std::shared_ptr<socket_connection>&)>;
+
+			socket_transport();
+			~socket_transport();
+
+			void listen(uint16_t port, int backlog = 128);
+
+			std::shared_ptr<socket_connection> connect(const std::string& host, uint16_t port);
+
+			// wait at most timeout_ms for activity, then handle everything that is ready
+			void poll(int timeout_ms);
+
+			// frames bigger than this are treated as a protocol error and drop the connection
+			void set_max_frame_size(uint32_t size) { m_max_frame_size = size; }
+
+			connection_callback on_accept;
+			connection_callback on_disconnect;
+
+			const stats& get_stats() const { return m_stats; }
+			size_t       connection_count() const { return m_connections.size(); }
+
+		private:
+			friend class socket_connection;
+
+			std::shared_ptr<socket_connection> add(intptr_t socket);
+			void close(socket_connection* conn);
+			void fail(socket_connection* conn);
+			void close_failed();
+			void accept();
+			void receive(socket_connection* conn);
+			void send(socket_connection* conn);
+			void queue(socket_connection* conn, const char* data, size_t size);
+			void watch_writable(socket_connection* conn, bool writable);
+
+			intptr_t m_poller = -1;
+			intptr_t m_listener = -1;
+			uint32_t m_max_frame_size = 16 * 1024 * 1024;
+			stats    m_stats;
+
+			std::unordered_map<socket_connection*, std::shared_ptr<socket_connection>> m_connections;
+			std::vector<std::shared_ptr<socket_connection>>                              m_closed;
+			std::vector<socket_connection*>                                              m_failed;
+			std::vector<char>                                                            m_scratch;
+		};
+
+		//------------------------------------------------------------------------
+		// Loopback stress test: connections echo fixed size messages through a server on port, with window
+		//  messages in flight each. Both ends run on the calling thread, as one event loop each.
+		struct socket_benchmark_report
+		{
+			unsigned connections = 0;
+			size_t   messages = 0;             // in total
+			size_t   message_size = 0;
+
+			double   messages_per_second = 0;
+			double   latency_p50_us = 0;       // round trip
+			double   latency_p90_us = 0;
+			double   latency_p99_us = 0;
+			double   latency_max_us = 0;
+
+			void print(std::ostream& out) const;
+		};
+
+		socket_benchmark_report run_socket_benchmark(uint16_t port = 47100, unsigned connections = 100, size_t messages = 2000, size_t message_size = 64, unsigned window = 16);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "net_socket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace bb
+{
+	namespace net
+	{
+		namespace
+		{
+			typedef std::chrono::steady_clock clock;
+
+			struct echo_client
+			{
+				std::shared_ptr<socket_connection> conn;
+				size_t sent = 0;
+				size_t received = 0;
+			};
+
+			// a message is its send time and sequence number, padded to the message size
+			void write_message(std::ostream& out, std::vector<char>& message, uint64_t seq)
+			{
+				int64_t now = clock::now().time_since_epoch().count();
+				memcpy(message.data(), &now, sizeof(now));
+				memcpy(message.data() + sizeof(now), &seq, sizeof(seq));
+				out.write(message.data(), message.size());
+				out.flush();
+			}
+
+			bool read_message(std::istream& in, std::vector<char>& message)
+			{
+				if (in.rdbuf()->in_avail() < (std::streamsize)message.size()) return false;
+
+				in.read(message.data(), message.size());
+				return true;
+			}
+
+			double percentile(std::vector<double>& values, double p)
+			{
+				size_t i = std::min(values.size() - 1, (size_t)(p * values.size()));
+				std::nth_element(values.begin(), values.begin() + i, values.end());
+				return values[i];
+			}
+		}
+
+		void socket_benchmark_report::print(std::ostream& out) const
+		{
+			out << connections << " connections, " << messages << " messages of " << message_size << " bytes\n";
+			out << messages_per_second << " echoed messages per second\n";
+			out << "round trip us: p50 " << latency_p50_us << ", p90 " << latency_p90_us << ", p99 " << latency_p99_us << ", max " << latency_max_us << "\n";
+		}
+
+		socket_benchmark_report run_socket_benchmark(uint16_t port, unsigned connections, size_t messages, size_t message_size, unsigned window)
+		{
+			socket_benchmark_report report;
+			report.connections = connections;
+			report.messages = messages * connections;
+			report.message_size = message_size = std::max(message_size, (size_t)16);
+
+			socket_transport server, clients;
+			std::vector<std::shared_ptr<socket_connection>> accepted;
+			server.on_accept = [&](const std::shared_ptr<socket_connection>& conn) { accepted.push_back(conn); };
+			server.listen(port);
+
+			std::vector<echo_client> echo(connections);
+			for (auto& c : echo)
+			{
+				c.conn = clients.connect("127.0.0.1", port);
+				server.poll(0);
+			}
+			while (accepted.size() < connections)
+				server.poll(10);
+
+			std::vector<char> message(message_size, 0);
+			std::vector<double> latencies;
+			latencies.reserve(report.messages);
+
+			auto start = clock::now();
+			auto progress = start;
+			size_t done = 0;
+
+			// one thread runs both ends: clients keep a window of messages in flight, the server echoes them
+			while (done < report.messages)
+			{
+				for (auto& c : echo)
+				{
+					while (c.sent < messages && c.sent - c.received < window)
+						write_message(c.conn->out(), message, c.sent++);
+				}
+
+				server.poll(0);
+				for (auto& conn : accepted)
+				{
+					bool any = false;
+					while (read_message(conn->in(), message))
+					{
+						conn->out().write(message.data(), message.size());
+						any = true;
+					}
+					if (any) conn->out().flush();
+				}
+
+				clients.poll(0);
+				auto now = clock::now();
+				for (auto& c : echo)
+				{
+					if (!c.conn->connected()) throw std::runtime_error("socket benchmark lost a connection");
+
+					while (read_message(c.conn->in(), message))
+					{
+						int64_t sent;
+						uint64_t seq;
+						memcpy(&sent, message.data(), sizeof(sent));
+						memcpy(&seq, message.data() + sizeof(sent), sizeof(seq));
+						if (seq != c.received) throw std::runtime_error("socket benchmark received messages out of order");
+
+						latencies.push_back(std::chrono::duration<double, std::micro>(now - clock::time_point(clock::duration(sent))).count());
+						c.received++;
+						done++;
+						progress = now;
+					}
+				}
+
+				if (now - progress > std::chrono::seconds(10)) throw std::runtime_error("socket benchmark stalled");
+			}
+
+			double seconds = std::chrono::duration<double>(clock::now() - start).count();
+			report.messages_per_second = report.messages / seconds;
+			report.latency_p50_us = percentile(latencies, 0.5);
+			report.latency_p90_us = percentile(latencies, 0.9);
+			report.latency_p99_us = percentile(latencies, 0.99);
+			report.latency_max_us = *std::max_element(latencies.begin(), latencies.end());
+
+			return report;
+		}
+	}
+}
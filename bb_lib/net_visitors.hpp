@@ -17,13 +17,21 @@ namespace bb
 			InsertMap,
 			EraseMap,
 			ClearMap,
+			Leave,         // the node left the client's area of interest, no value follows
 		};
+
+		// Members of a node are addressed by their position in the node's reflect function
+		typedef unsigned short member_id;
+
+		static const member_id invalid_member = (member_id)-1;
 		
 		/*
 		 * Server update visitor.
 		 * Makes a packet of specific members in a node.
 		 * If a member is a node itself, a reference to the parent node is added, and
 		 *  the reference that was already there on the old version of the member node is removed.
+		 * Nodes dispatch the visitor straight to apply() through their member table,
+		 *  other objects are walked with reflect until the member with the right index comes up.
 		 */
 		template <typename Serializer>
 		struct update_visitor
@@ -37,21 +45,22 @@ namespace bb
 				virtual void ref(std::shared_ptr<polymorphic_node> node) = 0;
 			};
 
-			update_visitor(Serializer &ser, const char *tag, update_op op, void* key, void* value, reference_manager* refmgr)
+			update_visitor(Serializer &ser, member_id member, update_op op, void* key, void* value, reference_manager* refmgr)
 				: m_serializer(ser)
-				, m_tag(tag) 
+				, m_member(member) 
 				, m_operation(op)
 				, m_key(key)
 				, m_val(value)
 				, m_refmgr(refmgr) { }
 			
 			Serializer&        m_serializer;
-			std::string        m_tag;
+			member_id          m_member;
+			member_id          m_visited = 0;
 			update_op          m_operation;
 			void*              m_key;
 			void*              m_val;
-			int                m_found = 0;
 			reference_manager* m_refmgr;
+			bool               m_references = false;
 			
 			template <typename T> void acquire_key(T& x) { if (m_key) x = *((T*)m_key); }
 			template <typename T> void acquire_val(T& x) { if (m_val) x = *((T*)m_val); }
@@ -62,6 +71,8 @@ namespace bb
 			template <typename T>
 			void ref(std::shared_ptr<T>& x) 
 			{ 
+				if (x) m_references = true;
+
 				if (m_refmgr)
 				{
 					std::shared_ptr<net::polymorphic_node> n = std::dynamic_pointer_cast<net::polymorphic_node, T>(x);
@@ -85,138 +96,132 @@ namespace bb
 			template <typename T>
 			void operator()(const char* found_tag, T& x)
 			{
-				if (m_tag.compare(found_tag) == 0)
+				if (m_visited++ == m_member)
+				{
+					apply(found_tag, x);
+				}
+			}
+
+			template <typename T>
+			void apply(const char* found_tag, T& x)
+			{
+				switch (m_operation)
 				{
-					if (m_found) throw std::exception("duplicate tag detected");
-					m_found++;
-					switch (m_operation)
+					case update_op::Update:
+					{
+						unref(x);
+						acquire_val(x);
+						ref(x);
+						m_serializer(found_tag, x);
+						break;
+					}
+					default:
 					{
-						case update_op::Update:
-						{
-							unref(x);
-							acquire_val(x);
-							ref(x);
-							m_serializer(found_tag, x);
-							break;
-						}
-						default:
-						{
-							throw std::exception("invalid type found");
-						}
+						throw std::runtime_error("invalid type found");
 					}
 				}
 			}
 
 			template <typename T>
-			void operator()(const char* found_tag, std::vector<T>& x)
+			void apply(const char* found_tag, std::vector<T>& x)
 			{
-				if (m_tag.compare(found_tag) == 0)
+				switch (m_operation)
 				{
-					if (m_found) throw std::exception("duplicate tag detected");
-					m_found++;
-					switch (m_operation)
+					case update_op::Update:
 					{
-						case update_op::Update:
-						{
-							for (auto &y : x) unref(y);
-							acquire_val(x);
-							for (auto &y : x) ref(y);
-							m_serializer(found_tag, x);
-							break;
-						}
-						case update_op::AppendVector:
-						{
-							T val; acquire_val(val);
-							ref(val);
-							m_serializer("val", val);
-							x.push_back(val);
-							break;
-						}
-						case update_op::InsertVector:
-						{
-							size_t key; acquire_key(key);
-							T val;      acquire_val(val);
-							ref(val);
-							m_serializer("ind", key);
-							m_serializer("val", val);
-							x.insert(x.begin() + key, val);
-							break;
-						}
+						for (auto &y : x) unref(y);
+						acquire_val(x);
+						for (auto &y : x) ref(y);
+						m_serializer(found_tag, x);
+						break;
+					}
+					case update_op::AppendVector:
+					{
+						T val; acquire_val(val);
+						ref(val);
+						m_serializer("val", val);
+						x.push_back(val);
+						break;
+					}
+					case update_op::InsertVector:
+					{
+						size_t key; acquire_key(key);
+						T val;      acquire_val(val);
+						ref(val);
+						m_serializer("ind", key);
+						m_serializer("val", val);
+						x.insert(x.begin() + key, val);
+						break;
+					}
 
-						case update_op::EraseVector:
-						{
-							size_t key; acquire_key(key);
-							unref(x[key]);
-							m_serializer("ind", key);
-							x.erase(x.begin() + key);
-							break;
-						}
+					case update_op::EraseVector:
+					{
+						size_t key; acquire_key(key);
+						unref(x[key]);
+						m_serializer("ind", key);
+						x.erase(x.begin() + key);
+						break;
+					}
 
-						case update_op::ClearVector:
-						{
-							for (auto &y : x) unref(y);
-							x.clear();
-							break;
-						}
+					case update_op::ClearVector:
+					{
+						for (auto &y : x) unref(y);
+						x.clear();
+						break;
+					}
 
-						default:
-						{
-							throw std::exception("invalid type found");
-							break;
-						}
+					default:
+					{
+						throw std::runtime_error("invalid type found");
+						break;
 					}
 				}
 			}
 
 			template <typename K, typename V>
-			void operator()(const char* found_tag, std::map<K, V>& x)
+			void apply(const char* found_tag, std::map<K, V>& x)
 			{
-				if (m_tag.compare(found_tag) == 0)
+				switch (m_operation)
 				{
-					if (m_found) throw std::exception("duplicate tag detected");
-					m_found++;
-					switch (m_operation)
+					case update_op::Update:
 					{
-						case update_op::Update:
-						{
-							for (auto &y : x) unref(y.second);
-							acquire_val(x);
-							for (auto &y : x) ref(y.second);
-							m_serializer(found_tag, x);
-							break;
-						}
-						case update_op::InsertMap:
-						{
-							std::pair<K, V> keyval;
-							acquire_key(keyval.first);
-							acquire_val(keyval.second);
-							ref(keyval.second);
-							m_serializer("keyval", keyval);
-							x.insert(keyval);
-							break;
-						}
+						for (auto &y : x) unref(y.second);
+						acquire_val(x);
+						for (auto &y : x) ref(y.second);
+						m_serializer(found_tag, x);
+						break;
+					}
+					case update_op::InsertMap:
+					{
+						std::pair<K, V> keyval;
+						acquire_key(keyval.first);
+						acquire_val(keyval.second);
+						ref(keyval.second);
+						m_serializer("keyval", keyval);
+						x.insert(keyval);
+						break;
+					}
 
-						case update_op::EraseMap:
-						{
-							K key; acquire_key(key);
-							unref(x.at(key));
-							m_serializer("key", key);
-							x.erase(key);
-							break;
-						}
+					case update_op::EraseMap:
+					{
+						K key; acquire_key(key);
+						unref(x.at(key));
+						m_serializer("key", key);
+						x.erase(key);
+						break;
+					}
 
-						case update_op::ClearMap:
-						{
-							for (auto &y : x) unref(y.second);
-							x.clear();
-							break;
-						}
+					case update_op::ClearMap:
+					{
+						for (auto &y : x) unref(y.second);
+						x.clear();
+						break;
+					}
 
-						default:
-						{
-							throw std::exception("invalid type found");
-							break;
-						}
+					default:
+					{
+						throw std::runtime_error("invalid type found");
+						break;
 					}
 				}
 			}
@@ -288,6 +293,68 @@ namespace bb
 			void get() { }
 		};
 
+		/*
+		 * Replies carry a hash of their value's type name, so a call<R> that expects another type than the
+		 *  handler returns fails instead of misreading the stream. 0 is a reply without a value.
+		 * The name comes from typeid, client and server have to be built with the same compiler.
+		 */
+		template <typename T>
+		type_key result_type()
+		{
+			static const type_key key = std::is_void<T>::value ? 0 : intern_type(typeid(T).name());
+			return key;
+		}
+
+		/*
+		 * Return value of an rpc handler.
+		 * Kept type erased until the server writes the reply, with writers for every serializer it may use.
+		 */
+		struct rpc_result
+		{
+			template <typename R>
+			void set(R&& x)
+			{
+				using T = typename std::decay<R>::type;
+
+				m_value   = std::make_shared<T>(std::forward<R>(x));
+				m_type    = result_type<T>();
+				m_binary  = &write<BinarySerializer, T>;
+				m_text    = &write<TextSerializer, T>;
+				m_buffer  = &write<BufferSerializer, T>;
+				m_compact = &write<CompactSerializer, T>;
+			}
+
+			bool empty() const { return !m_value; }
+
+			type_key type() const { return m_value ? m_type : 0; }
+
+			void write(BinarySerializer& ser)  { m_binary(ser, m_value.get()); }
+			void write(TextSerializer& ser)    { m_text(ser, m_value.get()); }
+			void write(BufferSerializer& ser)  { m_buffer(ser, m_value.get()); }
+			void write(CompactSerializer& ser) { m_compact(ser, m_value.get()); }
+
+		private:
+			template <typename Serializer, typename T>
+			static void write(Serializer& ser, void* value)
+			{
+				ser("val", *static_cast<T*>(value));
+			}
+
+			std::shared_ptr<void> m_value;
+			type_key              m_type = 0;
+			void(*m_binary)(BinarySerializer&, void*) = nullptr;
+			void(*m_text)(TextSerializer&, void*) = nullptr;
+			void(*m_buffer)(BufferSerializer&, void*) = nullptr;
+			void(*m_compact)(CompactSerializer&, void*) = nullptr;
+		};
+
+		static const unsigned invalid_rpc = (unsigned)-1;
+
+		/*
+		 * Server rpc visitor.
+		 * Nodes set m_index from their rpc table, reflect_rpc is then walked comparing indices only.
+		 * Handlers that return a value fill m_result, it is sent back if the client asked for a reply.
+		 */
 		template <typename Serializer>
 		struct rpc_visitor
 		{
@@ -298,27 +365,58 @@ namespace bb
 			Serializer& m_serializer;
 			std::string m_tag;
 			int         m_found = 0;
+			unsigned    m_index = invalid_rpc;
+			unsigned    m_visited = 0;
+			rpc_result  m_result;
+
+			// when set, reflect_rpc only lists its tags here
+			std::vector<std::string>* m_collect = nullptr;
 
 			using Params = param_list_deserializer<Serializer>;
 
 			template <typename Fn>
 			void operator()(const char* found_tag, Fn deserialize_rpc)
 			{
-				if (m_tag.compare(found_tag) == 0)
+				if (m_collect)
+				{
+					m_collect->push_back(found_tag);
+					return;
+				}
+
+				if (m_index != invalid_rpc)
 				{
-					if (m_found) throw std::exception("duplicate tag detected");
-					m_found++;
-					
-					Params p(m_serializer);
-					deserialize_rpc(p);
+					if (m_visited++ != m_index) return;
 				}
+				else if (m_tag.compare(found_tag) != 0)
+				{
+					return;
+				}
+
+				if (m_found) throw std::runtime_error("duplicate tag detected");
+				m_found++;
+
+				Params p(m_serializer);
+				invoke(deserialize_rpc, p, std::is_void<decltype(deserialize_rpc(std::declval<Params&>()))>());
+			}
+
+		private:
+			template <typename Fn>
+			void invoke(Fn& deserialize_rpc, Params& p, std::true_type)
+			{
+				deserialize_rpc(p);
+			}
+
+			template <typename Fn>
+			void invoke(Fn& deserialize_rpc, Params& p, std::false_type)
+			{
+				m_result.set(deserialize_rpc(p));
 			}
 		};
 
 		template <typename Serializer, typename T>
 		void deserialize(Serializer& ser, std::shared_ptr<T>& object)
 		{
-			std::string tag;
+			member_id member;
 			update_op op;
 
 			ser("op", op);
@@ -342,23 +440,72 @@ namespace bb
 				case update_op::EraseMap:
 				case update_op::ClearMap:
 				{
-					ser("tag", tag);
-					update_visitor<Serializer> visitor(ser, tag.c_str(), op, nullptr, nullptr, nullptr);
+					ser("member", member);
+					update_visitor<Serializer> visitor(ser, member, op, nullptr, nullptr, nullptr);
 					object->reflect(visitor);
 					break;
 				}
 
 				default:
 				{
-					throw std::exception("invalid operation");
+					throw std::runtime_error("invalid operation");
+				}
+			}
+		}
+
+		// update of a node the caller already holds, a replace reads the node through the resolver
+		//  which hands back this same node, so no reference has to be taken for the common case.
+		// returns the operation, the client tracks Replace and Leave for client_node_base::in_interest
+		template <typename Serializer, typename T>
+		update_op deserialize_node(Serializer& ser, T& object)
+		{
+			member_id member;
+			update_op op;
+
+			ser("op", op);
+
+			switch (op)
+			{
+				case update_op::Replace:
+				{
+					std::shared_ptr<polymorphic_node> n;
+					ser("val", n);
+					break;
+				}
+
+				case update_op::Leave:
+				{
+					break;
+				}
+
+				case update_op::Update:
+				case update_op::AppendVector:
+				case update_op::InsertVector:
+				case update_op::EraseVector:
+				case update_op::ClearVector:
+				case update_op::InsertMap:
+				case update_op::EraseMap:
+				case update_op::ClearMap:
+				{
+					ser("member", member);
+					update_visitor<Serializer> visitor(ser, member, op, nullptr, nullptr, nullptr);
+					object.reflect(visitor);
+					break;
+				}
+
+				default:
+				{
+					throw std::runtime_error("invalid operation");
 				}
 			}
+
+			return op;
 		}
 
 		template <typename Serializer, typename T>
 		void deserialize(Serializer& ser, T& object)
 		{
-			std::string tag;
+			member_id member;
 			update_op op;
 
 			ser("op", op);
@@ -380,15 +527,15 @@ namespace bb
 				case update_op::EraseMap:
 				case update_op::ClearMap:
 				{
-					ser("tag", tag);
-					update_visitor<Serializer> visitor(ser, tag.c_str(), op, nullptr, nullptr, nullptr);
+					ser("member", member);
+					update_visitor<Serializer> visitor(ser, member, op, nullptr, nullptr, nullptr);
 					reflect(visitor, object);
 					break;
 				}
 
 				default:
 				{
-					throw std::exception("invalid operation");
+					throw std::runtime_error("invalid operation");
 				}
 			}
 		}
@@ -52,7 +52,7 @@ namespace bb
 		template <typename VISITOR>
 		void reflect_rpc(VISITOR& visit)
 		{
-			visit("petKittens", [&](VISITOR::Params& params)
+			visit("petKittens", [&](typename VISITOR::Params& params)
 			{
 				int count;
 				params.get(count);
@@ -91,7 +91,8 @@ namespace bb
 			sub->test_c = "c";
 			client->get_root<SvrDerivedTestNode>()->vector_push_back("test_recurse", sub);
 
-			sub->member_modify("test_a", std::string("test"));
+			std::string test = "test";
+			sub->member_modify("test_a", test);
 		}
 
 		// example: client logs in (clt side)
@@ -120,5 +121,55 @@ namespace bb
 
 			server.update_client(client.get());
 		}
+
+		// example: save data round trip through a byte buffer
+		{
+			std::vector<float> samples = { 0.25f, 0.5f, 0.75f };
+			std::string name = "buffer";
+
+			BufferSerializer out;
+			out("samples", samples);
+			out("name", name);
+
+			std::vector<float> samplesIn;
+			std::string nameIn;
+
+			BufferDeserializer in(out.data(), out.size());
+			in("samples", samplesIn);
+			in("name", nameIn);
+
+			if (samplesIn != samples || nameIn != name) throw std::runtime_error("buffer round trip failed");
+		}
+
+		// example: compact encoding, small integers take a single byte and the position is quantized to 16 bits
+		{
+			int64_t health = -3;
+			std::vector<size_t> ids = { 1, 2, 300 };
+			bool alive = true, visible = false;
+			float x = 12.5f;
+
+			CompactSerializer out;
+			out.quantize("x", -1024.0f, 1024.0f, 16);
+			out("health", health);
+			out("ids", ids);
+			out("alive", alive);
+			out("visible", visible);
+			out("x", x);
+
+			int64_t healthIn;
+			std::vector<size_t> idsIn;
+			bool aliveIn, visibleIn;
+			float xIn;
+
+			CompactDeserializer in(out.data(), out.size());
+			in.quantize("x", -1024.0f, 1024.0f, 16);
+			in("health", healthIn);
+			in("ids", idsIn);
+			in("alive", aliveIn);
+			in("visible", visibleIn);
+			in("x", xIn);
+
+			if (healthIn != health || idsIn != ids || aliveIn != alive || visibleIn != visible || fabsf(xIn - x) > 0.02f) throw std::runtime_error("compact round trip failed");
+		}
 	}
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <ostream>
 #include <istream>
 #include <string>
@@ -7,6 +10,7 @@
 #include <map>
 #include <memory>
 #include <type_traits>
+#include <stdexcept>
 #include <filesystem>
 
 namespace bb
@@ -15,26 +19,81 @@ namespace bb
 	{
 		class polymorphic_node;
 
+		// polymorphic_node is incomplete until net_node.hpp, naming it through the element type of a pointer
+		//  defers the node code in the serializer templates to their instantiation
+		template <typename T>
+		using node_of = typename std::conditional<true, polymorphic_node, T>::type;
+
+		// Node types travel as a 32 bit hash of their node_type() string, 0 stands for nullptr
+		typedef uint32_t type_key;
+
+		inline type_key intern_type(const char* type_id)
+		{
+			// FNV-1a
+			uint32_t hash = 2166136261u;
+			for (const char* c = type_id; *c; ++c)
+				hash = (hash ^ (uint8_t)*c) * 16777619u;
+
+			return hash ? hash : 1;
+		}
+
 		template <typename Deserializer>
 		class node_resolver
 		{
 		public:
 			virtual ~node_resolver() { }
 
-			virtual std::shared_ptr<polymorphic_node> resolve(const char* tid, size_t nid) = 0;
+			virtual std::shared_ptr<polymorphic_node> resolve(type_key tid, size_t nid) = 0;
 		};
 	}
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Types that binary serializers may copy as a block of memory, e.g. the elements of a vector.
+	// Specialize for plain structs whose reflect visits every member in declaration order without padding.
+	template <typename T>
+	struct is_bitwise_serializable : std::integral_constant<bool, std::is_arithmetic<T>::value && !std::is_same<T, bool>::value> { };
 }
 
 #include "serialize_binary.hpp"
+#include "serialize_buffer.hpp"
+#include "serialize_compact.hpp"
 #include "serialize_text.hpp"
 
 namespace bb
 {
+#if defined(_MSC_VER) && _MSC_VER < 1914
 	namespace fs = std::experimental::filesystem;
+#else
+	namespace fs = std::filesystem;
+#endif
 
 	void serialize_sanity_check();
 
+	//----------------------------------------------------------------------------------------------------------------
+	// Writes and reads a batch of entity messages with BinarySerializer over a stream, with BufferSerializer and
+	//  with CompactSerializer, which quantizes the position and heading.
+	// Throws when a round trip fails or the two binary serializers do not write the same bytes.
+	struct serialize_benchmark_report
+	{
+		size_t messages = 0;
+
+		size_t binary_bytes = 0;
+		double binary_write_ns = 0;   // per message
+		double binary_read_ns = 0;
+
+		size_t buffer_bytes = 0;
+		double buffer_write_ns = 0;
+		double buffer_read_ns = 0;
+
+		size_t compact_bytes = 0;
+		double compact_write_ns = 0;
+		double compact_read_ns = 0;
+
+		void print(std::ostream &out) const;
+	};
+
+	serialize_benchmark_report run_serialize_benchmark(size_t messages = 100000);
+
 	//----------------------------------------------------------------------------------------------------------------
 	// pair serialize/deserialize
 	template<typename A, typename B, typename Visitor>
@@ -0,0 +1,180 @@
+#include "net.hpp"
+
+#include <chrono>
+#include <sstream>
+
+namespace bb
+{
+	using namespace std;
+
+	namespace
+	{
+		// what a replicated entity typically sends: small integers, a position, flags and a short path
+		struct bench_entity
+		{
+			uint32_t      id = 0;
+			int32_t       health = 0;
+			float         x = 0, y = 0, z = 0;
+			float         yaw = 0;
+			bool          alive = false;
+			bool          visible = false;
+			string        name;
+			vector<float> path;
+
+			template <typename VISITOR>
+			void reflect(VISITOR& visit)
+			{
+				visit("id", id);
+				visit("health", health);
+				visit("x", x);
+				visit("y", y);
+				visit("z", z);
+				visit("yaw", yaw);
+				visit("alive", alive);
+				visit("visible", visible);
+				visit("name", name);
+				visit("path", path);
+			}
+
+			bool operator==(const bench_entity &o) const
+			{
+				return id == o.id && health == o.health && x == o.x && y == o.y && z == o.z && yaw == o.yaw &&
+					alive == o.alive && visible == o.visible && name == o.name && path == o.path;
+			}
+
+			// equal up to the quantization of the compact format
+			bool near(const bench_entity &o) const
+			{
+				return id == o.id && health == o.health && fabsf(x - o.x) <= 0.01f && fabsf(y - o.y) <= 0.01f &&
+					fabsf(z - o.z) <= 0.01f && fabsf(yaw - o.yaw) <= 0.01f && alive == o.alive && visible == o.visible &&
+					name == o.name && path == o.path;
+			}
+		};
+
+		template <typename Compact>
+		void quantize(Compact &compact)
+		{
+			compact.quantize("x", -1024, 1024, 20);
+			compact.quantize("y", -1024, 1024, 20);
+			compact.quantize("z", -1024, 1024, 20);
+			compact.quantize("yaw", 0, 6.2832f, 12);
+		}
+
+		vector<bench_entity> make_entities(size_t count)
+		{
+			vector<bench_entity> entities(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				bench_entity &e = entities[i];
+				e.id = (uint32_t)i;
+				e.health = (int32_t)(i % 200) - 50;
+				e.x = (i % 1000) * 0.5f;
+				e.y = (i % 37) * 0.25f;
+				e.z = (i / 1000) * 0.5f;
+				e.yaw = (i % 360) * 0.0174533f;
+				e.alive = i % 7 != 0;
+				e.visible = i % 3 != 0;
+				e.name = "unit" + to_string(i % 64);
+				e.path.resize(i % 5);
+				for (size_t p = 0; p < e.path.size(); ++p) e.path[p] = e.x + p;
+			}
+			return entities;
+		}
+
+		// best of a few runs, in nanoseconds per message
+		template <typename Fn>
+		double measure(size_t messages, Fn fn)
+		{
+			double best = 0;
+			for (int run = 0; run < 5; ++run)
+			{
+				auto start = chrono::steady_clock::now();
+				fn();
+				double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / messages;
+				if (run == 0 || ns < best) best = ns;
+			}
+			return best;
+		}
+	}
+
+	void serialize_benchmark_report::print(ostream &out) const
+	{
+		out << messages << " messages\n";
+		out << "BinarySerializer: " << binary_bytes << " bytes, write " << binary_write_ns << " ns, read " << binary_read_ns << " ns per message\n";
+		out << "BufferSerializer: " << buffer_bytes << " bytes, write " << buffer_write_ns << " ns, read " << buffer_read_ns << " ns per message\n";
+		out << "CompactSerializer: " << compact_bytes << " bytes, write " << compact_write_ns << " ns, read " << compact_read_ns << " ns per message\n";
+	}
+
+	serialize_benchmark_report run_serialize_benchmark(size_t messages)
+	{
+		serialize_benchmark_report report;
+		report.messages = messages;
+
+		vector<bench_entity> source = make_entities(messages);
+		vector<bench_entity> target(messages);
+
+		// stream based serializers, as used by the net code before the buffer path
+		ostringstream stream;
+		report.binary_write_ns = measure(messages, [&]
+		{
+			stream.str(string());
+			BinarySerializer serializer(stream);
+			for (auto &e : source) serializer("entity", e);
+		});
+
+		string bytes = stream.str();
+		report.binary_bytes = bytes.size();
+		report.binary_read_ns = measure(messages, [&]
+		{
+			istringstream in(bytes);
+			BinaryDeserializer deserializer(in);
+			for (auto &e : target) deserializer("entity", e);
+		});
+
+		if (target != source) throw runtime_error("BinarySerializer round trip failed");
+
+		BufferSerializer buffer;
+		report.buffer_write_ns = measure(messages, [&]
+		{
+			buffer.clear();
+			for (auto &e : source) buffer("entity", e);
+		});
+
+		report.buffer_bytes = buffer.size();
+		if (report.buffer_bytes != report.binary_bytes || memcmp(buffer.data(), bytes.data(), bytes.size()) != 0)
+			throw runtime_error("BufferSerializer does not write the BinarySerializer format");
+
+		target.assign(messages, bench_entity());
+		report.buffer_read_ns = measure(messages, [&]
+		{
+			BufferDeserializer deserializer(buffer.data(), buffer.size());
+			for (auto &e : target) deserializer("entity", e);
+		});
+
+		if (target != source) throw runtime_error("BufferSerializer round trip failed");
+
+		CompactSerializer compact;
+		quantize(compact);
+		report.compact_write_ns = measure(messages, [&]
+		{
+			compact.clear();
+			for (auto &e : source) compact("entity", e);
+		});
+
+		report.compact_bytes = compact.size();
+
+		target.assign(messages, bench_entity());
+		CompactDeserializer reader(compact.data(), compact.size());
+		quantize(reader);
+		report.compact_read_ns = measure(messages, [&]
+		{
+			reader.reset(compact.data(), compact.size());
+			for (auto &e : target) reader("entity", e);
+		});
+
+		for (size_t i = 0; i < messages; ++i)
+			if (!target[i].near(source[i])) throw runtime_error("CompactSerializer round trip failed");
+
+		return report;
+	}
+}
@@ -31,23 +31,29 @@ namespace bb
 			reflect(*this, x);
 		}
 
-		template <>
 		void operator()(const char*, bool x)
 		{
 			put(x);
 		}
 
 		// string serialization
-		template <>
 		void operator()(const char*, std::string &x)
 		{
 			put(x.size());
 			put(x.data(), x.size());
 		}
 
+		// vector serialization, bulk write for plain data
+		template <typename T>
+		typename std::enable_if<is_bitwise_serializable<T>::value, void>::type operator()(const char*, std::vector<T> &x)
+		{
+			put(x.size());
+			put(reinterpret_cast<const char*>(x.data()), x.size() * sizeof(T));
+		}
+
 		// vector serialization
 		template <typename T>
-		void operator()(const char*, std::vector<T> &x)
+		typename std::enable_if<!is_bitwise_serializable<T>::value, void>::type operator()(const char*, std::vector<T> &x)
 		{
 			put(x.size());
 			for (auto &elem : x)
@@ -67,10 +73,10 @@ namespace bb
 		template <typename T>
 		void operator()(const char*, std::shared_ptr<T> &x)
 		{
-			std::shared_ptr<net::polymorphic_node> n = std::dynamic_pointer_cast<net::polymorphic_node, T>(x);
+			std::shared_ptr<net::node_of<T>> n = std::dynamic_pointer_cast<net::node_of<T>, T>(x);
 
-			std::string type_id = n.get() ? n->get_type_id() : "nullptr_t";
-			size_t node_id      = n.get() ? n->get_node_id() : (-1);
+			net::type_key type_id = n.get() ? n->get_type_key() : 0;
+			size_t node_id        = n.get() ? n->get_node_id() : (-1);
 
 			operator()("type_id", type_id);
 			operator()("node_id", node_id);
@@ -135,14 +141,12 @@ namespace bb
 			reflect(*this, x);
 		}
 
-		template <>
 		void operator()(const char*, bool &x)
 		{
 			get(x);
 		}
 
 		// string deserialization
-		template <>
 		void operator()(const char*, std::string &x)
 		{
 			size_t size;
@@ -151,9 +155,20 @@ namespace bb
 			get(&x[0], size);
 		}
 
+		// vector deserialization, bulk read for plain data
+		template <typename T>
+		typename std::enable_if<is_bitwise_serializable<T>::value, void>::type operator()(const char*, std::vector<T> &x)
+		{
+			size_t size;
+			get(size);
+
+			x.resize(size);
+			get(reinterpret_cast<char*>(x.data()), size * sizeof(T));
+		}
+
 		// vector deserialization
 		template <typename T>
-		void operator()(const char*, std::vector<T> &x)
+		typename std::enable_if<!is_bitwise_serializable<T>::value, void>::type operator()(const char*, std::vector<T> &x)
 		{
 			size_t size;
 			get(size);
@@ -186,18 +201,18 @@ namespace bb
 		template <typename T>
 		void operator()(const char* tag, std::shared_ptr<T> &x)
 		{
-			size_t      node_id;
-			std::string type_id;
+			size_t        node_id;
+			net::type_key type_id;
 
 			operator()("type_id", type_id);
 			operator()("node_id", node_id);
 
-			if (type_id.compare("nullptr_t"))
+			if (type_id)
 			{
-				auto n = m_node_resolver->resolve(type_id.c_str(), node_id);
+				std::shared_ptr<net::node_of<T>> n = m_node_resolver->resolve(type_id, node_id);
 				n->reflect(*this);
 
-				x = std::dynamic_pointer_cast<T, net::polymorphic_node>(n);
+				x = std::dynamic_pointer_cast<T, net::node_of<T>>(n);
 			}
 			else
 			{
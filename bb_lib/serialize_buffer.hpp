@@ -0,0 +1,293 @@
+#pragma once
+
+#include <cstring>
+
+namespace bb
+{
+	//------------------------------------------------------------------------
+	// Binary serializer that writes to an owned byte buffer.
+	// Produces the same format as BinarySerializer, without going through a streambuf.
+	class BufferSerializer
+	{
+	public:
+		BufferSerializer(size_t capacity = 256)
+			: m_size(0)
+		{
+			m_buffer.resize(capacity);
+		}
+
+		// arithmetic types
+		template <typename T>
+		typename std::enable_if<std::is_arithmetic<T>::value, void>::type operator()(const char*, T x)
+		{
+			put(x);
+		}
+
+		// enums
+		template <typename T>
+		typename std::enable_if<std::is_enum<T>::value, void>::type operator()(const char*, T x)
+		{
+			put((size_t)x);
+		}
+
+		// dispatch serialization to reflect API
+		template <class T>
+		typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_enum<T>::value, void>::type operator()(const char*, T &x)
+		{
+			reflect(*this, x);
+		}
+
+		void operator()(const char*, bool x)
+		{
+			put(x);
+		}
+
+		// string serialization
+		void operator()(const char*, std::string &x)
+		{
+			put(x.size());
+			put(x.data(), x.size());
+		}
+
+		// vector serialization, bulk copy for plain data
+		template <typename T>
+		typename std::enable_if<is_bitwise_serializable<T>::value, void>::type operator()(const char*, std::vector<T> &x)
+		{
+			put(x.size());
+			put(reinterpret_cast<const char*>(x.data()), x.size() * sizeof(T));
+		}
+
+		// vector serialization
+		template <typename T>
+		typename std::enable_if<!is_bitwise_serializable<T>::value, void>::type operator()(const char*, std::vector<T> &x)
+		{
+			put(x.size());
+			for (auto &elem : x)
+				operator()(nullptr, elem);
+		}
+
+		// map serialization
+		template <typename K, typename V>
+		void operator()(const char*, std::map<K, V> &x)
+		{
+			put(x.size());
+			for (auto &elem : x)
+				reflect(*this, elem);
+		}
+
+		// net::node serialization
+		template <typename T>
+		void operator()(const char*, std::shared_ptr<T> &x)
+		{
+			std::shared_ptr<net::node_of<T>> n = std::dynamic_pointer_cast<net::node_of<T>, T>(x);
+
+			net::type_key type_id = n.get() ? n->get_type_key() : 0;
+			size_t node_id        = n.get() ? n->get_node_id() : (-1);
+
+			operator()("type_id", type_id);
+			operator()("node_id", node_id);
+
+			if (n.get() && !m_references_only)
+				n->reflect(*this);
+		}
+
+		operator bool()
+		{
+			return true;
+		}
+
+		void raw(const char*, void* data, size_t size)
+		{
+			put(reinterpret_cast<const char*>(data), size);
+		}
+
+		// write node references as type and id without their contents, e.g. to compare states that refer to
+		//  nodes tracked separately. Deserializers can't read the result.
+		void set_references_only(bool references_only) { m_references_only = references_only; }
+
+		const char* data() const { return m_buffer.data(); }
+		size_t      size() const { return m_size; }
+
+		// forget the contents, but keep the memory around for the next message
+		void clear() { m_size = 0; }
+
+	private:
+		template <typename T> void put(const T& val)
+		{
+			if (m_size + sizeof(T) > m_buffer.size()) grow(sizeof(T));
+
+			memcpy(&m_buffer[m_size], &val, sizeof(T));
+			m_size += sizeof(T);
+		}
+
+		void put(const char* data, size_t size)
+		{
+			if (size == 0) return;
+			if (m_size + size > m_buffer.size()) grow(size);
+
+			memcpy(&m_buffer[m_size], data, size);
+			m_size += size;
+		}
+
+		void grow(size_t size)
+		{
+			m_buffer.resize((std::max)(m_buffer.size() * 2, m_size + size));
+		}
+
+		std::vector<char> m_buffer;
+		size_t            m_size;
+		bool              m_references_only = false;
+	};
+
+	//------------------------------------------------------------------------
+	// Binary deserializer that reads from a byte buffer it does not own.
+	// Reads the format written by BinarySerializer and BufferSerializer, every read is bounds checked.
+	class BufferDeserializer
+	{
+	public:
+		BufferDeserializer(const char* data, size_t size, net::node_resolver<BufferDeserializer>* resolver = nullptr)
+			: m_cursor(data)
+			, m_end(data + size)
+			, m_node_resolver(resolver) { }
+
+		// arithmetic types
+		template <typename T>
+		typename std::enable_if< std::is_arithmetic<T>::value, void>::type operator()(const char*, T &x)
+		{
+			get(x);
+		}
+
+		// enums
+		template <typename T>
+		typename std::enable_if< std::is_enum<T>::value, void>::type operator()(const char*, T &x)
+		{
+			size_t _x;
+			get(_x);
+			x = (T)_x;
+		}
+
+		// dispatch deserialization to reflect API
+		template <class T>
+		typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_enum<T>::value, void>::type operator()(const char*, T &x)
+		{
+			reflect(*this, x);
+		}
+
+		void operator()(const char*, bool &x)
+		{
+			get(x);
+		}
+
+		// string deserialization
+		void operator()(const char*, std::string &x)
+		{
+			size_t size;
+			get(size);
+			check(size);
+			x.assign(m_cursor, size);
+			m_cursor += size;
+		}
+
+		// vector deserialization, bulk copy for plain data
+		template <typename T>
+		typename std::enable_if<is_bitwise_serializable<T>::value, void>::type operator()(const char*, std::vector<T> &x)
+		{
+			size_t size;
+			get(size);
+			if (size > remaining() / sizeof(T)) throw std::runtime_error("buffer underrun");
+
+			x.resize(size);
+			get(reinterpret_cast<char*>(x.data()), size * sizeof(T));
+		}
+
+		// vector deserialization
+		template <typename T>
+		typename std::enable_if<!is_bitwise_serializable<T>::value, void>::type operator()(const char*, std::vector<T> &x)
+		{
+			size_t size;
+			get(size);
+
+			x.clear();
+			x.reserve((std::min)(size, remaining()));
+			for (size_t i = 0; i < size; ++i)
+			{
+				T elem; operator()(nullptr, elem);
+				x.push_back(elem);
+			}
+		}
+
+		// map deserialization
+		template <typename K, typename V>
+		void operator()(const char*, std::map<K, V> &x)
+		{
+			size_t size;
+			get(size);
+
+			x.clear();
+			for (size_t i = 0; i < size; ++i)
+			{
+				std::pair<K, V> elem; reflect(*this, elem);
+				x.insert(elem);
+			}
+		}
+
+		// net::node deserialization
+		template <typename T>
+		void operator()(const char* tag, std::shared_ptr<T> &x)
+		{
+			size_t        node_id;
+			net::type_key type_id;
+
+			operator()("type_id", type_id);
+			operator()("node_id", node_id);
+
+			if (type_id)
+			{
+				std::shared_ptr<net::node_of<T>> n = m_node_resolver->resolve(type_id, node_id);
+				n->reflect(*this);
+
+				x = std::dynamic_pointer_cast<T, net::node_of<T>>(n);
+			}
+			else
+			{
+				x = nullptr;
+			}
+		}
+
+		operator bool()
+		{
+			return m_cursor < m_end;
+		}
+
+		void raw(const char*, void* data, size_t size)
+		{
+			get(reinterpret_cast<char*>(data), size);
+		}
+
+		size_t remaining() const { return m_end - m_cursor; }
+
+	private:
+		void check(size_t size) const
+		{
+			if (size > remaining()) throw std::runtime_error("buffer underrun");
+		}
+
+		template <typename T> void get(T& val)
+		{
+			check(sizeof(T));
+			memcpy(&val, m_cursor, sizeof(T));
+			m_cursor += sizeof(T);
+		}
+
+		void get(char* data, size_t size)
+		{
+			check(size);
+			if (size) memcpy(data, m_cursor, size);
+			m_cursor += size;
+		}
+
+		const char* m_cursor;
+		const char* m_end;
+		net::node_resolver<BufferDeserializer>* m_node_resolver;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,491 @@
+#pragma once
+
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+namespace bb
+{
+	//------------------------------------------------------------------------
+	// Float members that are sent with reduced precision by the compact serializers.
+	// Both ends need to register the same tags.
+	struct float_quantization
+	{
+		std::string tag;
+		float       min;
+		float       max;
+		unsigned    bits;
+	};
+
+	//------------------------------------------------------------------------
+	// The registered quantizations of a compact serializer. Tags are member names, usually literals, so the
+	//  lookup is cached by tag pointer and confirmed with a single compare. A message has few distinct tags,
+	//  the cache is searched linearly.
+	class float_quantizer
+	{
+	public:
+		void add(const char* tag, float min, float max, unsigned bits)
+		{
+			if (bits < 1 || bits > 32) throw std::runtime_error("quantization needs 1 to 32 bits");
+			if (!(max > min)) throw std::runtime_error("quantization range is empty");
+
+			m_quantization.push_back({ tag, min, max, bits });
+			m_lookup.clear();
+		}
+
+		const float_quantization* find(const char* tag)
+		{
+			if (tag == nullptr || m_quantization.empty()) return nullptr;
+
+			lookup* cached = nullptr;
+			for (auto &l : m_lookup)
+			{
+				if (l.pointer != tag) continue;
+				if (strcmp(l.name.c_str(), tag) == 0) return l.index < 0 ? nullptr : &m_quantization[l.index];
+
+				cached = &l;
+				break;
+			}
+
+			int index = -1;
+			for (size_t i = 0; i < m_quantization.size(); ++i)
+			{
+				if (m_quantization[i].tag.compare(tag) == 0)
+				{
+					index = (int)i;
+					break;
+				}
+			}
+
+			// the pointer may be reused for another tag later, the entry keeps a copy to compare with
+			if (!cached)
+			{
+				m_lookup.emplace_back();
+				cached = &m_lookup.back();
+				cached->pointer = tag;
+			}
+			cached->name = tag;
+			cached->index = index;
+			return index < 0 ? nullptr : &m_quantization[index];
+		}
+
+		static uint64_t encode(const float_quantization &q, float x)
+		{
+			float t = (x - q.min) / (q.max - q.min);
+			t = t < 0 ? 0 : (t > 1 ? 1 : t);
+			return (uint64_t)(t * (double)range(q) + 0.5);   // not negative, truncation rounds
+		}
+
+		static float decode(const float_quantization &q, uint64_t x)
+		{
+			return (float)(q.min + (q.max - q.min) * (x / (double)range(q)));
+		}
+
+	private:
+		struct lookup
+		{
+			const char* pointer;
+			std::string name;    // what pointer pointed to
+			int         index;   // in m_quantization, -1 when the tag is not quantized
+		};
+
+		static uint64_t range(const float_quantization &q) { return (uint64_t(1) << q.bits) - 1; }
+
+		std::vector<float_quantization> m_quantization;
+		std::vector<lookup>             m_lookup;
+	};
+
+	//------------------------------------------------------------------------
+	// Compact binary serializer for network traffic.
+	// Integers, lengths, enums and node ids are LEB128 varints (zigzag for signed values),
+	// consecutive bools share a byte and floats with a registered tag are quantized.
+	class CompactSerializer
+	{
+	public:
+		CompactSerializer(size_t capacity = 256)
+			: m_size(0)
+		{
+			m_buffer.resize(capacity);
+		}
+
+		// quantize float members with this tag to 1 to 32 bits in the [min, max] range
+		void quantize(const char* tag, float min, float max, unsigned bits)
+		{
+			m_quantization.add(tag, min, max, bits);
+		}
+
+		// arithmetic types
+		template <typename T>
+		typename std::enable_if<std::is_arithmetic<T>::value, void>::type operator()(const char* tag, T x)
+		{
+			write(tag, x);
+		}
+
+		// enums
+		template <typename T>
+		typename std::enable_if<std::is_enum<T>::value, void>::type operator()(const char*, T x)
+		{
+			put_varint((uint64_t)x);
+		}
+
+		// dispatch serialization to reflect API
+		template <class T>
+		typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_enum<T>::value, void>::type operator()(const char*, T &x)
+		{
+			reflect(*this, x);
+		}
+
+		void operator()(const char*, bool x)
+		{
+			put_bit(x);
+		}
+
+		// string serialization
+		void operator()(const char*, std::string &x)
+		{
+			put_varint(x.size());
+			put(x.data(), x.size());
+		}
+
+		// vector serialization
+		template <typename T>
+		void operator()(const char* tag, std::vector<T> &x)
+		{
+			put_varint(x.size());
+			for (auto &elem : x)
+				operator()(tag, elem);
+		}
+
+		// map serialization
+		template <typename K, typename V>
+		void operator()(const char*, std::map<K, V> &x)
+		{
+			put_varint(x.size());
+			for (auto &elem : x)
+				reflect(*this, elem);
+		}
+
+		// net::node serialization, node ids are offset by one so that nullptr encodes as 0 without a type
+		template <typename T>
+		void operator()(const char*, std::shared_ptr<T> &x)
+		{
+			std::shared_ptr<net::node_of<T>> n = std::dynamic_pointer_cast<net::node_of<T>, T>(x);
+
+			put_varint(n.get() ? n->get_node_id() + 1 : 0);
+
+			if (n.get())
+			{
+				net::type_key type_id = n->get_type_key();
+				put(reinterpret_cast<const char*>(&type_id), sizeof(type_id));
+				n->reflect(*this);
+			}
+		}
+
+		operator bool()
+		{
+			return true;
+		}
+
+		void raw(const char*, void* data, size_t size)
+		{
+			put(reinterpret_cast<const char*>(data), size);
+		}
+
+		const char* data() const { return m_buffer.data(); }
+		size_t      size() const { return m_size; }
+
+		// forget the contents, but keep the memory around for the next message
+		void clear()
+		{
+			m_size = 0;
+			m_bits_used = 8;
+		}
+
+	private:
+		template <typename T>
+		typename std::enable_if<std::is_floating_point<T>::value, void>::type write(const char* tag, T x)
+		{
+			if (auto q = m_quantization.find(tag))
+			{
+				put_varint(float_quantizer::encode(*q, (float)x));
+			}
+			else
+			{
+				put(reinterpret_cast<const char*>(&x), sizeof(T));
+			}
+		}
+
+		template <typename T>
+		typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 1, void>::type write(const char*, T x)
+		{
+			put(reinterpret_cast<const char*>(&x), 1);
+		}
+
+		template <typename T>
+		typename std::enable_if<std::is_integral<T>::value && sizeof(T) != 1 && std::is_unsigned<T>::value, void>::type write(const char*, T x)
+		{
+			put_varint((uint64_t)x);
+		}
+
+		template <typename T>
+		typename std::enable_if<std::is_integral<T>::value && sizeof(T) != 1 && std::is_signed<T>::value, void>::type write(const char*, T x)
+		{
+			int64_t v = (int64_t)x;
+			put_varint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+		}
+
+		void put_bit(bool x)
+		{
+			if (m_bits_used == 8)
+			{
+				reserve(1);
+				m_bits_offset = m_size;
+				m_buffer[m_size++] = 0;
+				m_bits_used = 0;
+			}
+
+			if (x) m_buffer[m_bits_offset] |= (char)(1 << m_bits_used);
+			m_bits_used++;
+		}
+
+		void put_varint(uint64_t x)
+		{
+			reserve(10);
+			m_bits_used = 8;
+
+			while (x >= 0x80)
+			{
+				m_buffer[m_size++] = (char)(x | 0x80);
+				x >>= 7;
+			}
+			m_buffer[m_size++] = (char)x;
+		}
+
+		void put(const char* data, size_t size)
+		{
+			m_bits_used = 8;
+			if (size == 0) return;
+
+			reserve(size);
+			memcpy(&m_buffer[m_size], data, size);
+			m_size += size;
+		}
+
+		void reserve(size_t size)
+		{
+			if (m_size + size > m_buffer.size())
+				m_buffer.resize((std::max)(m_buffer.size() * 2, m_size + size));
+		}
+
+		std::vector<char>               m_buffer;
+		size_t                          m_size;
+		size_t                          m_bits_offset = 0;
+		unsigned                        m_bits_used = 8;
+		float_quantizer                 m_quantization;
+	};
+
+	//------------------------------------------------------------------------
+	// Reads the format written by CompactSerializer from a byte buffer it does not own.
+	class CompactDeserializer
+	{
+	public:
+		CompactDeserializer(const char* data, size_t size, net::node_resolver<CompactDeserializer>* resolver = nullptr)
+			: m_cursor(data)
+			, m_end(data + size)
+			, m_node_resolver(resolver) { }
+
+		// quantize float members with this tag to 1 to 32 bits in the [min, max] range
+		void quantize(const char* tag, float min, float max, unsigned bits)
+		{
+			m_quantization.add(tag, min, max, bits);
+		}
+
+		// point the deserializer at the next received buffer
+		void reset(const char* data, size_t size)
+		{
+			m_cursor = data;
+			m_end = data + size;
+			m_bits_used = 8;
+		}
+
+		// arithmetic types
+		template <typename T>
+		typename std::enable_if< std::is_arithmetic<T>::value, void>::type operator()(const char* tag, T &x)
+		{
+			read(tag, x);
+		}
+
+		// enums
+		template <typename T>
+		typename std::enable_if< std::is_enum<T>::value, void>::type operator()(const char*, T &x)
+		{
+			x = (T)get_varint();
+		}
+
+		// dispatch deserialization to reflect API
+		template <class T>
+		typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_enum<T>::value, void>::type operator()(const char*, T &x)
+		{
+			reflect(*this, x);
+		}
+
+		void operator()(const char*, bool &x)
+		{
+			x = get_bit();
+		}
+
+		// string deserialization
+		void operator()(const char*, std::string &x)
+		{
+			size_t size = (size_t)get_varint();
+			check(size);
+			x.assign(m_cursor, size);
+			m_cursor += size;
+		}
+
+		// vector deserialization
+		template <typename T>
+		void operator()(const char* tag, std::vector<T> &x)
+		{
+			size_t size = (size_t)get_varint();
+
+			x.clear();
+			x.reserve((std::min)(size, remaining()));
+			for (size_t i = 0; i < size; ++i)
+			{
+				T elem; operator()(tag, elem);
+				x.push_back(elem);
+			}
+		}
+
+		// map deserialization
+		template <typename K, typename V>
+		void operator()(const char*, std::map<K, V> &x)
+		{
+			size_t size = (size_t)get_varint();
+
+			x.clear();
+			for (size_t i = 0; i < size; ++i)
+			{
+				std::pair<K, V> elem; reflect(*this, elem);
+				x.insert(elem);
+			}
+		}
+
+		// net::node deserialization
+		template <typename T>
+		void operator()(const char* tag, std::shared_ptr<T> &x)
+		{
+			size_t node_id = (size_t)get_varint();
+
+			if (node_id)
+			{
+				net::type_key type_id;
+				get(reinterpret_cast<char*>(&type_id), sizeof(type_id));
+
+				std::shared_ptr<net::node_of<T>> n = m_node_resolver->resolve(type_id, node_id - 1);
+				n->reflect(*this);
+
+				x = std::dynamic_pointer_cast<T, net::node_of<T>>(n);
+			}
+			else
+			{
+				x = nullptr;
+			}
+		}
+
+		operator bool()
+		{
+			return m_cursor < m_end;
+		}
+
+		void raw(const char*, void* data, size_t size)
+		{
+			get(reinterpret_cast<char*>(data), size);
+		}
+
+		size_t remaining() const { return m_end - m_cursor; }
+
+	private:
+		template <typename T>
+		typename std::enable_if<std::is_floating_point<T>::value, void>::type read(const char* tag, T &x)
+		{
+			if (auto q = m_quantization.find(tag))
+			{
+				x = (T)float_quantizer::decode(*q, get_varint());
+			}
+			else
+			{
+				get(reinterpret_cast<char*>(&x), sizeof(T));
+			}
+		}
+
+		template <typename T>
+		typename std::enable_if<std::is_integral<T>::value && sizeof(T) == 1, void>::type read(const char*, T &x)
+		{
+			get(reinterpret_cast<char*>(&x), 1);
+		}
+
+		template <typename T>
+		typename std::enable_if<std::is_integral<T>::value && sizeof(T) != 1 && std::is_unsigned<T>::value, void>::type read(const char*, T &x)
+		{
+			x = (T)get_varint();
+		}
+
+		template <typename T>
+		typename std::enable_if<std::is_integral<T>::value && sizeof(T) != 1 && std::is_signed<T>::value, void>::type read(const char*, T &x)
+		{
+			uint64_t v = get_varint();
+			x = (T)((int64_t)(v >> 1) ^ -(int64_t)(v & 1));
+		}
+
+		void check(size_t size) const
+		{
+			if (size > remaining()) throw std::runtime_error("buffer underrun");
+		}
+
+		bool get_bit()
+		{
+			if (m_bits_used == 8)
+			{
+				check(1);
+				m_bits = (unsigned char)*m_cursor++;
+				m_bits_used = 0;
+			}
+
+			return ((m_bits >> m_bits_used++) & 1) != 0;
+		}
+
+		uint64_t get_varint()
+		{
+			m_bits_used = 8;
+
+			uint64_t x = 0;
+			for (unsigned shift = 0; shift < 64; shift += 7)
+			{
+				check(1);
+				unsigned char byte = (unsigned char)*m_cursor++;
+				x |= (uint64_t)(byte & 0x7f) << shift;
+				if ((byte & 0x80) == 0) return x;
+			}
+
+			throw std::runtime_error("malformed varint");
+		}
+
+		void get(char* data, size_t size)
+		{
+			m_bits_used = 8;
+
+			check(size);
+			if (size) memcpy(data, m_cursor, size);
+			m_cursor += size;
+		}
+
+		const char*                     m_cursor;
+		const char*                     m_end;
+		unsigned char                   m_bits = 0;
+		unsigned                        m_bits_used = 8;
+		net::node_resolver<CompactDeserializer>* m_node_resolver;
+		float_quantizer                 m_quantization;
+	};
+}
\ No newline at end of file
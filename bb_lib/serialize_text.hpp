@@ -54,14 +54,12 @@ namespace bb
 			stream(--m_indentation) << "}" << std::endl;
 		}
 
-		template <>
 		void write(bool x)
 		{
 			stream() << x << std::endl;
 		}
 
 		// string serialization
-		template <>
 		void write(std::string &x)
 		{
 			stream() << "\"" << x << "\"" << std::endl;
@@ -99,7 +97,7 @@ namespace bb
 		template <typename T>
 		void write(std::shared_ptr<T> &x)
 		{
-			std::shared_ptr<net::polymorphic_node> n = std::dynamic_pointer_cast<net::polymorphic_node, T>(x);
+			std::shared_ptr<net::node_of<T>> n = std::dynamic_pointer_cast<net::node_of<T>, T>(x);
 			
 			stream() << "{" << std::endl;
 			m_indentation++;
@@ -127,7 +125,7 @@ namespace bb
 	{
 		void assert_exc(bool cond, const char* message)
 		{
-			if (!cond) throw std::exception(message);
+			if (!cond) throw std::runtime_error(message);
 		}
 	}
 
@@ -200,14 +198,12 @@ namespace bb
 			assert_exc(get() == '}', "expected '}'");
 		}
 
-		template <>
 		void read(bool &x)
 		{
 			m_stream >> x;
 		}
 
 		// string deserialization
-		template <>
 		void read(std::string &x)
 		{
 			assert_exc(get() == '"', "expected '\"'");
@@ -257,10 +253,10 @@ namespace bb
 
 			if (type_id.compare("nullptr_t"))
 			{
-				auto n = m_node_resolver->resolve(type_id.c_str(), node_id);
+				std::shared_ptr<net::node_of<T>> n = m_node_resolver->resolve(net::intern_type(type_id.c_str()), node_id);
 				n->reflect(*this);
 
-				x = std::dynamic_pointer_cast<T, net::polymorphic_node>(n);
+				x = std::dynamic_pointer_cast<T, net::node_of<T>>(n);
 			}
 			else
 			{
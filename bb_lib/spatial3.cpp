@@ -0,0 +1,44 @@
+#include "spatial3.h"
+#include "mat4.h"
+
+#include <cmath>
+
+namespace bb
+{
+	frustum::frustum(const mat4 &viewProjection)
+	{
+		const float *m = viewProjection.m;
+
+		// clip = M * v, row r of M is m[r], m[4 + r], m[8 + r], m[12 + r]
+		auto row = [m](int r) { return vec4(m[r], m[4 + r], m[8 + r], m[12 + r]); };
+		vec4 x = row(0), y = row(1), z = row(2), w = row(3);
+
+		m_Planes[0] = w + x;
+		m_Planes[1] = w - x;
+		m_Planes[2] = w + y;
+		m_Planes[3] = w - y;
+		m_Planes[4] = w + z;
+		m_Planes[5] = w - z;
+
+		for (vec4 &p : m_Planes)
+		{
+			float length = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+			p = p * (1 / length);
+		}
+
+		mat4 inverse = viewProjection;
+		inverse.inverse();
+
+		m_A = vec3(INFINITY, INFINITY, INFINITY);
+		m_B = vec3(-INFINITY, -INFINITY, -INFINITY);
+
+		for (int i = 0; i < 8; ++i)
+		{
+			vec4 c = inverse * vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+			vec3 corner(c.x / c.w, c.y / c.w, c.z / c.w);
+
+			m_A = vec3(std::min(m_A.x, corner.x), std::min(m_A.y, corner.y), std::min(m_A.z, corner.z));
+			m_B = vec3(std::max(m_B.x, corner.x), std::max(m_B.y, corner.y), std::max(m_B.z, corner.z));
+		}
+	}
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "vec3.h"
+#include "vec4.h"
+#include "ray.h"
+
+namespace bb
+{
+	struct mat4;
+
+	// An axis aligned box a..b with the user's pointer, as stored by hash_grid3 and loose_octree.
+	struct element3
+	{
+		vec3  m_A;
+		vec3  m_B;
+		void* m_Ptr;
+	};
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Tests shared by the 3D indices, boxes are a..b
+
+	inline bool boxesOverlap(const vec3 &a0, const vec3 &b0, const vec3 &a1, const vec3 &b1)
+	{
+		return a0.x <= b1.x && b0.x >= a1.x &&
+			a0.y <= b1.y && b0.y >= a1.y &&
+			a0.z <= b1.z && b0.z >= a1.z;
+	}
+
+	inline bool boxSphereOverlap(const vec3 &a, const vec3 &b, const vec3 &centre, float radius)
+	{
+		float dx = std::max(std::max(a.x - centre.x, centre.x - b.x), 0.0f);
+		float dy = std::max(std::max(a.y - centre.y, centre.y - b.y), 0.0f);
+		float dz = std::max(std::max(a.z - centre.z, centre.z - b.z), 0.0f);
+		return dx * dx + dy * dy + dz * dz <= radius * radius;
+	}
+
+	// whether a0..b0 lies completely inside a1..b1
+	inline bool boxContains(const vec3 &a1, const vec3 &b1, const vec3 &a0, const vec3 &b0)
+	{
+		return a0.x >= a1.x && b0.x <= b1.x &&
+			a0.y >= a1.y && b0.y <= b1.y &&
+			a0.z >= a1.z && b0.z <= b1.z;
+	}
+
+	// whether the box a..b lies completely inside the sphere, its farthest corner is
+	inline bool sphereContainsBox(const vec3 &centre, float radius, const vec3 &a, const vec3 &b)
+	{
+		float dx = std::max(centre.x - a.x, b.x - centre.x);
+		float dy = std::max(centre.y - a.y, b.y - centre.y);
+		float dz = std::max(centre.z - a.z, b.z - centre.z);
+		return dx * dx + dy * dy + dz * dz <= radius * radius;
+	}
+
+	/*
+	 * The six planes of a view-projection matrix (OpenGL clip space), normals point inwards.
+	 * The tests are conservative: a box is rejected when it is outside the bounds of the corners or completely
+	 *  behind one of the planes.
+	 */
+	struct frustum
+	{
+		frustum() { }
+		explicit frustum(const mat4 &viewProjection);
+
+		bool intersects(const vec3 &a, const vec3 &b) const
+		{
+			if (!boxesOverlap(a, b, m_A, m_B)) return false;
+
+			for (const vec4 &p : m_Planes)
+			{
+				float x = p.x >= 0 ? b.x : a.x;
+				float y = p.y >= 0 ? b.y : a.y;
+				float z = p.z >= 0 ? b.z : a.z;
+				if (p.x * x + p.y * y + p.z * z + p.w < 0) return false;
+			}
+			return true;
+		}
+
+		// whether a..b lies completely inside, every box inside it then intersects
+		bool contains(const vec3 &a, const vec3 &b) const
+		{
+			if (!boxContains(m_A, m_B, a, b)) return false;
+
+			for (const vec4 &p : m_Planes)
+			{
+				float x = p.x >= 0 ? a.x : b.x;
+				float y = p.y >= 0 ? a.y : b.y;
+				float z = p.z >= 0 ? a.z : b.z;
+				if (p.x * x + p.y * y + p.z * z + p.w < 0) return false;
+			}
+			return true;
+		}
+
+		bool intersects(const vec3 &centre, float radius) const
+		{
+			if (!boxSphereOverlap(m_A, m_B, centre, radius)) return false;
+
+			for (const vec4 &p : m_Planes)
+			{
+				if (p.x * centre.x + p.y * centre.y + p.z * centre.z + p.w < -radius) return false;
+			}
+			return true;
+		}
+
+		vec4 m_Planes[6];   // left, right, bottom, top, near, far as (normal, distance)
+		vec3 m_A;           // bounds of the corners
+		vec3 m_B;
+	};
+
+	// A segment p0 + (p1 - p0) * t for t in 0..1, with the reciprocal of the direction for the slab tests.
+	struct segment3
+	{
+		explicit segment3(const ray &r)
+			: m_P0(r.p0)
+			, m_Dir(r.p1.x - r.p0.x, r.p1.y - r.p0.y, r.p1.z - r.p0.z)
+			, m_Inv(1 / m_Dir.x, 1 / m_Dir.y, 1 / m_Dir.z) { }
+
+		// t where the segment enters the box, 0 when it starts inside, negative when it misses
+		float entry(const vec3 &a, const vec3 &b) const
+		{
+			float t0 = 0, t1 = 1;
+			if (!slab(a.x, b.x, m_P0.x, m_Dir.x, m_Inv.x, t0, t1)) return -1;
+			if (!slab(a.y, b.y, m_P0.y, m_Dir.y, m_Inv.y, t0, t1)) return -1;
+			if (!slab(a.z, b.z, m_P0.z, m_Dir.z, m_Inv.z, t0, t1)) return -1;
+			return t0;
+		}
+
+		vec3 m_P0;
+		vec3 m_Dir;
+		vec3 m_Inv;
+
+	private:
+		static bool slab(float a, float b, float p, float d, float inv, float &t0, float &t1)
+		{
+			// parallel to the slab, inside or not at all
+			if (d == 0) return p >= a && p <= b;
+
+			float ta = (a - p) * inv;
+			float tb = (b - p) * inv;
+			if (ta > tb) std::swap(ta, tb);
+
+			t0 = std::max(t0, ta);
+			t1 = std::min(t1, tb);
+			return t0 <= t1;
+		}
+	};
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Checks hash_grid3 and loose_octree against a scan of every object: random inserts, removes and moves, with
+	//  box, sphere, ray and frustum queries in between. Throws when an index reports other objects than the scan.
+	struct spatial3_check_report
+	{
+		struct index_result
+		{
+			std::string name;
+			size_t      objects = 0;   // at the end
+			size_t      queries = 0;
+			double      index_ms = 0;  // all queries
+			double      scan_ms = 0;
+		};
+
+		unsigned                  steps = 0;
+		std::vector<index_result> indices;
+
+		void print(std::ostream &out) const;
+	};
+
+	spatial3_check_report run_spatial3_check(unsigned steps = 3000, unsigned seed = 1);
+}
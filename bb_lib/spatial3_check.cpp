@@ -0,0 +1,233 @@
+#include "spatial3.h"
+#include "hash_grid3.h"
+#include "loose_octree.h"
+#include "mat4.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace bb
+{
+	using namespace std;
+
+	namespace
+	{
+		typedef chrono::steady_clock clock;
+
+		double seconds(clock::time_point a, clock::time_point b)
+		{
+			return chrono::duration<double>(b - a).count();
+		}
+
+		// the objects by handle, scanned for the expected results
+		struct reference
+		{
+			vector<element3> m_Elements;
+			vector<char>     m_Alive;
+			vector<uint32_t> m_Live;
+
+			void set(uint32_t h, const element3 &e)
+			{
+				if (h >= m_Elements.size())
+				{
+					m_Elements.resize(h + 1);
+					m_Alive.resize(h + 1);
+				}
+				if (!m_Alive[h]) m_Live.push_back(h);
+				m_Elements[h] = e;
+				m_Alive[h] = 1;
+			}
+
+			void remove(uint32_t h)
+			{
+				m_Alive[h] = 0;
+				m_Live.erase(find(m_Live.begin(), m_Live.end(), h));
+			}
+
+			template <typename Test>
+			void scan(Test test, vector<void*> &result) const
+			{
+				for (uint32_t h : m_Live)
+				{
+					if (test(m_Elements[h])) result.push_back(m_Elements[h].m_Ptr);
+				}
+			}
+		};
+
+		struct scenario
+		{
+			float    world;         // objects start in -world..world
+			float    maxSize;       // most objects are much smaller
+			unsigned objects;       // inserted before the steps
+		};
+
+		template <typename Index>
+		void check(const char *name, Index &index, const scenario &s, unsigned steps, mt19937 &random, spatial3_check_report &report)
+		{
+			uniform_real_distribution<float> place(-s.world, s.world), size(0, s.maxSize), unit(0, 1);
+
+			spatial3_check_report::index_result result;
+			result.name = name;
+
+			reference objects;
+			uintptr_t next = 1;
+			vector<void*> got, expected;
+			clock::duration indexTime(0), scanTime(0);
+
+			auto compare = [&](const char *query)
+			{
+				sort(got.begin(), got.end());
+				sort(expected.begin(), expected.end());
+				if (got != expected) throw exception((string(name) + ": " + query + " query differs from a scan").c_str());
+				got.clear();
+				expected.clear();
+				result.queries++;
+			};
+
+			for (unsigned step = 0; step < s.objects + steps; ++step)
+			{
+				unsigned op = random() % 10;
+				if (step < s.objects || op < 4 || objects.m_Live.empty())
+				{
+					vec3 a(place(random), place(random), place(random));
+					float extent = size(random) * size(random) / s.maxSize;
+					element3 e = { a, vec3(a.x + extent * unit(random), a.y + extent * unit(random), a.z + extent), (void*)next++ };
+
+					uint32_t h = index.insert(e.m_A, e.m_B, e.m_Ptr);
+					if (h < objects.m_Alive.size() && objects.m_Alive[h]) throw exception((string(name) + ": the handle of a live object was reused").c_str());
+					objects.set(h, e);
+				}
+				else if (op < 6)
+				{
+					uint32_t h = objects.m_Live[random() % objects.m_Live.size()];
+					index.remove(h);
+					objects.remove(h);
+				}
+				else
+				{
+					// mostly small steps, sometimes far away or growing
+					uint32_t h = objects.m_Live[random() % objects.m_Live.size()];
+					element3 e = objects.m_Elements[h];
+					vec3 d(unit(random) * 3 - 1.5f, unit(random) * 3 - 1.5f, unit(random) * 3 - 1.5f);
+					if (random() % 20 == 0) d = vec3(place(random) * 3, place(random), place(random));
+					e.m_A = e.m_A + d;
+					e.m_B = e.m_B + d;
+					if (random() % 5 == 0) e.m_B.x += size(random);
+
+					index.move(h, e.m_A, e.m_B);
+					objects.set(h, e);
+				}
+
+				if (index.size() != objects.m_Live.size()) throw exception((string(name) + ": size differs from the number of objects").c_str());
+				if (step < s.objects || step % 25) continue;
+
+				for (int q = 0; q < 10; ++q)
+				{
+					vec3 a(place(random), place(random), place(random));
+					vec3 b = a + vec3(size(random) * 3, size(random) * 3, size(random) * 3);
+					float radius = size(random) * 2;
+
+					ray r = { a, vec3(place(random), place(random), place(random)) };
+					if (random() % 4 == 0) r.p1 = vec3(a.x, a.y, place(random));   // parallel to two axes
+					segment3 segment(r);
+
+					mat4 viewProjection;
+					viewProjection.identity();
+					viewProjection.perspective(60, 1.3f, 0.5f, s.world * (0.2f + unit(random)));
+					viewProjection.lookat(a, vec3(place(random), place(random), place(random)), vec3(0, 0, 1));
+					frustum f(viewProjection);
+
+					auto start = clock::now();
+					index.visit(a, b, [&](const element3 &e) { got.push_back(e.m_Ptr); });
+					auto end = clock::now();
+					objects.scan([&](const element3 &e) { return boxesOverlap(e.m_A, e.m_B, a, b); }, expected);
+					indexTime += end - start;
+					scanTime += clock::now() - end;
+					compare("box");
+
+					start = clock::now();
+					index.visitSphere(a, radius, [&](const element3 &e) { got.push_back(e.m_Ptr); });
+					end = clock::now();
+					objects.scan([&](const element3 &e) { return boxSphereOverlap(e.m_A, e.m_B, a, radius); }, expected);
+					indexTime += end - start;
+					scanTime += clock::now() - end;
+					compare("sphere");
+
+					bool entries = true;
+					start = clock::now();
+					index.visitRay(r, [&](const element3 &e, float t)
+					{
+						got.push_back(e.m_Ptr);
+						entries &= t == segment.entry(e.m_A, e.m_B);
+					});
+					end = clock::now();
+					objects.scan([&](const element3 &e) { return segment.entry(e.m_A, e.m_B) >= 0; }, expected);
+					indexTime += end - start;
+					scanTime += clock::now() - end;
+					if (!entries) throw exception((string(name) + ": ray query reported a wrong entry").c_str());
+					compare("ray");
+
+					start = clock::now();
+					index.visitFrustum(f, [&](const element3 &e) { got.push_back(e.m_Ptr); });
+					end = clock::now();
+					objects.scan([&](const element3 &e) { return f.intersects(e.m_A, e.m_B); }, expected);
+					indexTime += end - start;
+					scanTime += clock::now() - end;
+					compare("frustum");
+				}
+			}
+
+			result.objects = objects.m_Live.size();
+			result.index_ms = seconds(clock::time_point(), clock::time_point(indexTime)) * 1000;
+			result.scan_ms = seconds(clock::time_point(), clock::time_point(scanTime)) * 1000;
+			report.indices.push_back(result);
+		}
+	}
+
+	void spatial3_check_report::print(ostream &out) const
+	{
+		out << steps << " steps of insert, remove and move per index\n";
+		for (const index_result &r : indices)
+			out << r.name << ": " << r.objects << " objects, " << r.queries << " queries, " << r.index_ms << " ms, scan " << r.scan_ms << " ms\n";
+	}
+
+	spatial3_check_report run_spatial3_check(unsigned steps, unsigned seed)
+	{
+		spatial3_check_report report;
+		report.steps = steps;
+
+		mt19937 random(seed);
+
+		// cells of about the object size, then smaller than most objects
+		hash_grid3 grid(4, 256);
+		check("hash_grid3", grid, { 40, 6, 0 }, steps, random, report);
+		hash_grid3 fine(1, 64);
+		check("hash_grid3 fine", fine, { 20, 3, 0 }, steps, random, report);
+
+		// a root that has to grow and far moves beyond its largest size, then tiny objects in a large world
+		loose_octree octree(vec3(0, 0, 0), 8, 6, 64);
+		check("loose_octree growing", octree, { 60, 40, 0 }, steps, random, report);
+		loose_octree wide;
+		check("loose_octree", wide, { 200, 1, 0 }, steps, random, report);
+
+		// enough objects for the queries to beat the scan, cells of about their spacing
+		loose_octree dense(vec3(0, 0, 0), 256, 4);
+		check("loose_octree dense", dense, { 200, 1, 20000 }, steps, random, report);
+
+		// a box that is not finite never fits the root
+		bool rejected = false;
+		try
+		{
+			wide.insert(vec3(NAN, 0, 0), vec3(1, 1, 1), nullptr);
+		}
+		catch (const exception &)
+		{
+			rejected = true;
+		}
+		if (!rejected) throw exception("loose_octree: a box that is not finite was accepted");
+
+		return report;
+	}
+}
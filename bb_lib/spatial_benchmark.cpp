@@ -0,0 +1,243 @@
+#include "spatial_grid.h"
+#include "spatial_hash_map.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace bb
+{
+	using namespace std;
+
+	namespace
+	{
+		typedef chrono::steady_clock clock;
+
+		double ms(clock::time_point a, clock::time_point b)
+		{
+			return chrono::duration<double, milli>(b - a).count();
+		}
+
+		// cells of 16 by 16 with about 4 units each, half of the units are boxes that can cover more than one cell
+		struct unit_field
+		{
+			unsigned     resolution;
+			float        world;
+			vector<vec2> lo;
+			vector<vec2> hi;
+		};
+
+		unit_field make_units(unsigned units)
+		{
+			const float cell = 16;
+
+			unit_field f;
+			f.resolution = std::max(1u, (unsigned)sqrtf(units / 4.0f));
+			f.world = f.resolution * cell;
+
+			mt19937 random(1);
+			uniform_real_distribution<float> place(0, f.world);
+			uniform_real_distribution<float> extent(0, cell);
+
+			f.lo.resize(units);
+			f.hi.resize(units);
+			for (unsigned i = 0; i < units; ++i)
+			{
+				f.lo[i] = vec2(place(random), place(random));
+				f.hi[i] = f.lo[i];
+				if (i & 1) f.hi[i] = f.lo[i] + vec2(extent(random), extent(random));
+			}
+			return f;
+		}
+
+		bool same(const spatial_hash_map::element &a, const spatial_hash_map::element &b)
+		{
+			return a.m_A == b.m_A && a.m_B == b.m_B && a.m_Ptr == b.m_Ptr;
+		}
+
+		bool same(const vector<spatial_hash_map::element> &a, const vector<spatial_hash_map::element> &b)
+		{
+			return a.size() == b.size() && equal(a.begin(), a.end(), b.begin(), [](const spatial_hash_map::element &x, const spatial_hash_map::element &y) { return same(x, y); });
+		}
+	}
+
+	void spatial_benchmark_report::print(ostream &out) const
+	{
+		out << units << " units\n";
+		out << "spatial_hash_map: build " << hash_map_build_ms << " ms, query " << hash_map_query_ms << " ms\n";
+		out << "spatial_grid:     build " << grid_build_ms << " ms, query " << grid_query_ms << " ms\n";
+	}
+
+	spatial_benchmark_report run_spatial_benchmark(unsigned units, float radius)
+	{
+		spatial_benchmark_report report;
+		report.units = units;
+
+		unit_field field = make_units(units);
+		const vector<vec2> &lo = field.lo, &hi = field.hi;
+		vec2 a(0, 0), b(field.world, field.world);
+		unsigned resolution = field.resolution;
+
+		vec2 r(radius, radius);
+		const int frames = 4;
+
+		// the old map reports a unit once per shared cell, callers have to filter duplicates themselves
+		spatial_hash_map map(a, b, resolution);
+		vector<unsigned> seen(units, 0);
+		uint64_t mapSum = 0;
+		unsigned query = 0;
+
+		for (int f = 0; f < frames; ++f)
+		{
+			auto start = clock::now();
+			map.clear();
+			for (unsigned i = 0; i < units; ++i)
+				map.add(lo[i], hi[i], (void*)(uintptr_t)i);
+			auto built = clock::now();
+
+			for (unsigned i = 0; i < units; ++i)
+			{
+				++query;
+				map.visit(lo[i] - r, lo[i] + r, [&](spatial_hash_map::element e)
+				{
+					unsigned id = (unsigned)(uintptr_t)e.m_Ptr;
+					if (seen[id] == query) return;
+					seen[id] = query;
+					mapSum += id + 1;
+				});
+			}
+			auto queried = clock::now();
+
+			report.hash_map_build_ms += ms(start, built) / frames;
+			report.hash_map_query_ms += ms(built, queried) / frames;
+		}
+
+		spatial_grid<unsigned> grid(a, b, resolution);
+		uint64_t gridSum = 0;
+
+		for (int f = 0; f < frames; ++f)
+		{
+			auto start = clock::now();
+			grid.clear();
+			for (unsigned i = 0; i < units; ++i)
+				grid.add(lo[i], hi[i], i);
+			grid.build();
+			auto built = clock::now();
+
+			for (unsigned i = 0; i < units; ++i)
+				grid.visit(lo[i] - r, lo[i] + r, [&](const spatial_grid<unsigned>::element &e) { gridSum += e.m_Value + 1; });
+			auto queried = clock::now();
+
+			report.grid_build_ms += ms(start, built) / frames;
+			report.grid_query_ms += ms(built, queried) / frames;
+		}
+
+		if (mapSum != gridSum)
+			throw exception("spatial_grid found other units than spatial_hash_map");
+
+		return report;
+	}
+
+	void spatial_scaling_report::print(ostream &out) const
+	{
+		out << units << " units, serial add " << add_ms << " ms\n";
+		for (const auto &r : rows)
+			out << r.threads << " threads: build " << r.build_ms << " ms, query " << r.query_ms << " ms, nearest " << r.nearest_ms << " ms\n";
+	}
+
+	spatial_scaling_report run_spatial_scaling_benchmark(unsigned units, unsigned maxThreads, float radius)
+	{
+		spatial_scaling_report report;
+		report.units = units;
+
+		unit_field field = make_units(units);
+		vec2 a(0, 0), b(field.world, field.world);
+		vec2 r(radius, radius);
+		const int frames = 4;
+
+		vector<spatial_hash_map::element> elements(units);
+		vector<spatial_hash_map::range> ranges(units);
+		for (unsigned i = 0; i < units; ++i)
+		{
+			elements[i] = { field.lo[i], field.hi[i], (void*)(uintptr_t)(i + 1) };
+			ranges[i] = { field.lo[i] - r, field.lo[i] + r };
+		}
+
+		mt19937 random(2);
+		uniform_real_distribution<float> place(0, field.world);
+		vector<vec2> points(units);
+		for (auto &p : points)
+			p = vec2(place(random), place(random));
+
+		// the reference is built with add() and answered on one thread
+		spatial_hash_map serial(a, b, field.resolution);
+		for (int f = 0; f < frames; ++f)
+		{
+			auto start = clock::now();
+			serial.clear();
+			for (const auto &e : elements)
+				serial.add(e.m_A, e.m_B, e.m_Ptr);
+			report.add_ms += ms(start, clock::now()) / frames;
+		}
+
+		spatial_hash_map::query_result expected;
+		serial.query(ranges, expected, 1);
+
+		// every query has to find each overlapping unit that visit() finds, once
+		for (unsigned i = 0; i < units; ++i)
+		{
+			vector<void*> found;
+			serial.visit(ranges[i].m_A, ranges[i].m_B, [&](spatial_hash_map::element e)
+			{
+				if (e.m_B.x >= ranges[i].m_A.x && e.m_A.x <= ranges[i].m_B.x && e.m_B.y >= ranges[i].m_A.y && e.m_A.y <= ranges[i].m_B.y)
+					found.push_back(e.m_Ptr);
+			});
+			sort(found.begin(), found.end());
+			found.erase(unique(found.begin(), found.end()), found.end());
+
+			vector<void*> batch;
+			for (unsigned j = expected.m_Start[i]; j < expected.m_Start[i + 1]; ++j)
+				batch.push_back(expected.m_Elements[j].m_Ptr);
+			sort(batch.begin(), batch.end());
+
+			if (found != batch)
+				throw exception("spatial_hash_map::query differs from visit");
+		}
+
+		vector<spatial_hash_map::element> expectedNearest;
+		serial.nearest(points, field.world, expectedNearest, 1);
+
+		spatial_hash_map map(a, b, field.resolution);
+		spatial_hash_map::query_result result;
+		vector<spatial_hash_map::element> nearest;
+
+		for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+		{
+			spatial_scaling_report::row row = { threads, 0, 0, 0 };
+
+			for (int f = 0; f < frames; ++f)
+			{
+				auto start = clock::now();
+				map.build(elements, threads);
+				auto built = clock::now();
+				map.query(ranges, result, threads);
+				auto queried = clock::now();
+				map.nearest(points, field.world, nearest, threads);
+				auto found = clock::now();
+
+				row.build_ms += ms(start, built) / frames;
+				row.query_ms += ms(built, queried) / frames;
+				row.nearest_ms += ms(queried, found) / frames;
+			}
+
+			if (result.m_Start != expected.m_Start || !same(result.m_Elements, expected.m_Elements))
+				throw exception("spatial_hash_map::query depends on the number of threads");
+			if (!same(nearest, expectedNearest))
+				throw exception("spatial_hash_map::nearest depends on the number of threads");
+
+			report.rows.push_back(row);
+		}
+
+		return report;
+	}
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "vec2.h"
+
+namespace bb
+{
+	/*
+	 * Uniform grid over a fixed rectangle like spatial_hash_map, for typed payloads and inlined visitors.
+	 * Elements are collected with add() and bucketed by build(): a counting sort by cell copies the elements
+	 *  of all cells into one contiguous array (CSR layout), so the grid is rebuilt per frame without per-bucket
+	 *  allocations and a query walks memory in order. visit() reports an element that covers several cells once.
+	 */
+	template <typename T>
+	class spatial_grid
+	{
+	public:
+		struct element
+		{
+			vec2 m_A;
+			vec2 m_B;
+			T    m_Value;
+		};
+
+		spatial_grid()
+			: m_Origin(0, 0)
+			, m_Size(0, 0)
+			, m_Resolution(0) { }
+
+		spatial_grid(vec2 a, vec2 b, unsigned resolution)
+		{
+			resize(a, b, resolution);
+		}
+
+		void resize(vec2 a, vec2 b, unsigned resolution)
+		{
+			m_Origin = a;
+			m_Size = b - a;
+			m_Resolution = resolution;
+			clear();
+		}
+
+		// drops all elements
+		void clear()
+		{
+			m_Added.clear();
+			m_CellStart.assign(m_Resolution * m_Resolution + 1, 0);
+			m_CellItems.clear();
+		}
+
+		// visible to visit() after the next build()
+		void add(vec2 a, vec2 b, const T& value)
+		{
+			cell_range r = range(a, b);
+			if (r.loX > r.hiX || r.loY > r.hiY) return;
+
+			m_Added.push_back({ { a, b, value }, r });
+		}
+
+		void build()
+		{
+			// count, prefix sum, scatter
+			m_CellStart.assign(m_Resolution * m_Resolution + 1, 0);
+			for (const auto& e : m_Added)
+			{
+				for (unsigned y = e.m_Cells.loY; y <= e.m_Cells.hiY; ++y)
+					for (unsigned x = e.m_Cells.loX; x <= e.m_Cells.hiX; ++x)
+						m_CellStart[x + y * m_Resolution + 1]++;
+			}
+
+			for (size_t i = 1; i < m_CellStart.size(); ++i)
+				m_CellStart[i] += m_CellStart[i - 1];
+
+			m_CellItems.resize(m_CellStart.back());
+			m_Fill.assign(m_CellStart.begin(), m_CellStart.end() - 1);
+
+			for (const auto& e : m_Added)
+			{
+				for (unsigned y = e.m_Cells.loY; y <= e.m_Cells.hiY; ++y)
+					for (unsigned x = e.m_Cells.loX; x <= e.m_Cells.hiX; ++x)
+						m_CellItems[m_Fill[x + y * m_Resolution]++] = { e.m_Element, e.m_Cells.loX, e.m_Cells.loY };
+			}
+		}
+
+		// elements in the cells the rectangle touches, each once, in order of addition within a cell
+		template <typename Visitor>
+		void visit(vec2 a, vec2 b, Visitor&& visitor) const
+		{
+			cell_range q = range(a, b);
+
+			for (unsigned y = q.loY; y <= q.hiY; ++y)
+			{
+				for (unsigned x = q.loX; x <= q.hiX; ++x)
+				{
+					unsigned cell = x + y * m_Resolution;
+					for (uint32_t i = m_CellStart[cell]; i < m_CellStart[cell + 1]; ++i)
+					{
+						const item& it = m_CellItems[i];
+
+						// an element is reported in the first cell where it overlaps the query
+						if (x == std::max(it.m_LoX, q.loX) && y == std::max(it.m_LoY, q.loY))
+							visitor(it.m_Element);
+					}
+				}
+			}
+		}
+
+		size_t size() const { return m_Added.size(); }
+
+	private:
+		struct cell_range
+		{
+			unsigned loX, loY, hiX, hiY;
+		};
+
+		struct added
+		{
+			element    m_Element;
+			cell_range m_Cells;
+		};
+
+		struct item
+		{
+			element  m_Element;
+			unsigned m_LoX;   // first cell of the element, for deduplication
+			unsigned m_LoY;
+		};
+
+		// cells covered by a rectangle, clamped to the grid, empty (lo > hi) when outside
+		cell_range range(vec2 a, vec2 b) const
+		{
+			int loX = (int)(((a.x - m_Origin.x) / m_Size.x) * m_Resolution);
+			int loY = (int)(((a.y - m_Origin.y) / m_Size.y) * m_Resolution);
+			int hiX = (int)(((b.x - m_Origin.x) / m_Size.x) * m_Resolution);
+			int hiY = (int)(((b.y - m_Origin.y) / m_Size.y) * m_Resolution);
+
+			int last = (int)m_Resolution - 1;
+			if (hiX < 0 || hiY < 0 || loX > last || loY > last || m_Resolution == 0)
+				return { 1, 1, 0, 0 };
+
+			return { (unsigned)std::max(loX, 0), (unsigned)std::max(loY, 0), (unsigned)std::min(hiX, last), (unsigned)std::min(hiY, last) };
+		}
+
+		vec2     m_Origin;
+		vec2     m_Size;
+		unsigned m_Resolution;
+
+		std::vector<added>    m_Added;       // since the last clear()
+		std::vector<uint32_t> m_CellStart;   // per cell, first entry in m_CellItems, one more at the end
+		std::vector<uint32_t> m_Fill;        // scratch for build()
+		std::vector<item>     m_CellItems;   // elements grouped by cell, copied into every cell they cover
+	};
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Random units in a square world, rebuilt and queried around every unit with spatial_hash_map and spatial_grid.
+	// Throws when both do not find the same units.
+	struct spatial_benchmark_report
+	{
+		unsigned units = 0;
+		double hash_map_build_ms = 0;
+		double hash_map_query_ms = 0;
+		double grid_build_ms = 0;
+		double grid_query_ms = 0;
+
+		void print(std::ostream &out) const;
+	};
+
+	spatial_benchmark_report run_spatial_benchmark(unsigned units = 10000, float radius = 20);
+}
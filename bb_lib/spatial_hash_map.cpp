@@ -1,5 +1,9 @@
 #include "spatial_hash_map.h"
 
+#include <algorithm>
+#include <limits>
+#include <thread>
+
 namespace bb
 {
 	spatial_hash_map::spatial_hash_map()
@@ -9,6 +13,9 @@ namespace bb
 	{ }
 
 	spatial_hash_map::spatial_hash_map(vec2 a, vec2 b, unsigned resolution)
+		: m_Origin(0, 0)
+		, m_Size(0, 0)
+		, m_Resolution(0)
 	{
 		resize(a, b, resolution);
 	}
@@ -91,4 +98,224 @@ namespace bb
 			}
 		}
 	}
+
+	void spatial_hash_map::cells(vec2 a, vec2 b, int &loX, int &loY, int &hiX, int &hiY) const
+	{
+		loX = std::max((int)(((a.x - m_Origin.x) / m_Size.x) * m_Resolution), 0);
+		loY = std::max((int)(((a.y - m_Origin.y) / m_Size.y) * m_Resolution), 0);
+		hiX = std::min((int)(((b.x - m_Origin.x) / m_Size.x) * m_Resolution), (int)m_Resolution - 1);
+		hiY = std::min((int)(((b.y - m_Origin.y) / m_Size.y) * m_Resolution), (int)m_Resolution - 1);
+	}
+
+	namespace
+	{
+		// fn(chunk, begin, end) for threads consecutive chunks of [0, count), the first one on the calling thread
+		template <typename Fn>
+		void parallel_chunks(unsigned threads, size_t count, Fn fn)
+		{
+			std::vector<std::thread> workers;
+			for (unsigned t = 1; t < threads; ++t)
+				workers.emplace_back(fn, t, count * t / threads, count * (t + 1) / threads);
+
+			fn(0u, (size_t)0, count / threads);
+
+			for (auto &w : workers)
+				w.join();
+		}
+	}
+
+	void spatial_hash_map::build(const std::vector<element> &elements, unsigned threads)
+	{
+		threads = std::max(threads, 1u);
+		size_t cellCount = m_Grid.size();
+		m_ClearCounter++;
+
+		// first pass, the number of elements every chunk puts in every cell
+		std::vector<std::vector<unsigned>> offsets(threads, std::vector<unsigned>(cellCount, 0));
+		parallel_chunks(threads, elements.size(), [&](unsigned t, size_t begin, size_t end)
+		{
+			auto &count = offsets[t];
+			for (size_t i = begin; i < end; ++i)
+			{
+				int loX, loY, hiX, hiY;
+				cells(elements[i].m_A, elements[i].m_B, loX, loY, hiX, hiY);
+
+				for (int yy = loY; yy <= hiY; ++yy)
+					for (int xx = loX; xx <= hiX; ++xx)
+						count[xx + yy * m_Resolution]++;
+			}
+		});
+
+		// a bucket gets the elements of the chunks one after the other, so its order is the order of elements
+		parallel_chunks(threads, cellCount, [&](unsigned, size_t begin, size_t end)
+		{
+			for (size_t c = begin; c < end; ++c)
+			{
+				unsigned total = 0;
+				for (auto &count : offsets)
+				{
+					unsigned n = count[c];
+					count[c] = total;
+					total += n;
+				}
+
+				auto &bucket = m_Grid[c];
+				bucket.m_ClearCounter = m_ClearCounter;
+				bucket.m_Elements.resize(total);
+			}
+		});
+
+		// second pass, every chunk writes to its own slots
+		parallel_chunks(threads, elements.size(), [&](unsigned t, size_t begin, size_t end)
+		{
+			auto &offset = offsets[t];
+			for (size_t i = begin; i < end; ++i)
+			{
+				int loX, loY, hiX, hiY;
+				cells(elements[i].m_A, elements[i].m_B, loX, loY, hiX, hiY);
+
+				for (int yy = loY; yy <= hiY; ++yy)
+				{
+					for (int xx = loX; xx <= hiX; ++xx)
+					{
+						unsigned c = xx + yy * m_Resolution;
+						m_Grid[c].m_Elements[offset[c]++] = elements[i];
+					}
+				}
+			}
+		});
+	}
+
+	void spatial_hash_map::query(const std::vector<range> &ranges, query_result &result, unsigned threads) const
+	{
+		threads = std::max(threads, 1u);
+		result.m_Start.assign(ranges.size() + 1, 0);
+		result.m_Chunks.resize(threads);
+
+		parallel_chunks(threads, ranges.size(), [&](unsigned t, size_t begin, size_t end)
+		{
+			auto &out = result.m_Chunks[t];
+			out.clear();
+
+			for (size_t i = begin; i < end; ++i)
+			{
+				const range &r = ranges[i];
+				size_t first = out.size();
+
+				int loX, loY, hiX, hiY;
+				cells(r.m_A, r.m_B, loX, loY, hiX, hiY);
+
+				for (int xx = loX; xx <= hiX; ++xx)
+				{
+					for (int yy = loY; yy <= hiY; ++yy)
+					{
+						auto &bucket = m_Grid[xx + yy * m_Resolution];
+						if (bucket.m_ClearCounter != m_ClearCounter) continue;
+
+						for (const auto &e : bucket.m_Elements)
+						{
+							if (e.m_B.x < r.m_A.x || e.m_A.x > r.m_B.x || e.m_B.y < r.m_A.y || e.m_A.y > r.m_B.y) continue;
+
+							// an element is reported in the first cell where it overlaps the range
+							if ((xx == loX || (int)(((e.m_A.x - m_Origin.x) / m_Size.x) * m_Resolution) >= xx) &&
+								(yy == loY || (int)(((e.m_A.y - m_Origin.y) / m_Size.y) * m_Resolution) >= yy))
+								out.push_back(e);
+						}
+					}
+				}
+
+				result.m_Start[i + 1] = (unsigned)(out.size() - first);
+			}
+		});
+
+		for (size_t i = 0; i < ranges.size(); ++i)
+			result.m_Start[i + 1] += result.m_Start[i];
+
+		result.m_Elements.clear();
+		result.m_Elements.reserve(result.m_Start.back());
+		for (size_t t = 0; t < threads; ++t)
+			result.m_Elements.insert(result.m_Elements.end(), result.m_Chunks[t].begin(), result.m_Chunks[t].end());
+	}
+
+	void spatial_hash_map::nearest(const std::vector<vec2> &points, float maxDistance, std::vector<element> &result, unsigned threads) const
+	{
+		threads = std::max(threads, 1u);
+		result.assign(points.size(), element{ vec2(0, 0), vec2(0, 0), nullptr });
+		if (m_Resolution == 0) return;
+
+		const int last = (int)m_Resolution - 1;
+		const float cellX = m_Size.x / m_Resolution;
+		const float cellY = m_Size.y / m_Resolution;
+		// finite, so that an unbounded search still finds the elements at the far side of the grid
+		const float limit = std::min(maxDistance * maxDistance, std::numeric_limits<float>::max());
+
+		auto cell = [last](float f)
+		{
+			return f < 0 ? 0 : f >= last ? last : (int)f;
+		};
+
+		parallel_chunks(threads, points.size(), [&](unsigned, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				vec2 p = points[i];
+				int cx = cell(((p.x - m_Origin.x) / m_Size.x) * m_Resolution);
+				int cy = cell(((p.y - m_Origin.y) / m_Size.y) * m_Resolution);
+
+				const element *best = nullptr;
+				float best2 = limit;
+
+				// the first of equally close elements wins
+				auto visitCell = [&](int xx, int yy)
+				{
+					auto &bucket = m_Grid[xx + yy * m_Resolution];
+					if (bucket.m_ClearCounter != m_ClearCounter) return;
+
+					for (const auto &e : bucket.m_Elements)
+					{
+						float dx = std::max(std::max(e.m_A.x - p.x, p.x - e.m_B.x), 0.0f);
+						float dy = std::max(std::max(e.m_A.y - p.y, p.y - e.m_B.y), 0.0f);
+						float d2 = dx * dx + dy * dy;
+						if (best ? d2 < best2 : d2 <= best2)
+						{
+							best = &e;
+							best2 = d2;
+						}
+					}
+				};
+
+				// rings of cells around the cell of p
+				for (int r = 0;; ++r)
+				{
+					for (int yy = std::max(cy - r, 0); yy <= std::min(cy + r, last); ++yy)
+					{
+						if (yy == cy - r || yy == cy + r)
+						{
+							for (int xx = std::max(cx - r, 0); xx <= std::min(cx + r, last); ++xx)
+								visitCell(xx, yy);
+						}
+						else
+						{
+							if (cx - r >= 0)    visitCell(cx - r, yy);
+							if (cx + r <= last) visitCell(cx + r, yy);
+						}
+					}
+
+					// all cells are seen once the rings reach every edge of the grid
+					if (cx - r <= 0 && cx + r >= last && cy - r <= 0 && cy + r >= last) break;
+
+					// anything not seen yet lies beyond one of the sides of the rings that are not at the grid's edge
+					float bound = std::numeric_limits<float>::infinity();
+					if (cx - r > 0)    bound = std::min(bound, std::max(p.x - (m_Origin.x + (cx - r) * cellX), 0.0f));
+					if (cx + r < last) bound = std::min(bound, std::max(m_Origin.x + (cx + r + 1) * cellX - p.x, 0.0f));
+					if (cy - r > 0)    bound = std::min(bound, std::max(p.y - (m_Origin.y + (cy - r) * cellY), 0.0f));
+					if (cy + r < last) bound = std::min(bound, std::max(m_Origin.y + (cy + r + 1) * cellY - p.y, 0.0f));
+
+					if (bound * bound > best2) break;
+				}
+
+				if (best) result[i] = *best;
+			}
+		});
+	}
 }
\ No newline at end of file
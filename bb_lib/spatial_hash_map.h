@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <ostream>
 #include <vector>
 
 #include "vec2.h"
@@ -20,11 +21,38 @@ namespace bb
 			void* m_Ptr;
 		};
 
+		struct range
+		{
+			vec2 m_A;
+			vec2 m_B;
+		};
+
+		// per query, the elements of query i are m_Elements[m_Start[i]] up to m_Elements[m_Start[i + 1]].
+		// Pass the same result every frame to reuse its memory.
+		struct query_result
+		{
+			std::vector<unsigned> m_Start;
+			std::vector<element>  m_Elements;
+
+			std::vector<std::vector<element>> m_Chunks;   // per thread
+		};
+
 		void clear();
 		void resize(vec2 a, vec2 b, unsigned resolution);
 		void add(vec2 a, vec2 b, void* user);
 		void visit(vec2 a, vec2 b, std::function<void(element)> visitor) const;
 
+		// Batch versions split the work over threads. The results are the same for any number of threads.
+
+		// replaces the contents, same as clear() followed by add() of every element in order
+		void build(const std::vector<element> &elements, unsigned threads = 1);
+
+		// the elements overlapping each range, each once, in cell order
+		void query(const std::vector<range> &ranges, query_result &result, unsigned threads = 1) const;
+
+		// the closest element to each point, measured to its box, m_Ptr is nullptr when none is within maxDistance
+		void nearest(const std::vector<vec2> &points, float maxDistance, std::vector<element> &result, unsigned threads = 1) const;
+
 	private:
 		vec2 m_Origin;
 		vec2 m_Size;
@@ -32,6 +60,9 @@ namespace bb
 
 		unsigned m_ClearCounter = 0;
 
+		// cells covered by a rectangle, clamped to the grid, empty (lo > hi) when outside
+		void cells(vec2 a, vec2 b, int &loX, int &loY, int &hiX, int &hiY) const;
+
 		struct bucket
 		{
 			void check(unsigned clearCounter);
@@ -42,4 +73,27 @@ namespace bb
 
 		std::vector<bucket> m_Grid;
 	};
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Random units built and queried with 1 to maxThreads threads: a batch build, a range query around every unit
+	//  and a nearest neighbour query from random points. Throws when a thread count gives other results than add()
+	//  with visit() or than a single thread.
+	struct spatial_scaling_report
+	{
+		struct row
+		{
+			unsigned threads;
+			double   build_ms;
+			double   query_ms;
+			double   nearest_ms;
+		};
+
+		unsigned         units = 0;
+		double           add_ms = 0;   // serial add() of all units
+		std::vector<row> rows;
+
+		void print(std::ostream &out) const;
+	};
+
+	spatial_scaling_report run_spatial_scaling_benchmark(unsigned units = 10000, unsigned maxThreads = 16, float radius = 20);
 }
\ No newline at end of file
@@ -1,7 +1,10 @@
 #include "store.h"
+#include "store_document.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
-#include <cctype>
 #include <vector>
 
 namespace bb
@@ -22,161 +25,110 @@ namespace bb
 
 	void store::load(const fs::path &fromFile)
 	{
-		ifstream fin(fromFile);
-		load(fin);
+		store_document document(fromFile);
+		document.root().copy_to(*this);
 	}
-
-	vector<store::val> loadList(istream &s);
-	std::string takeLiteral(istream &s)
+	void store::load(istream &fromStream)
 	{
-		std::string result;
-
-		while (!s.eof())
-		{
-			int peeked = s.peek();
-
-			if (peeked == '[' ||
-				peeked == ']' ||
-				peeked == '{' ||
-				peeked == '}' ||
-				std::isspace(peeked)) return result;
-
-			result += s.get();
-		}
-
-		return result;
+		store_document document(fromStream);
+		document.root().copy_to(*this);
 	}
-	store::val parseval(istream &s)
+	namespace
 	{
-		char next = s.peek();
-
-		if (next == '\"')
+		void indent(ostream &s, int depth)
 		{
-			s.ignore();
-
-			char buf[1024];
-			s.getline(buf, 1024, '\"');
-
-			return string(buf);
-		}
-		else if (next == '{')
-		{
-			s.ignore();
-			return store(s);
+			for (int i = 0; i < depth; ++i) s << '\t';
 		}
-		else if (next == '[')
-		{
-			s.ignore();
-			return loadList(s);
-		}
-		else if (next == '#')
-		{
-			s.ignore();
-			std::string lit = takeLiteral(s);
-			char *p;
-			int64_t i = strtoll(lit.c_str(), &p, 16);
 
-			if (*p) throw exception("malformed hex literal");
+		void save_data(ostream &s, const store &d, int depth);
 
-			return i;
-		}
-		else if (next == '$')
+		void save_value(ostream &s, const store::val &v, int depth)
 		{
-			s.ignore();
-			char numbuf[20];
-			memset(numbuf, 0, 20);
-			s.getline(numbuf, 20, '$');
-
-			if (numbuf[19]) throw exception("malformed binary section");
-
-			char *p;
-			size_t size = strtol(numbuf, &p, 10);
-			if (*p)
+			switch (v.type())
 			{
-				throw exception("malformed binary section");
-			}
-			
-			std::vector<char> b;
-			b.resize(size);
-
-			s.read(b.data(), size);
-
-			return b;
-		}
-		else
-		{
-			std::string lit = takeLiteral(s);
-
-			char* p;
-			int64_t i = strtoll(lit.c_str(), &p, 10);
-			if (*p)
+			case store::val::Float:
 			{
-				float f = strtof(lit.c_str(), &p);
-				if (*p) throw exception("malformed number literal");
-
-				return f;
+				// must not read back as an Int
+				char buf[32];
+				snprintf(buf, sizeof(buf), "%.9g", v.f());
+				s << buf;
+				if (!strpbrk(buf, ".eEn")) s << ".0";
+				break;
 			}
-			else
+			case store::val::Int:
 			{
-				return i;
+				s << v.i();
+				break;
 			}
-		}
-	}
-	vector<store::val> loadList(istream &s)
-	{
-		vector<store::val> list;
-		while (!s.eof())
-		{
-			while (std::isspace(s.peek())) s.ignore();
-
-			if (s.peek() == ']')
+			case store::val::String:
 			{
-				s.ignore();
-				return list;
+				// the text format has no escapes
+				string str = v.s();
+				if (str.find('\"') != string::npos) throw exception("error in store: string with quotes can only be saved as binary");
+				s << '\"' << str << '\"';
+				break;
 			}
-
-			if (s.peek() == '}')
+			case store::val::Binary:
 			{
-				throw exception("invalid termination of list");
+				auto &b = v.b();
+				s << '$' << b.size() << '$';
+				s.write(b.data(), b.size());
+				break;
 			}
-
-			list.emplace_back(parseval(s));
-		}
-
-		return list;
-	}
-	void store::load(istream &s)
-	{
-		while (!s.eof())
-		{
-			while (std::isspace(s.peek())) s.ignore();
-
-			if (s.peek() == '}')
+			case store::val::Data:
 			{
-				s.ignore();
-				return;
+				s << "{\n";
+				save_data(s, v.d(), depth + 1);
+				indent(s, depth);
+				s << '}';
+				break;
 			}
-			if (s.peek() == ']')
+			case store::val::List:
 			{
-				s.ignore();
-				throw exception("invalid termination of data");
+				s << '[';
+				for (auto &elem : v.l())
+				{
+					s << ' ';
+					save_value(s, elem, depth);
+				}
+				s << " ]";
+				break;
 			}
+			}
+		}
 
-			string tag = takeLiteral(s);
-
-			while (std::isspace(s.peek())) s.ignore();
+		void save_data(ostream &s, const store &d, int depth)
+		{
+			d.visit([&](const string &key, const store::val &elem)
+			{
+				if (key.empty() || key.find_first_of(" \t\n\r\v\f[]{}") != string::npos) throw exception("error in store: key can only be saved as binary");
 
-			m_Data.emplace(tag, parseval(s));
+				indent(s, depth);
+				s << key << ' ';
+				save_value(s, elem, depth);
+				s << '\n';
+			});
 		}
 	}
+
 	void store::save(const fs::path &toFile)
 	{
-		ofstream fout(toFile);
+		// binary sections are written as they are, no newline translation
+		ofstream fout(toFile, ios::binary);
 		save(fout);
 	}
 	void store::save(ostream &toStream)
 	{
-		//
+		save_data(toStream, *this, 0);
+	}
+	void store::save_binary(const fs::path &toFile)
+	{
+		ofstream fout(toFile, ios::binary);
+		save_binary(fout);
+	}
+	void store::save_binary(ostream &toStream)
+	{
+		store_document::write(*this, toStream);
 	}
 
 	void store::visit(std::function<void(const std::string &key, const val &elem)> visitor) const
@@ -189,112 +141,288 @@ namespace bb
 
 	bool store::exists(const string &key) const
 	{
-		return m_Data.find(key) != m_Data.end();
+		return find(key) != m_Data.end();
+	}
+
+	vector<store::field>::const_iterator store::find(const string &key) const
+	{
+		auto i = lower_bound(m_Data.begin(), m_Data.end(), key, [](const field &f, const string &key) { return f.first < key; });
+		return i != m_Data.end() && i->first == key ? i : m_Data.end();
+	}
+	vector<store::field>::iterator store::find(const string &key)
+	{
+		auto i = lower_bound(m_Data.begin(), m_Data.end(), key, [](const field &f, const string &key) { return f.first < key; });
+		return i != m_Data.end() && i->first == key ? i : m_Data.end();
+	}
+	void store::insert(const string &key, val &&value)
+	{
+		auto i = lower_bound(m_Data.begin(), m_Data.end(), key, [](const field &f, const string &key) { return f.first < key; });
+		if (i == m_Data.end() || i->first != key) m_Data.emplace(i, key, move(value));
+	}
+	void store::merge(vector<field> &&fields)
+	{
+		// one sort and one merge instead of an insertion per field, the first of equal keys wins
+		stable_sort(fields.begin(), fields.end(), [](const field &a, const field &b) { return a.first < b.first; });
+		fields.erase(unique(fields.begin(), fields.end(), [](const field &a, const field &b) { return a.first == b.first; }), fields.end());
+
+		vector<field> merged;
+		merged.reserve(m_Data.size() + fields.size());
+
+		auto a = m_Data.begin();
+		auto b = fields.begin();
+		while (a != m_Data.end() || b != fields.end())
+		{
+			if (b == fields.end() || (a != m_Data.end() && a->first <= b->first))
+			{
+				if (b != fields.end() && a->first == b->first) ++b;
+				merged.push_back(move(*a++));
+			}
+			else
+			{
+				merged.push_back(move(*b++));
+			}
+		}
+
+		m_Data = move(merged);
 	}
 
 	float store::getFieldF(const string &key) const
 	{
-		auto i = m_Data.find(key);
+		auto i = find(key);
 		if (i != m_Data.end())
 		{
-			if (i->second.type != val::Float && i->second.type != val::Int) throw exception("error in store: expected different type");
-			return i->second.f;
+			if (i->second.type() != val::Float && i->second.type() != val::Int) throw exception("error in store: expected different type");
+			return i->second.f();
 		}
 		else throw exception("error in store: expected field not found");
 	}
 	int64_t store::getFieldI(const string &key) const
 	{
-		auto i = m_Data.find(key);
+		auto i = find(key);
 		if (i != m_Data.end())
 		{
-			if (i->second.type != val::Float && i->second.type != val::Int) throw exception("error in store: expected different type");
-			return i->second.i;
+			if (i->second.type() != val::Float && i->second.type() != val::Int) throw exception("error in store: expected different type");
+			return i->second.i();
 		}
 		else throw exception("error in store: expected field not found");
 	}
 	string store::getFieldS(const string &key) const
 	{
-		auto i = m_Data.find(key);
+		auto i = find(key);
 		if (i != m_Data.end())
 		{
-			if (i->second.type != val::String) throw exception("error in store: expected different type");
-			return i->second.s;
+			if (i->second.type() != val::String) throw exception("error in store: expected different type");
+			return i->second.s();
 		}
 		else throw exception("error in store: expected field not found");
 	}
 	const store& store::getFieldD(const string &key) const
 	{
-		auto i = m_Data.find(key);
+		auto i = find(key);
 		if (i != m_Data.end())
 		{
-			if (i->second.type != val::Data) throw exception("error in store: expected different type");
-			return i->second.d;
+			if (i->second.type() != val::Data) throw exception("error in store: expected different type");
+			return i->second.d();
 		}
 		else throw exception("error in store: expected field not found");
 	}
 	const vector<store::val>& store::getFieldL(const string &key) const
 	{
-		auto i = m_Data.find(key);
+		auto i = find(key);
 		if (i != m_Data.end())
 		{
-			if (i->second.type != val::List) throw exception("error in store: expected different type");
-			return i->second.l;
+			if (i->second.type() != val::List) throw exception("error in store: expected different type");
+			return i->second.l();
 		}
 		else throw exception("error in store: expected field not found");
 	}
 	store& store::getFieldD(const string &key)
 	{
-		auto i = m_Data.find(key);
+		auto i = find(key);
 		if (i != m_Data.end())
 		{
-			if (i->second.type != val::Data) throw exception("error in store: expected different type");
-			return i->second.d;
+			if (i->second.type() != val::Data) throw exception("error in store: expected different type");
+			return i->second.d();
 		}
 		else throw exception("error in store: expected field not found");
 	}
 	vector<store::val>& store::getFieldL(const string &key)
 	{
-		auto i = m_Data.find(key);
+		auto i = find(key);
 		if (i != m_Data.end())
 		{
-			if (i->second.type != val::List) throw exception("error in store: expected different type");
-			return i->second.l;
+			if (i->second.type() != val::List) throw exception("error in store: expected different type");
+			return i->second.l();
 		}
 		else throw exception("error in store: expected field not found");
 	}
 	const vector<char>& store::getFieldB(const string &key) const
 	{
-		auto i = m_Data.find(key);
+		auto i = find(key);
 		if (i != m_Data.end())
 		{
-			if (i->second.type != val::Binary) throw exception("error in store: expected different type");
-			return i->second.b;
+			if (i->second.type() != val::Binary) throw exception("error in store: expected different type");
+			return i->second.b();
 		}
 		else throw exception("error in store: expected field not found");
 	}
 
 	void store::setFieldF(const string &key, const float &val)
 	{
-		m_Data.emplace(key, val);
+		insert(key, val);
 	}
 	void store::setFieldI(const string &key, const int64_t &val)
 	{
-		m_Data.emplace(key, val);
+		insert(key, val);
 	}
 	void store::setFieldS(const string &key, const string &val)
 	{
-		m_Data.emplace(key, val);
+		insert(key, val);
 	}
 	void store::setFieldD(const string &key, const store &val)
 	{
-		m_Data.emplace(key, val);
+		insert(key, val);
 	}
 	void store::setFieldL(const string &key, const vector<val> &val)
 	{
-		m_Data.emplace(key, val);
+		insert(key, val);
 	}
 	void store::setFieldB(const string &key, const vector<char> &val)
 	{
-		m_Data.emplace(key, val);
+		insert(key, val);
+	}
+
+	//----------------------------------------------------------------------------------------------------------------
+	// store::val
+	store::val::val(const float &f) : m_type(Float), m_short(0), m_f(f) { }
+	store::val::val(const int64_t &i) : m_type(Int), m_short(0), m_i(i) { }
+	store::val::val(const store &d) : m_type(Data), m_short(0), m_d(new store(d)) { }
+	store::val::val(const vector<val> &l) : m_type(List), m_short(0), m_l(new vector<val>(l)) { }
+	store::val::val(const vector<char> &b) : m_type(Binary), m_short(0), m_b(new vector<char>(b)) { }
+	store::val::val(store &&d) : m_type(Data), m_short(0), m_d(new store(move(d))) { }
+	store::val::val(vector<val> &&l) : m_type(List), m_short(0), m_l(new vector<val>(move(l))) { }
+	store::val::val(vector<char> &&b) : m_type(Binary), m_short(0), m_b(new vector<char>(move(b))) { }
+
+	store::val::val(const string &s)
+		: m_type(String)
+		, m_short(0)
+	{
+		if (s.size() <= short_capacity)
+		{
+			m_short = (uint8_t)s.size();
+			memcpy(m_chars, s.data(), s.size());
+		}
+		else
+		{
+			m_short = 0xff;
+			m_s = new string(s);
+		}
+	}
+
+	store::val::val(const val &copy)
+		: m_type(copy.m_type)
+		, m_short(copy.m_short)
+	{
+		switch (m_type)
+		{
+		case Float:  m_f = copy.m_f; break;
+		case Int:    m_i = copy.m_i; break;
+		case String: if (m_short == 0xff) m_s = new string(*copy.m_s); else memcpy(m_chars, copy.m_chars, m_short); break;
+		case Data:   m_d = new store(*copy.m_d); break;
+		case List:   m_l = new vector<val>(*copy.m_l); break;
+		case Binary: m_b = new vector<char>(*copy.m_b); break;
+		}
+	}
+
+	store::val::val(val &&other)
+		: m_type(other.m_type)
+		, m_short(other.m_short)
+	{
+		// the heap part changes owner, other keeps an inline value so its destructor has nothing to do
+		memcpy(m_chars, other.m_chars, short_capacity);
+		other.m_type = Int;
+	}
+
+	store::val& store::val::operator=(const val &copy)
+	{
+		if (this != &copy)
+		{
+			val tmp(copy);
+			*this = std::move(tmp);
+		}
+		return *this;
+	}
+
+	store::val& store::val::operator=(val &&other)
+	{
+		if (this != &other)
+		{
+			release();
+			m_type = other.m_type;
+			m_short = other.m_short;
+			memcpy(m_chars, other.m_chars, short_capacity);
+			other.m_type = Int;
+		}
+		return *this;
+	}
+
+	store::val::~val()
+	{
+		release();
+	}
+
+	void store::val::release()
+	{
+		switch (m_type)
+		{
+		case String: if (m_short == 0xff) delete m_s; break;
+		case Data:   delete m_d; break;
+		case List:   delete m_l; break;
+		case Binary: delete m_b; break;
+		default:     break;
+		}
+	}
+
+	float store::val::f() const
+	{
+		if (m_type == Float) return m_f;
+		if (m_type == Int) return (float)m_i;
+		throw exception("error in store: expected different type");
+	}
+	int64_t store::val::i() const
+	{
+		if (m_type == Int) return m_i;
+		if (m_type == Float) return (int)m_f;
+		throw exception("error in store: expected different type");
+	}
+	string store::val::s() const
+	{
+		if (m_type != String) throw exception("error in store: expected different type");
+		return m_short == 0xff ? *m_s : string(m_chars, m_short);
+	}
+	const store& store::val::d() const
+	{
+		if (m_type != Data) throw exception("error in store: expected different type");
+		return *m_d;
+	}
+	store& store::val::d()
+	{
+		if (m_type != Data) throw exception("error in store: expected different type");
+		return *m_d;
+	}
+	const vector<store::val>& store::val::l() const
+	{
+		if (m_type != List) throw exception("error in store: expected different type");
+		return *m_l;
+	}
+	vector<store::val>& store::val::l()
+	{
+		if (m_type != List) throw exception("error in store: expected different type");
+		return *m_l;
+	}
+	const vector<char>& store::val::b() const
+	{
+		if (m_type != Binary) throw exception("error in store: expected different type");
+		return *m_b;
 	}
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #pragma once
 
-#include <map>
+#include <cstdint>
+#include <utility>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -22,6 +23,10 @@ namespace bb
 		void load(std::istream &fromStream);
 		void save(const fs::path &toFile);
 		void save(std::ostream &toStream);
+
+		// indexed binary form, load() recognizes it and store_document uses it without parsing
+		void save_binary(const fs::path &toFile);
+		void save_binary(std::ostream &toStream);
 		
 		struct val;
 
@@ -44,39 +49,73 @@ namespace bb
 		void                     setFieldL(const std::string &key, const std::vector<val> &val);
 		void                     setFieldB(const std::string &key, const std::vector<char> &val);
 
+		// adds all fields whose key does not exist yet, like calling setField* for each of them
+		void                     merge(std::vector<std::pair<std::string, val>> &&fields);
+
 	private:
-		std::map<std::string, val> m_Data;
+		using field = std::pair<std::string, val>;
+
+		std::vector<field>::const_iterator find(const std::string &key) const;
+		std::vector<field>::iterator       find(const std::string &key);
+		void                               insert(const std::string &key, val &&value);
+
+		// sorted by key
+		std::vector<field> m_Data;
 	};
 
+	/*
+	 * Tagged union of the store value types, 24 bytes.
+	 * Strings up to short_capacity characters are kept inline, larger strings, stores, lists
+	 *  and binary sections live on the heap.
+	 */
 	struct store::val
 	{
-		enum { Float, Int, String, Data, List, Binary } type;
+		enum type_t : uint8_t { Float, Int, String, Data, List, Binary };
+
+		static const size_t short_capacity = 16;
 
-		float f;
-		int64_t i;
-		std::string s;
-		store d;
-		std::vector<val> l;
-		std::vector<char> b;
+		val(const float &f);
+		val(const int64_t &i);
+		val(const std::string &s);
+		val(const store &d);
+		val(const std::vector<val> &l);
+		val(const std::vector<char> &b);
+		val(store &&d);
+		val(std::vector<val> &&l);
+		val(std::vector<char> &&b);
+
+		val(const val &copy);
+		val(val &&other);
+		val& operator=(const val &copy);
+		val& operator=(val &&other);
+		~val();
+
+		type_t type() const { return m_type; }
+
+		// Float and Int convert into each other
+		float                    f() const;
+		int64_t                  i() const;
+		std::string              s() const;
+		const store&             d() const;
+		store&                   d();
+		const std::vector<val>&  l() const;
+		std::vector<val>&        l();
+		const std::vector<char>& b() const;
+
+	private:
+		void release();
 
-		val(const val &copy)
+		type_t  m_type;
+		uint8_t m_short;   // length of an inline string, 0xff when the string is on the heap
+		union
 		{
-			type = copy.type;
-			switch (type)
-			{
-			case Float:  f = copy.f; i = copy.i; break;
-			case Int:    f = copy.f; i = copy.i; break;
-			case String: s = copy.s; break;
-			case Data:   d = copy.d; break;
-			case List:   l = copy.l; break;
-			case Binary: b = copy.b; break;
-			}
-		}
-		val(const float &f) : type(Float), f(f), i((int)f) { }
-		val(const int64_t &i) : type(Int), i(i), f((float)i) { }
-		val(const std::string &s) : type(String), s(s) { }
-		val(const store &d) : type(Data), d(d) { }
-		val(const std::vector<val> &l) : type(List), l(l) { }
-		val(const std::vector<char> &b) : type(Binary), b(b) { }
+			float              m_f;
+			int64_t            m_i;
+			char               m_chars[short_capacity];
+			std::string*       m_s;
+			store*             m_d;
+			std::vector<val>*  m_l;
+			std::vector<char>* m_b;
+		};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "store_document.h"
+
+#include <chrono>
+#include <string>
+
+namespace bb
+{
+	using namespace std;
+
+	namespace
+	{
+		store make_entry(unsigned i)
+		{
+			store e;
+			e.setFieldI("id", i);
+			e.setFieldF("scale", 0.5f + i * 0.25f);
+			e.setFieldS("name", "entry" + to_string(i));
+			e.setFieldS("description", "a description that does not fit in a short string " + to_string(i));
+
+			store child;
+			child.setFieldI("x", (int64_t)i * 3);
+			child.setFieldF("y", -1.0f / (i + 1));
+
+			vector<store::val> list;
+			list.push_back((int64_t)i);
+			list.push_back(string("item"));
+			list.push_back(child);
+			e.setFieldL("list", list);
+			e.setFieldD("child", child);
+
+			vector<char> bytes(i % 17);
+			for (size_t b = 0; b < bytes.size(); ++b) bytes[b] = (char)(i + b * 31);
+			e.setFieldB("bytes", bytes);
+
+			return e;
+		}
+
+		bool equal(const store &a, const store &b);
+
+		bool equal(const store::val &a, const store::val &b)
+		{
+			if (a.type() != b.type()) return false;
+
+			switch (a.type())
+			{
+			case store::val::Float:  return a.f() == b.f();
+			case store::val::Int:    return a.i() == b.i();
+			case store::val::String: return a.s() == b.s();
+			case store::val::Binary: return a.b() == b.b();
+			case store::val::Data:   return equal(a.d(), b.d());
+			case store::val::List:
+			{
+				if (a.l().size() != b.l().size()) return false;
+				for (size_t i = 0; i < a.l().size(); ++i)
+					if (!equal(a.l()[i], b.l()[i])) return false;
+				return true;
+			}
+			}
+			return false;
+		}
+
+		bool equal(const store &a, const store &b)
+		{
+			vector<pair<string, const store::val*>> fa, fb;
+			a.visit([&](const string &key, const store::val &elem) { fa.emplace_back(key, &elem); });
+			b.visit([&](const string &key, const store::val &elem) { fb.emplace_back(key, &elem); });
+
+			if (fa.size() != fb.size()) return false;
+			for (size_t i = 0; i < fa.size(); ++i)
+				if (fa[i].first != fb[i].first || !equal(*fa[i].second, *fb[i].second)) return false;
+
+			return true;
+		}
+
+		template <typename Fn>
+		double measure(Fn fn)
+		{
+			auto start = chrono::steady_clock::now();
+			fn();
+			return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		}
+	}
+
+	void store_benchmark_report::print(ostream &out) const
+	{
+		out << "text:   " << text_bytes << " bytes, store " << store_text_ms << " ms, document " << document_text_ms << " ms\n";
+		out << "binary: " << binary_bytes << " bytes, store " << store_binary_ms << " ms, document " << document_binary_ms << " ms\n";
+		out << "nested lookups in the binary document: " << lookup_binary_ms << " ms\n";
+	}
+
+	store_benchmark_report run_store_benchmark(const fs::path &directory, unsigned entries)
+	{
+		store_benchmark_report report;
+
+		store source;
+		for (unsigned i = 0; i < entries; ++i)
+			source.setFieldD("entry" + to_string(i), make_entry(i));
+
+		fs::path text = directory / "store_benchmark.txt";
+		fs::path binary = directory / "store_benchmark.bin";
+		source.save(text);
+		source.save_binary(binary);
+		report.text_bytes = (size_t)fs::file_size(text);
+		report.binary_bytes = (size_t)fs::file_size(binary);
+
+		store from_text, from_binary;
+		report.store_text_ms = measure([&] { from_text.load(text); });
+		report.store_binary_ms = measure([&] { from_binary.load(binary); });
+
+		if (!equal(source, from_text)) throw exception("store text round trip failed");
+		if (!equal(source, from_binary)) throw exception("store binary round trip failed");
+
+		report.document_text_ms = measure([&] { store_document document(text); });
+
+		store_document document(binary);
+		report.document_binary_ms = measure([&] { store_document other(binary); });
+
+		int64_t sum = 0;
+		report.lookup_binary_ms = measure([&]
+		{
+			auto root = document.root();
+			for (unsigned i = 0; i < entries; ++i)
+				sum += root.getFieldD("entry" + to_string(i)).getFieldD("child").getFieldI("x");
+		});
+
+		if (sum != (int64_t)entries * (entries - 1) / 2 * 3) throw exception("store binary lookup failed");
+
+		return report;
+	}
+}
@@ -0,0 +1,880 @@
+#include "store_document.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <iterator>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bb
+{
+	using namespace std;
+
+	namespace
+	{
+		// brackets, braces and whitespace end a literal
+		struct char_table
+		{
+			bool separator[256];
+			bool space[256];
+
+			char_table()
+			{
+				for (int c = 0; c < 256; ++c)
+				{
+					space[c] = c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+					separator[c] = space[c] || c == '[' || c == ']' || c == '{' || c == '}';
+				}
+			}
+		};
+
+		const char_table table;
+	}
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Parser. Children of a Data or List are collected on a scratch stack and moved to the document
+	//  in one piece when the Data or List closes, so every Data and List ends up as one contiguous range.
+	class store_document::parser
+	{
+	public:
+		parser(store_document &document)
+			: m_doc(document)
+			, m_cursor(document.m_text)
+			, m_end(document.m_text + document.m_size) { }
+
+		value parse_root()
+		{
+			return parse_data();
+		}
+
+	private:
+		void skip_space()
+		{
+			while (m_cursor < m_end && table.space[(unsigned char)*m_cursor]) ++m_cursor;
+		}
+
+		chars take_literal()
+		{
+			const char* begin = m_cursor;
+			while (m_cursor < m_end && !table.separator[(unsigned char)*m_cursor]) ++m_cursor;
+			return{ begin, (size_t)(m_cursor - begin) };
+		}
+
+		uint32_t intern(const chars& key)
+		{
+			auto it = m_doc.m_key_ids.find(key);
+			if (it != m_doc.m_key_ids.end()) return it->second;
+
+			uint32_t id = (uint32_t)m_doc.m_keys.size();
+			m_doc.m_keys.push_back(key);
+			m_doc.m_key_ids.emplace(key, id);
+			return id;
+		}
+
+		value parse_data()
+		{
+			size_t base = m_fields.size();
+
+			while (m_cursor < m_end)
+			{
+				skip_space();
+				if (m_cursor == m_end) break;
+
+				if (*m_cursor == '}')
+				{
+					++m_cursor;
+					break;
+				}
+				if (*m_cursor == ']')
+				{
+					++m_cursor;
+					throw exception("invalid termination of data");
+				}
+
+				uint32_t key = intern(take_literal());
+				skip_space();
+
+				field f;
+				f.key = key;
+				f.v = parse_value();
+				m_fields.push_back(f);
+			}
+
+			// sorted by key id for lookups, the first of duplicate keys wins like in store::load.
+			// most objects have a handful of fields, an insertion sort beats stable_sort's buffer there
+			auto begin = m_fields.begin() + base;
+			if (m_fields.end() - begin <= 16)
+			{
+				for (auto it = begin + 1; it < m_fields.end(); ++it)
+				{
+					field f = *it;
+					auto hole = it;
+					for (; hole != begin && (hole - 1)->key > f.key; --hole) *hole = *(hole - 1);
+					*hole = f;
+				}
+			}
+			else
+			{
+				stable_sort(begin, m_fields.end(), [](const field& a, const field& b) { return a.key < b.key; });
+			}
+			auto last = unique(begin, m_fields.end(), [](const field& a, const field& b) { return a.key == b.key; });
+
+			value v = make_value(Data, last - (m_fields.begin() + base));
+			v.first = (uint32_t)m_doc.m_fields.size();
+			m_doc.m_fields.insert(m_doc.m_fields.end(), m_fields.begin() + base, last);
+			m_fields.resize(base);
+			return v;
+		}
+
+		value parse_list()
+		{
+			size_t base = m_values.size();
+
+			while (m_cursor < m_end)
+			{
+				skip_space();
+				if (m_cursor == m_end) break;
+
+				if (*m_cursor == ']')
+				{
+					++m_cursor;
+					break;
+				}
+				if (*m_cursor == '}')
+				{
+					throw exception("invalid termination of list");
+				}
+
+				m_values.push_back(parse_value());
+			}
+
+			value v = make_value(List, m_values.size() - base);
+			v.first = (uint32_t)m_doc.m_values.size();
+			m_doc.m_values.insert(m_doc.m_values.end(), m_values.begin() + base, m_values.end());
+			m_values.resize(base);
+			return v;
+		}
+
+		value parse_value()
+		{
+			value v;
+
+			char next = m_cursor < m_end ? *m_cursor : 0;
+			if (next == '\"')
+			{
+				const char* begin = ++m_cursor;
+				const char* end = (const char*)memchr(begin, '\"', m_end - begin);
+				if (!end) end = m_end;
+
+				m_cursor = end < m_end ? end + 1 : m_end;
+
+				v = make_value(String, end - begin);
+				v.offset = (uint32_t)(begin - m_doc.m_text);
+			}
+			else if (next == '{')
+			{
+				++m_cursor;
+				v = parse_data();
+			}
+			else if (next == '[')
+			{
+				++m_cursor;
+				v = parse_list();
+			}
+			else if (next == '#')
+			{
+				++m_cursor;
+				chars lit = take_literal();
+
+				char buf[32];
+				if (lit.size >= sizeof(buf)) throw exception("malformed hex literal");
+				memcpy(buf, lit.data, lit.size);
+				buf[lit.size] = 0;
+
+				char *p;
+				int64_t i = strtoll(buf, &p, 16);
+				if (*p) throw exception("malformed hex literal");
+				v = make_int(i, m_doc.m_wide);
+			}
+			else if (next == '$')
+			{
+				++m_cursor;
+				const char* end = (const char*)memchr(m_cursor, '$', (std::min)((size_t)(m_end - m_cursor), (size_t)20));
+				if (!end) throw exception("malformed binary section");
+
+				size_t size = 0;
+				for (const char* c = m_cursor; c < end; ++c)
+				{
+					if (*c < '0' || *c > '9') throw exception("malformed binary section");
+					size = size * 10 + (*c - '0');
+				}
+
+				m_cursor = end + 1;
+				if (size > (size_t)(m_end - m_cursor)) throw exception("malformed binary section");
+
+				v = make_value(Binary, size);
+				v.offset = (uint32_t)(m_cursor - m_doc.m_text);
+				m_cursor += size;
+			}
+			else
+			{
+				parse_number(take_literal(), v);
+			}
+
+			return v;
+		}
+
+		// integers and plain decimals ("-12.375", "1.5e3") are read directly, anything else goes through strtof
+		void parse_number(const chars& lit, value& v)
+		{
+			static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+			const char* c = lit.data;
+			const char* end = lit.data + lit.size;
+
+			bool negative = c < end && *c == '-';
+			if (c < end && (*c == '-' || *c == '+')) ++c;
+
+			if (end - c <= 18 && (c < end || lit.size == 0))
+			{
+				const char* digits = c;
+				int64_t i = 0;
+				while (c < end && *c >= '0' && *c <= '9') i = i * 10 + (*c++ - '0');
+
+				if (c == end)
+				{
+					v = make_int(negative ? -i : i, m_doc.m_wide);
+					return;
+				}
+
+				// the mantissa fits in a double exactly, so one multiplication or division by an exact power
+				//  of ten rounds correctly (up to the final conversion to float)
+				bool any = c > digits;
+				int scale = 0;
+				if (*c == '.')
+				{
+					for (++c; c < end && *c >= '0' && *c <= '9'; ++c, --scale)
+					{
+						i = i * 10 + (*c - '0');
+						any = true;
+					}
+				}
+
+				if (any && c < end && (*c == 'e' || *c == 'E'))
+				{
+					const char* e = c + 1;
+					bool negative_exponent = e < end && *e == '-';
+					if (e < end && (*e == '-' || *e == '+')) ++e;
+
+					int exponent = 0;
+					const char* exponent_digits = e;
+					while (e < end && *e >= '0' && *e <= '9' && exponent < 1000) exponent = exponent * 10 + (*e++ - '0');
+
+					if (e > exponent_digits)
+					{
+						scale += negative_exponent ? -exponent : exponent;
+						c = e;
+					}
+				}
+
+				if (any && c == end && scale >= -22 && scale <= 22)
+				{
+					double d = scale < 0 ? (double)i / powers[-scale] : (double)i * powers[scale];
+					v = make_value(Float, 0);
+					v.f = (float)(negative ? -d : d);
+					return;
+				}
+			}
+
+			char buf[64];
+			if (lit.size >= sizeof(buf)) throw exception("malformed number literal");
+			memcpy(buf, lit.data, lit.size);
+			buf[lit.size] = 0;
+
+			char *p;
+			int64_t i = strtoll(buf, &p, 10);
+			if (!*p)
+			{
+				v = make_int(i, m_doc.m_wide);
+				return;
+			}
+
+			float f = strtof(buf, &p);
+			if (*p) throw exception("malformed number literal");
+
+			v = make_value(Float, 0);
+			v.f = f;
+		}
+
+		store_document&    m_doc;
+		const char*        m_cursor;
+		const char*        m_end;
+		std::vector<field> m_fields;
+		std::vector<value> m_values;
+	};
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Binary form
+	namespace
+	{
+		const char     binary_magic[8] = { 'B', 'B', 'S', 'T', 2, 0, 0, 0 };
+
+		struct key_entry
+		{
+			uint32_t offset;
+			uint32_t size;
+		};
+	}
+
+	struct store_document::header
+	{
+		char     magic[8];
+		uint32_t wide_offset;
+		uint32_t wide_count;
+		uint32_t key_offset;
+		uint32_t key_count;
+		uint32_t value_offset;
+		uint32_t value_count;
+		uint32_t field_offset;
+		uint32_t field_count;
+		value    root;
+	};
+
+	store_document::value store_document::make_value(type t, size_t size)
+	{
+		if (size >= (1u << 29)) throw exception("store value too large for a document");
+
+		value v;
+		memset(&v, 0, sizeof(v));
+		v.head = (uint32_t)t | (uint32_t)size << 3;
+		return v;
+	}
+
+	store_document::value store_document::make_int(int64_t i, vector<int64_t> &wide)
+	{
+		if (i >= INT32_MIN && i <= INT32_MAX)
+		{
+			value v = make_value(Int, 0);
+			v.i = (int32_t)i;
+			return v;
+		}
+
+		value v = make_value(Wide, 0);
+		v.first = (uint32_t)wide.size();
+		wide.push_back(i);
+		return v;
+	}
+
+	// Builds the tables the same way the parser does: the children of a Data or List are complete
+	//  before it is added, so each ends up as one contiguous range.
+	class store_document::writer
+	{
+		static_assert(sizeof(value) == 8 && sizeof(field) == 12 && sizeof(key_entry) == 8 && sizeof(header) == 48, "binary store layout changed");
+
+	public:
+		void write(const store &source, ostream &out)
+		{
+			value root = add_data(source);
+
+			header h;
+			memset(&h, 0, sizeof(h));
+			memcpy(h.magic, binary_magic, sizeof(binary_magic));
+
+			// the wide ints first, so every table is aligned to its records
+			uint64_t offset = sizeof(header);
+			auto table = [&](uint32_t &table_offset, uint32_t &table_count, size_t count, size_t size)
+			{
+				table_offset = (uint32_t)offset;
+				table_count = (uint32_t)count;
+				offset += count * size;
+			};
+			table(h.wide_offset, h.wide_count, m_wide.size(), sizeof(int64_t));
+			table(h.key_offset, h.key_count, m_keys.size(), sizeof(key_entry));
+			table(h.value_offset, h.value_count, m_values.size(), sizeof(value));
+			table(h.field_offset, h.field_count, m_fields.size(), sizeof(field));
+
+			// blob offsets become file offsets
+			uint64_t blob = offset;
+			if (blob + m_blob.size() > UINT32_MAX) throw exception("store too large for a binary file");
+
+			vector<key_entry> keys;
+			keys.reserve(m_keys.size());
+			for (auto &k : m_keys)
+			{
+				key_entry e;
+				memset(&e, 0, sizeof(e));
+				e.offset = (uint32_t)(blob + k.first);
+				e.size = k.second;
+				keys.push_back(e);
+			}
+
+			relocate(root, blob);
+			for (auto &v : m_values) relocate(v, blob);
+			for (auto &f : m_fields) relocate(f.v, blob);
+			h.root = root;
+
+			out.write((const char*)&h, sizeof(h));
+			out.write((const char*)m_wide.data(), m_wide.size() * sizeof(int64_t));
+			out.write((const char*)keys.data(), keys.size() * sizeof(key_entry));
+			out.write((const char*)m_values.data(), m_values.size() * sizeof(value));
+			out.write((const char*)m_fields.data(), m_fields.size() * sizeof(field));
+			out.write(m_blob.data(), m_blob.size());
+		}
+
+	private:
+		static void relocate(value &v, uint64_t blob)
+		{
+			if (v.t() == String || v.t() == Binary) v.offset += (uint32_t)blob;
+		}
+
+		// equal keys and strings share their bytes
+		uint32_t add_string(const string &s)
+		{
+			auto it = m_strings.find(s);
+			if (it != m_strings.end()) return it->second;
+
+			uint32_t offset = add_blob(s.data(), s.size());
+			m_strings.emplace(s, offset);
+			return offset;
+		}
+
+		uint32_t add_blob(const char* data, size_t size)
+		{
+			if (m_blob.size() + size > UINT32_MAX) throw exception("store too large for a binary file");
+
+			uint32_t offset = (uint32_t)m_blob.size();
+			m_blob.insert(m_blob.end(), data, data + size);
+			return offset;
+		}
+
+		uint32_t intern(const string &key)
+		{
+			auto it = m_key_ids.find(key);
+			if (it != m_key_ids.end()) return it->second;
+
+			uint32_t id = (uint32_t)m_keys.size();
+			m_keys.emplace_back(add_string(key), (uint32_t)key.size());
+			m_key_ids.emplace(key, id);
+			return id;
+		}
+
+		value add_data(const store &d)
+		{
+			vector<field> fields;
+			d.visit([&](const string &key, const store::val &elem)
+			{
+				field f;
+				memset(&f, 0, sizeof(f));
+				f.key = intern(key);
+				f.v = add_value(elem);
+				fields.push_back(f);
+			});
+
+			sort(fields.begin(), fields.end(), [](const field& a, const field& b) { return a.key < b.key; });
+
+			value v = make_value(Data, fields.size());
+			v.first = (uint32_t)m_fields.size();
+			m_fields.insert(m_fields.end(), fields.begin(), fields.end());
+			return v;
+		}
+
+		value add_list(const vector<store::val> &l)
+		{
+			vector<value> values;
+			values.reserve(l.size());
+			for (auto &elem : l)
+				values.push_back(add_value(elem));
+
+			value v = make_value(List, values.size());
+			v.first = (uint32_t)m_values.size();
+			m_values.insert(m_values.end(), values.begin(), values.end());
+			return v;
+		}
+
+		value add_value(const store::val &elem)
+		{
+			value v = make_value(Float, 0);
+			switch (elem.type())
+			{
+			case store::val::Float:  v.f = elem.f(); break;
+			case store::val::Int:    v = make_int(elem.i(), m_wide); break;
+			case store::val::Data:   v = add_data(elem.d()); break;
+			case store::val::List:   v = add_list(elem.l()); break;
+			case store::val::String:
+			{
+				string s = elem.s();
+				v = make_value(String, s.size());
+				v.offset = add_string(s);
+				break;
+			}
+			case store::val::Binary:
+			{
+				auto &b = elem.b();
+				v = make_value(Binary, b.size());
+				v.offset = add_blob(b.data(), b.size());
+				break;
+			}
+			}
+			return v;
+		}
+
+		vector<pair<uint32_t, uint32_t>>  m_keys;
+		unordered_map<string, uint32_t>   m_key_ids;
+		unordered_map<string, uint32_t>   m_strings;
+		vector<int64_t>                   m_wide;
+		vector<value>                     m_values;
+		vector<field>                     m_fields;
+		vector<char>                      m_blob;
+	};
+
+	void store_document::write(const store &source, ostream &toStream)
+	{
+		writer w;
+		w.write(source, toStream);
+	}
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Document
+	store_document::store_document(const fs::path &fromFile)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileW(fromFile.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) throw exception("could not open store file");
+
+		LARGE_INTEGER size;
+		GetFileSizeEx(file, &size);
+		m_size = (size_t)size.QuadPart;
+
+		if (m_size)
+		{
+			HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping) m_mapping = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (mapping) CloseHandle(mapping);
+		}
+		CloseHandle(file);
+
+		if (m_size && !m_mapping) throw exception("could not map store file");
+#else
+		int file = open(fromFile.c_str(), O_RDONLY);
+		if (file < 0) throw exception("could not open store file");
+
+		struct stat info;
+		fstat(file, &info);
+		m_size = (size_t)info.st_size;
+
+		if (m_size)
+		{
+			void* view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (view != MAP_FAILED) m_mapping = view;
+		}
+		close(file);
+
+		if (m_size && !m_mapping) throw exception("could not map store file");
+#endif
+		m_text = (const char*)m_mapping;
+		parse();
+	}
+
+	store_document::store_document(istream &fromStream)
+		: store_document(vector<char>(istreambuf_iterator<char>(fromStream), istreambuf_iterator<char>()))
+	{
+	}
+
+	store_document::store_document(vector<char> buffer)
+		: m_buffer(move(buffer))
+	{
+		m_text = m_buffer.data();
+		m_size = m_buffer.size();
+		parse();
+	}
+
+	store_document::~store_document()
+	{
+		if (!m_mapping) return;
+#ifdef _WIN32
+		UnmapViewOfFile(m_mapping);
+#else
+		munmap(m_mapping, m_size);
+#endif
+	}
+
+	void store_document::parse()
+	{
+		if (m_size >= sizeof(header) && !memcmp(m_text, binary_magic, 4))
+		{
+			if (memcmp(m_text, binary_magic, sizeof(binary_magic))) throw exception("unsupported binary store version");
+
+			open_binary();
+			return;
+		}
+
+		// values address the text with 32 bit offsets
+		if (m_size > UINT32_MAX) throw exception("store too large for a document");
+
+		// a rough guess that saves most of the reallocations on typical config files
+		m_values.reserve(m_size / 32);
+		m_fields.reserve(m_size / 16);
+
+		parser p(*this);
+		m_root = p.parse_root();
+
+		m_value_data = m_values.data();
+		m_value_count = m_values.size();
+		m_field_data = m_fields.data();
+		m_field_count = m_fields.size();
+		m_wide_data = m_wide.data();
+		m_wide_count = m_wide.size();
+	}
+
+	void store_document::open_binary()
+	{
+		auto &h = *reinterpret_cast<const header*>(m_text);
+
+		auto table_valid = [&](uint64_t offset, uint64_t count, size_t size)
+		{
+			return offset % (size == sizeof(field) ? 4 : 8) == 0 && offset <= m_size && count <= (m_size - offset) / size;
+		};
+
+		if (!table_valid(h.wide_offset, h.wide_count, sizeof(int64_t)) ||
+			!table_valid(h.key_offset, h.key_count, sizeof(key_entry)) ||
+			!table_valid(h.value_offset, h.value_count, sizeof(value)) ||
+			!table_valid(h.field_offset, h.field_count, sizeof(field)))
+		{
+			throw exception("malformed binary store");
+		}
+
+		auto keys = reinterpret_cast<const key_entry*>(m_text + h.key_offset);
+		m_keys.reserve((size_t)h.key_count);
+		for (size_t i = 0; i < h.key_count; ++i)
+		{
+			if (keys[i].offset > m_size || keys[i].size > m_size - keys[i].offset) throw exception("malformed binary store");
+
+			chars key = { m_text + keys[i].offset, (size_t)keys[i].size };
+			m_keys.push_back(key);
+			m_key_ids.emplace(key, (uint32_t)i);
+		}
+
+		m_root = h.root;
+		m_value_data = reinterpret_cast<const value*>(m_text + h.value_offset);
+		m_value_count = (size_t)h.value_count;
+		m_field_data = reinterpret_cast<const field*>(m_text + h.field_offset);
+		m_field_count = (size_t)h.field_count;
+		m_wide_data = reinterpret_cast<const int64_t*>(m_text + h.wide_offset);
+		m_wide_count = (size_t)h.wide_count;
+	}
+
+	store_document::node store_document::root() const
+	{
+		return node(this, &m_root);
+	}
+
+	bool store_document::find_key(const char* key, size_t size, uint32_t& id) const
+	{
+		auto it = m_key_ids.find(chars{ key, size });
+		if (it == m_key_ids.end()) return false;
+
+		id = it->second;
+		return true;
+	}
+
+	size_t store_document::chars_hash::operator()(const chars& x) const
+	{
+		// FNV-1a
+		size_t hash = 2166136261u;
+		for (size_t i = 0; i < x.size; ++i)
+			hash = (hash ^ (unsigned char)x.data[i]) * 16777619u;
+
+		return hash;
+	}
+
+	bool store_document::chars::operator==(const chars& b) const
+	{
+		return size == b.size && !memcmp(data, b.data, size);
+	}
+
+	bool store_document::chars::operator==(const char* b) const
+	{
+		return !strncmp(data, b, size) && !b[size];
+	}
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Node. Ranges are checked against the tables, a binary file is used as it is on disk
+	const store_document::field* store_document::node::fields() const
+	{
+		if (m_value->t() != Data) throw exception("error in store: expected different type");
+		if ((size_t)m_value->first + m_value->size() > m_document->m_field_count) throw exception("error in store: corrupt document");
+
+		return m_document->m_field_data + m_value->first;
+	}
+
+	store_document::chars store_document::node::text() const
+	{
+		if (m_value->offset > m_document->m_size || m_value->size() > m_document->m_size - m_value->offset) throw exception("error in store: corrupt document");
+
+		return{ m_document->m_text + m_value->offset, m_value->size() };
+	}
+
+	const store_document::value& store_document::node::lookup(const string &key) const
+	{
+		auto begin = fields();
+		auto end = begin + m_value->size();
+
+		uint32_t id;
+		if (m_document->find_key(key.data(), key.size(), id))
+		{
+
+			auto it = lower_bound(begin, end, id, [](const store_document::field& f, uint32_t id) { return f.key < id; });
+			if (it != end && it->key == id) return it->v;
+		}
+
+		throw exception("error in store: expected field not found");
+	}
+
+	void store_document::node::visit(function<void(const chars &key, const node &elem)> visitor) const
+	{
+		auto begin = fields();
+		for (size_t i = 0; i < m_value->size(); ++i)
+		{
+			auto &f = begin[i];
+			if (f.key >= m_document->m_keys.size()) throw exception("error in store: corrupt document");
+			visitor(m_document->m_keys[f.key], node(m_document, &f.v));
+		}
+	}
+
+	bool store_document::node::exists(const string &key) const
+	{
+		if (m_value->t() != Data) return false;
+
+		uint32_t id;
+		if (!m_document->find_key(key.data(), key.size(), id)) return false;
+
+		auto begin = fields();
+		auto end = begin + m_value->size();
+
+		auto it = lower_bound(begin, end, id, [](const store_document::field& f, uint32_t id) { return f.key < id; });
+		return it != end && it->key == id;
+	}
+
+	float   store_document::node::getFieldF(const string &key) const { return node(m_document, &lookup(key)).getF(); }
+	int64_t store_document::node::getFieldI(const string &key) const { return node(m_document, &lookup(key)).getI(); }
+	store_document::chars store_document::node::getFieldS(const string &key) const { return node(m_document, &lookup(key)).getS(); }
+	store_document::chars store_document::node::getFieldB(const string &key) const { return node(m_document, &lookup(key)).getB(); }
+
+	store_document::node store_document::node::getFieldD(const string &key) const
+	{
+		auto &v = lookup(key);
+		if (v.t() != Data) throw exception("error in store: expected different type");
+		return node(m_document, &v);
+	}
+
+	store_document::node store_document::node::getFieldL(const string &key) const
+	{
+		auto &v = lookup(key);
+		if (v.t() != List) throw exception("error in store: expected different type");
+		return node(m_document, &v);
+	}
+
+	float store_document::node::getF() const
+	{
+		if (m_value->t() == Float) return m_value->f;
+		if (get_type() == Int) return (float)getI();
+		throw exception("error in store: expected different type");
+	}
+
+	int64_t store_document::node::getI() const
+	{
+		if (m_value->t() == Int) return m_value->i;
+		if (m_value->t() == Float) return (int)m_value->f;
+		if (m_value->t() == Wide)
+		{
+			if (m_value->first >= m_document->m_wide_count) throw exception("error in store: corrupt document");
+			return m_document->m_wide_data[m_value->first];
+		}
+		throw exception("error in store: expected different type");
+	}
+
+	store_document::chars store_document::node::getS() const
+	{
+		if (m_value->t() != String) throw exception("error in store: expected different type");
+		return text();
+	}
+
+	store_document::chars store_document::node::getB() const
+	{
+		if (m_value->t() != Binary) throw exception("error in store: expected different type");
+		return text();
+	}
+
+	store_document::node store_document::node::operator[](size_t index) const
+	{
+		if (m_value->t() != List) throw exception("error in store: expected different type");
+		if (index >= m_value->size()) throw exception("error in store: index out of range");
+		if ((size_t)m_value->first + m_value->size() > m_document->m_value_count) throw exception("error in store: corrupt document");
+
+		return node(m_document, &m_document->m_value_data[m_value->first + index]);
+	}
+
+	void store_document::node::copy_to(store &target) const
+	{
+		copy_to(target, m_document->m_field_count, m_document->m_value_count);
+	}
+
+	store::val store_document::node::to_val() const
+	{
+		return to_val(m_document->m_field_count, m_document->m_value_count);
+	}
+
+	// the parser and the writer add the children of a Data or List before it, so a range has to end where
+	//  the range of its parent in the same table begins. a corrupt file that points back at a parent
+	//  throws instead of recursing forever
+	void store_document::node::copy_to(store &target, size_t field_limit, size_t value_limit) const
+	{
+		fields();
+		if ((size_t)m_value->first + m_value->size() > field_limit) throw exception("error in store: corrupt document");
+
+		vector<pair<string, store::val>> fields;
+		fields.reserve(m_value->size());
+		visit([&](const chars &key, const node &elem)
+		{
+			fields.emplace_back(key.str(), elem.to_val(m_value->first, value_limit));
+		});
+
+		target.merge(move(fields));
+	}
+
+	store::val store_document::node::to_val(size_t field_limit, size_t value_limit) const
+	{
+		switch (get_type())
+		{
+		case Float:  return getF();
+		case Int:    return getI();
+		case String: return getS().str();
+		case Binary: return getB().bytes();
+		case Data:
+		{
+			store d;
+			copy_to(d, field_limit, value_limit);
+			return move(d);
+		}
+		default:
+		{
+			if ((size_t)m_value->first + m_value->size() > value_limit) throw exception("error in store: corrupt document");
+
+			vector<store::val> l;
+			l.reserve(m_value->size());
+			for (size_t i = 0; i < m_value->size(); ++i)
+				l.push_back((*this)[i].to_val(field_limit, m_value->first));
+			return move(l);
+		}
+		}
+	}
+}
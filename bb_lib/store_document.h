@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <istream>
+#include <functional>
+#include <unordered_map>
+#include <filesystem>
+
+#include "store.h"
+
+namespace bb
+{
+	namespace fs = std::experimental::filesystem;
+
+	/*
+	 * Read-only store, parsed in a single pass over a memory mapped file (or a buffer).
+	 * Keys are interned, values are 8 byte tagged unions, and strings and binary sections
+	 *  point straight into the mapped text, so parsing does not allocate per value.
+	 * Texts and binary files are limited to 4 GB, strings, binary sections, Data and List to 2^29 bytes or entries.
+	 * Node handles and chars stay valid as long as the document is alive.
+	 *
+	 * Files written by write() hold the same value and field tables in binary form, those are used
+	 *  in place: loading reads the key table only and a nested lookup touches just the pages it needs.
+	 *
+	 *  header   magic "BBST", version, offsets and counts of the tables below, root value
+	 *  wide     int64[], Int values that do not fit in 32 bits
+	 *  keys     { uint32 offset, uint32 size } per interned key
+	 *  values   value[], list elements, every List is one contiguous range
+	 *  fields   field[], every Data is one contiguous range sorted by key id
+	 *  blob     key, string and binary bytes, referenced by offset and size
+	 *
+	 *  Numbers are little endian, offsets are from the start of the file, tables are aligned to their records.
+	 *  The children of a Data or List come before it in their table.
+	 *
+	 * The binary form is not smaller than the text (24.9 against 25.0 MB for run_store_benchmark), making it
+	 *  compact was dropped: variable length sizes and offsets would save space, but records have to keep
+	 *  a fixed size so that a lookup can index and binary search the mapped tables without parsing them.
+	 */
+	class store_document
+	{
+	public:
+		enum type : uint8_t { Float, Int, String, Data, List, Binary };
+
+		// view on a string or binary section inside the document
+		struct chars
+		{
+			const char* data;
+			size_t      size;
+
+			std::string       str() const   { return std::string(data, size); }
+			std::vector<char> bytes() const { return std::vector<char>(data, data + size); }
+
+			bool operator==(const chars& b) const;
+			bool operator==(const char* b) const;
+		};
+
+		class node;
+
+		store_document(const fs::path &fromFile);
+		store_document(std::istream &fromStream);
+		store_document(std::vector<char> buffer);
+		~store_document();
+
+		store_document(const store_document&) = delete;
+		store_document& operator=(const store_document&) = delete;
+
+		node root() const;
+
+		// binary form of a store, see above
+		static void write(const store &source, std::ostream &toStream);
+
+		// number of distinct keys
+		size_t keys() const { return m_keys.size(); }
+
+	private:
+		// an Int that does not fit in 32 bits, kept in the table of wide ints
+		static const type Wide = (type)6;
+
+		struct value
+		{
+			uint32_t head;        // type in the low 3 bits, above them characters, bytes, fields or elements
+			union
+			{
+				float    f;
+				int32_t  i;
+				uint32_t offset;  // String, Binary: position in the text
+				uint32_t first;   // Data: first field, List: first element, Wide: index of the int
+			};
+
+			type     t() const    { return (type)(head & 7); }
+			uint32_t size() const { return head >> 3; }
+		};
+
+		struct field
+		{
+			uint32_t key;
+			value    v;
+		};
+
+		// zeroed, so that files do not depend on what was in memory; throws when the size does not fit
+		static value make_value(type t, size_t size);
+		static value make_int(int64_t i, std::vector<int64_t> &wide);
+
+		struct chars_hash
+		{
+			size_t operator()(const chars& x) const;
+		};
+
+		struct header;
+		class parser;
+		class writer;
+
+		void parse();
+		void open_binary();
+		bool find_key(const char* key, size_t size, uint32_t& id) const;
+
+		const char*                                       m_text = nullptr;
+		size_t                                            m_size = 0;
+		std::vector<char>                                 m_buffer;
+		void*                                             m_mapping = nullptr;
+
+		std::vector<chars>                                m_keys;
+		std::unordered_map<chars, uint32_t, chars_hash>   m_key_ids;
+		value                                             m_root;
+
+		// tables in use, either m_values and m_fields of a parsed text or the tables in a binary file
+		const value*                                      m_value_data = nullptr;
+		size_t                                            m_value_count = 0;
+		const field*                                      m_field_data = nullptr;
+		size_t                                            m_field_count = 0;
+		const int64_t*                                    m_wide_data = nullptr;
+		size_t                                            m_wide_count = 0;
+
+		std::vector<value>                                m_values;
+		std::vector<field>                                m_fields;
+		std::vector<int64_t>                              m_wide;
+	};
+
+	class store_document::node
+	{
+	public:
+		type get_type() const { return m_value->t() == Wide ? Int : m_value->t(); }
+
+		void visit(std::function<void(const chars &key, const node &elem)> visitor) const;
+
+		bool exists(const std::string &key) const;
+
+		float   getFieldF(const std::string &key) const;
+		int64_t getFieldI(const std::string &key) const;
+		chars   getFieldS(const std::string &key) const;
+		node    getFieldD(const std::string &key) const;
+		node    getFieldL(const std::string &key) const;
+		chars   getFieldB(const std::string &key) const;
+
+		// Float, Int, String and Binary values
+		float   getF() const;
+		int64_t getI() const;
+		chars   getS() const;
+		chars   getB() const;
+
+		// elements of a List, fields of a Data
+		size_t size() const { return m_value->size(); }
+		node   operator[](size_t index) const;
+
+		// copy into a mutable store, existing fields are kept like store::setField* does
+		void       copy_to(store &target) const;
+		store::val to_val() const;
+
+	private:
+		friend class store_document;
+
+		node(const store_document* document, const value* v)
+			: m_document(document)
+			, m_value(v) { }
+
+		void       copy_to(store &target, size_t field_limit, size_t value_limit) const;
+		store::val to_val(size_t field_limit, size_t value_limit) const;
+
+		const value&                 lookup(const std::string &key) const;
+		const store_document::field* fields() const;
+		chars                        text() const;
+
+		const store_document* m_document;
+		const value*          m_value;
+	};
+
+	//----------------------------------------------------------------------------------------------------------------
+	// Round trip of a generated tree through the text and binary formats, throws when a store does not read back
+	//  the same. Files are written to directory.
+	struct store_benchmark_report
+	{
+		size_t text_bytes = 0;
+		size_t binary_bytes = 0;
+		double store_text_ms = 0;        // store::load of the text
+		double store_binary_ms = 0;      // store::load of the binary form
+		double document_text_ms = 0;     // store_document of the text
+		double document_binary_ms = 0;   // store_document of the binary form
+		double lookup_binary_ms = 0;     // a nested lookup in every entry of the binary form
+
+		void print(std::ostream &out) const;
+	};
+
+	store_benchmark_report run_store_benchmark(const fs::path &directory, unsigned entries = 100000);
+}
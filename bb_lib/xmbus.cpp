@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <chrono>
+#include "xmbus.h"
+
+namespace bb
+{
+	namespace xm
+	{
+		bus::bus(int sampleRate, size_t voiceBudget)
+			: sampleRate(sampleRate)
+			, voiceBudget(voiceBudget) { }
+
+		bus::handle bus::add(player* play, float gain, float pan)
+		{
+			if (play->sampleRate != sampleRate)
+				throw std::exception("player sample rate differs from the bus");
+
+			sources.push_back({ nextId, play, channel(nullptr, 0), gain, pan, 0, 0, 0 });
+			return nextId++;
+		}
+
+		bus::handle bus::play(const sample* s, float frequency, float gain, float pan, int priority)
+		{
+			// finished voices give their place back first
+			sources.erase(std::remove_if(sources.begin(), sources.end(), [](const source& x) { return !x.play && !x.voice.playing(); }), sources.end());
+
+			if (voices() >= voiceBudget)
+			{
+				source* victim = nullptr;
+				for (auto& x : sources)
+				{
+					if (!x.play && (!victim || x.priority < victim->priority || (x.priority == victim->priority && x.started < victim->started)))
+						victim = &x;
+				}
+
+				if (!victim || victim->priority > priority)
+					return 0;
+
+				sources.erase(sources.begin() + (victim - sources.data()));
+			}
+
+			source x = { nextId, nullptr, channel(nullptr, 0), gain, pan, priority, voicesStarted++, 0 };
+			x.voice.trigger(s, frequency / sampleRate, gain, pan);
+			sources.push_back(x);
+			return nextId++;
+		}
+
+		void bus::remove(handle id)
+		{
+			sources.erase(std::remove_if(sources.begin(), sources.end(), [id](const source& x) { return x.id == id; }), sources.end());
+		}
+
+		void bus::set(handle id, float gain, float pan)
+		{
+			if (source* x = find(id))
+			{
+				x->gain = gain;
+				x->pan = pan;
+				x->voice.setVolume(gain, pan);
+			}
+		}
+
+		bool bus::playing(handle id) const
+		{
+			const source* x = find(id);
+			return x && (x->play || x->voice.playing());
+		}
+
+		void bus::mix(float* buffer, size_t frames)
+		{
+			const size_t block = 1024;
+			const float scale = 0x1fff / 32768.0f * volume;
+
+			left.resize(block);
+			right.resize(block);
+
+			for (size_t done = 0; done < frames;)
+			{
+				size_t n = std::min(block, frames - done);
+				std::fill(left.begin(), left.begin() + n, 0.0f);
+				std::fill(right.begin(), right.begin() + n, 0.0f);
+
+				for (auto& x : sources)
+				{
+					auto start = std::chrono::steady_clock::now();
+
+					if (x.play)
+					{
+						// balance: the center keeps both sides at full gain
+						x.play->mixAdd(left.data(), right.data(), n, x.gain * std::min(1.0f, 2 - 2 * x.pan), x.gain * std::min(1.0f, 2 * x.pan));
+					}
+					else if (x.voice.playing())
+					{
+						x.voice.mix(left.data(), right.data(), n, quality);
+					}
+
+					x.ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				}
+
+				float* out = buffer + done * 2;
+				size_t i = 0;
+
+#ifdef XM_SSE2
+				const __m128 s = _mm_set1_ps(scale);
+				for (; i + 4 <= n; i += 4)
+				{
+					__m128 l = _mm_mul_ps(_mm_loadu_ps(&left[i]), s);
+					__m128 r = _mm_mul_ps(_mm_loadu_ps(&right[i]), s);
+					_mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(l, r));
+					_mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(l, r));
+				}
+#endif
+
+				for (; i < n; ++i)
+				{
+					out[i * 2 + 0] = left[i] * scale;
+					out[i * 2 + 1] = right[i] * scale;
+				}
+
+				done += n;
+			}
+		}
+
+		double bus::cost(handle id) const
+		{
+			const source* x = find(id);
+			return x ? x->ms : 0;
+		}
+
+		void bus::resetCosts()
+		{
+			for (auto& x : sources)
+				x.ms = 0;
+		}
+
+		size_t bus::voices() const
+		{
+			size_t count = 0;
+			for (auto& x : sources)
+			{
+				if (x.play) count += x.play->channelCount();
+				else if (x.voice.playing()) count++;
+			}
+			return count;
+		}
+
+		bus::source* bus::find(handle id)
+		{
+			for (auto& x : sources)
+				if (x.id == id) return &x;
+			return nullptr;
+		}
+
+		const bus::source* bus::find(handle id) const
+		{
+			for (auto& x : sources)
+				if (x.id == id) return &x;
+			return nullptr;
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+
+#include "xmplay.h"
+
+namespace bb
+{
+	namespace xm
+	{
+		// Mixes players and one-shot sample voices into one interleaved stereo output. Every source is added straight
+		//  into the bus's left and right buffers with its gain and pan, a single pass scales and interleaves the result.
+		// Players reserve one voice per channel and are never stolen, sample voices share the rest of the budget:
+		//  when it is full a new voice replaces the lowest priority voice (the oldest of equal priority) if that one
+		//  is not more important, otherwise it is not played.
+		class bus
+		{
+		public:
+			typedef int handle;   // 0 is never a valid handle
+
+			bus(int sampleRate = 44100, size_t voiceBudget = 64);
+
+			// the player must use the bus's sample rate, pan 0 is left, 0.5 center, 1 right
+			handle add(player* play, float gain = 1, float pan = 0.5f);
+
+			// frequency is the playback rate of the sample, 8363 Hz is C-4 for xm samples. Returns 0 when the
+			//  budget is full of more important voices.
+			handle play(const sample* s, float frequency = 8363, float gain = 1, float pan = 0.5f, int priority = 0);
+
+			void remove(handle source);
+			void set(handle source, float gain, float pan);
+
+			bool playing(handle source) const;
+
+			// interleaved stereo at the levels of player::mix(float*)
+			void mix(float* buffer, size_t frames);
+
+			// milliseconds spent mixing a source since it was added or since resetCosts
+			double cost(handle source) const;
+			void   resetCosts();
+
+			size_t voices() const;
+
+			int           sampleRate;
+			size_t        voiceBudget;
+			interpolation quality = interpolation::Linear;
+			float         volume = 1;
+
+		private:
+			struct source
+			{
+				handle  id;
+				player* play;       // nullptr for a sample voice
+				channel voice;
+				float   gain;
+				float   pan;
+				int     priority;
+				size_t  started;
+				double  ms;
+			};
+
+			source*       find(handle id);
+			const source* find(handle id) const;
+
+			std::vector<source> sources;
+			std::vector<float>  left;
+			std::vector<float>  right;
+
+			handle nextId = 1;
+			size_t voicesStarted = 0;
+		};
+	}
+}
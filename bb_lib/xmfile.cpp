@@ -0,0 +1,142 @@
+#include "xmfile.h"
+
+namespace bb
+{
+	namespace xm
+	{
+		std::shared_ptr<const sample_data> sample_cache::decode(const std::vector<char>& raw, bool sixteenBit)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			return decodeLocked(raw, sixteenBit);
+		}
+
+		std::shared_ptr<const sample_data> sample_cache::publish(const sample& s)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			// another thread decoded it while this one waited for the lock
+			if (auto published = std::atomic_load(&s.samples)) return published;
+
+			auto decoded = decodeLocked(s.data, (s.type & 0x10) != 0);
+			std::atomic_store(&s.samples, decoded);
+			std::vector<char>().swap(s.data);
+			return decoded;
+		}
+
+		std::shared_ptr<const sample_data> sample_cache::decodeLocked(const std::vector<char>& raw, bool sixteenBit)
+		{
+			// FNV-1a of the raw data, the bit depth and the format
+			uint64_t key = 14695981039346656037ull;
+			for (char c : raw)
+				key = (key ^ (uint8_t)c) * 1099511628211ull;
+			key = (key ^ (sixteenBit ? 2 : 1) ^ (format << 2)) * 1099511628211ull;
+
+			auto found = entries.find(key);
+			if (found != entries.end())
+			{
+				auto existing = found->second.decoded.lock();
+				if (existing && found->second.matches(raw, sixteenBit, *existing))
+					return existing;
+			}
+
+			auto decoded = std::make_shared<sample_data>();
+
+			if (sixteenBit)
+			{
+				size_t length = raw.size() / 2;
+				auto ptr = reinterpret_cast<const short*>(raw.data());
+
+				short sam = 0;
+				if (format == Int16)
+				{
+					decoded->points16.resize(length);
+					decoded->scale = 1 / (float)0x7fff;
+					for (size_t i = 0; i < length; ++i)
+						decoded->points16[i] = sam += ptr[i];
+				}
+				else
+				{
+					decoded->points.resize(length);
+					for (size_t i = 0; i < length; ++i)
+						decoded->points[i] = (sam += ptr[i]) / (float)0x7fff;
+				}
+			}
+			else
+			{
+				size_t length = raw.size();
+				auto ptr = raw.data();
+
+				char sam = 0;
+				if (format == Int16)
+				{
+					decoded->points16.resize(length);
+					decoded->scale = 1 / (float)0x7f;
+					for (size_t i = 0; i < length; ++i)
+						decoded->points16[i] = sam += ptr[i];
+				}
+				else
+				{
+					decoded->points.resize(length);
+					for (size_t i = 0; i < length; ++i)
+						decoded->points[i] = (sam += ptr[i]) / (float)0x7f;
+				}
+			}
+
+			// forget samples nobody uses anymore
+			for (auto i = entries.begin(); i != entries.end();)
+			{
+				if (i->second.decoded.expired()) i = entries.erase(i);
+				else ++i;
+			}
+
+			// on a collision with a live entry this sample is not shared
+			if (!entries.count(key))
+				entries[key] = entry{ raw.size(), sixteenBit, decoded };
+			return decoded;
+		}
+
+		bool sample_cache::entry::matches(const std::vector<char>& raw, bool sixteenBit, const sample_data& decoded) const
+		{
+			if (rawSize != raw.size() || this->sixteenBit != sixteenBit) return false;
+
+			// decoding is one to one, so comparing the points as decode() computed them compares the bytes
+			//  without keeping a copy of them
+			if (sixteenBit)
+			{
+				auto ptr = reinterpret_cast<const short*>(raw.data());
+				short sam = 0;
+				for (size_t i = 0; i < raw.size() / 2; ++i)
+				{
+					sam += ptr[i];
+					if (decoded.points.empty() ? decoded.points16[i] != sam : decoded.points[i] != sam / (float)0x7fff) return false;
+				}
+			}
+			else
+			{
+				char sam = 0;
+				for (size_t i = 0; i < raw.size(); ++i)
+				{
+					sam += raw[i];
+					if (decoded.points.empty() ? decoded.points16[i] != sam : decoded.points[i] != sam / (float)0x7f) return false;
+				}
+			}
+			return true;
+		}
+
+		size_t sample_cache::size() const
+		{
+			std::lock_guard<std::mutex> guard(lock);
+
+			size_t count = 0;
+			for (auto& e : entries)
+				if (!e.second.decoded.expired()) count++;
+			return count;
+		}
+
+		sample_cache& sample_cache::shared()
+		{
+			static sample_cache cache;
+			return cache;
+		}
+	}
+}
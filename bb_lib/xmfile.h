@@ -1,11 +1,73 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include "serialize.hpp"
 
 namespace bb
 {
 	namespace xm
 	{
+		// decoded points of a sample, either as float or as int16 converted by the mixer
+		struct sample_data
+		{
+			std::vector<float>   points;
+			std::vector<int16_t> points16;
+			float                scale = 1;   // of points16
+
+			size_t size() const          { return points.empty() ? points16.size() : points.size(); }
+			size_t bytes() const         { return points.size() * sizeof(float) + points16.size() * sizeof(int16_t); }
+			float  at(size_t i) const    { return points.empty() ? points16[i] * scale : points[i]; }
+		};
+
+		struct sample;
+
+		// Decoded samples by content, so modules that share instruments share their points.
+		// Entries live as long as a sample uses them.
+		// Int16 is the default, its points take half the memory of Float. Float renders are bit exact to
+		//  the old mixer, but its points take four times the raw size of 8 bit samples.
+		class sample_cache
+		{
+		public:
+			enum format_t { Float, Int16 };
+
+			sample_cache(format_t format = Int16)
+				: format(format) { }
+
+			// raw is the delta coded sample data of the file, thread safe
+			std::shared_ptr<const sample_data> decode(const std::vector<char>& raw, bool sixteenBit);
+
+			// decodes s unless another thread did, publishes the points and drops the raw data of s.
+			// The raw data is only read under the lock, so a sample has to be decoded through one cache.
+			std::shared_ptr<const sample_data> publish(const sample& s);
+
+			size_t size() const;
+
+			// used by documents without a cache of their own
+			static sample_cache& shared();
+
+			const format_t format;
+
+		private:
+			struct entry
+			{
+				size_t                           rawSize;
+				bool                             sixteenBit;
+				std::weak_ptr<const sample_data> decoded;
+
+				// whether decoded came from raw, the hash alone may collide
+				bool matches(const std::vector<char>& raw, bool sixteenBit, const sample_data& decoded) const;
+			};
+
+			std::shared_ptr<const sample_data> decodeLocked(const std::vector<char>& raw, bool sixteenBit);
+
+			mutable std::mutex lock;
+			std::unordered_map<uint64_t, entry> entries;
+		};
+
 		struct note
 		{
 			note()
@@ -113,8 +175,19 @@ namespace bb
 			unsigned char  reserved;
 			char           name[22];
 
-			std::vector<char>  data;
-			std::vector<float> samples;
+			// raw delta coded points, dropped once they are decoded
+			mutable std::vector<char>                          data;
+			// set once, only accessed through std::atomic_load and std::atomic_store
+			mutable std::shared_ptr<const sample_data>         samples;
+
+			// decodes on first use, which is logically const like a cache fill. Threads that race to decode
+			//  serialize on the lock of the cache, the first decodes and the others return its points.
+			const sample_data& decode(sample_cache* cache = nullptr) const
+			{
+				auto decoded = std::atomic_load(&samples);
+				if (!decoded) decoded = (cache ? *cache : sample_cache::shared()).publish(*this);
+				return *decoded;
+			}
 
 			template <typename VISITOR>
 			void reflect(VISITOR& visit)
@@ -146,32 +219,12 @@ namespace bb
 			{
 				visit.raw("data", data.data(), data.size());
 
+				// points are decoded when the sample is first played
 				if (type & 0x10)
 				{
-					auto ptr = reinterpret_cast<short*>(data.data());
 					length /= 2;
 					loopStart /= 2;
 					loopEnd /= 2;
-
-					samples.reserve(length);
-					short sam = 0;
-					for (size_t i = 0; i < length; ++i)
-					{
-						sam += ptr[i];
-						samples.push_back(sam / (float)0x7fff);
-					}
-				}
-				else
-				{
-					auto ptr = reinterpret_cast<char*>(data.data());
-
-					samples.reserve(length);
-					char sam = 0;
-					for (size_t i = 0; i < length; ++i)
-					{
-						sam += ptr[i];
-						samples.push_back(sam / (float)0x7f);
-					}
 				}
 			}
 		};
@@ -296,6 +349,37 @@ namespace bb
 			std::vector<pattern> patterns;
 			std::vector<instrument> instruments;
 
+			// where samples are decoded, nullptr uses sample_cache::shared()
+			sample_cache* cache = nullptr;
+
+			// decodes every sample now instead of on first play, e.g. before playback starts on an audio thread
+			void decodeAll()
+			{
+				for (auto& i : instruments)
+					for (auto& s : i.instrumentSamples)
+						s.decode(cache);
+			}
+
+			// bytes of pattern and sample data held by the document, shared decoded samples count in full.
+			// Not while the document is played, decoding drops the raw data.
+			size_t memoryUsage() const
+			{
+				size_t bytes = 0;
+				for (auto& p : patterns)
+					for (auto& r : p.rows)
+						bytes += r.notes.capacity() * sizeof(note);
+
+				for (auto& i : instruments)
+				{
+					for (auto& s : i.instrumentSamples)
+					{
+						bytes += s.data.capacity();
+						if (auto decoded = std::atomic_load(&s.samples)) bytes += decoded->bytes();
+					}
+				}
+				return bytes;
+			}
+
 			template <typename VISITOR>
 			void reflect(VISITOR& visit)
 			{
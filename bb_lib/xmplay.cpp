@@ -1,4 +1,6 @@
 #include <cassert>
+#include <algorithm>
+#include <cmath>
 #include "xmplay.h"
 
 #define HAS_TONE_PORTAMENTO(s) ()
@@ -28,6 +30,272 @@ namespace bb
 			return 0;
 		}
 
+		// Interpolation kernels, they read data[a - before] to data[a + after] for a position a + t.
+		// sample4 does the same for four positions at once, a holds their indices.
+
+		struct nearest_kernel
+		{
+			static const int before = 0;
+			static const int after = 0;
+
+			static float sample(const float* data, size_t a, float)
+			{
+				return data[a];
+			}
+
+#ifdef XM_SSE2
+			static __m128 sample4(const float* data, const int32_t* a, __m128)
+			{
+				return _mm_setr_ps(data[a[0]], data[a[1]], data[a[2]], data[a[3]]);
+			}
+#endif
+		};
+
+		struct linear_kernel
+		{
+			static const int before = 0;
+			static const int after = 1;
+
+			static float sample(const float* data, size_t a, float t)
+			{
+				return data[a] + (data[a + 1] - data[a]) * t;
+			}
+
+#ifdef XM_SSE2
+			static __m128 sample4(const float* data, const int32_t* a, __m128 t)
+			{
+				// data[a] and data[a + 1] of a lane are adjacent, load them as one pair and split afterwards
+				__m128 lo = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(data + a[0])), (const __m64*)(data + a[1]));
+				__m128 hi = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(data + a[2])), (const __m64*)(data + a[3]));
+				__m128 u = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+				__m128 v = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+				return _mm_add_ps(u, _mm_mul_ps(_mm_sub_ps(v, u), t));
+			}
+#endif
+		};
+
+		// 4 point Catmull-Rom spline
+		struct cubic_kernel
+		{
+			static const int before = 1;
+			static const int after = 2;
+
+			static float sample(const float* data, size_t a, float t)
+			{
+				float s0 = data[a - 1], s1 = data[a], s2 = data[a + 1], s3 = data[a + 2];
+				float c1 = 0.5f * (s2 - s0);
+				float c2 = s0 - 2.5f * s1 + 2.0f * s2 - 0.5f * s3;
+				float c3 = 0.5f * (s3 - s0) + 1.5f * (s1 - s2);
+				return ((c3 * t + c2) * t + c1) * t + s1;
+			}
+
+#ifdef XM_SSE2
+			static __m128 sample4(const float* data, const int32_t* a, __m128 t)
+			{
+				// the four points of a lane are one unaligned load, transposed into one vector per point
+				__m128 s0 = _mm_loadu_ps(data + a[0] - 1);
+				__m128 s1 = _mm_loadu_ps(data + a[1] - 1);
+				__m128 s2 = _mm_loadu_ps(data + a[2] - 1);
+				__m128 s3 = _mm_loadu_ps(data + a[3] - 1);
+				_MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+
+				const __m128 half = _mm_set1_ps(0.5f);
+				__m128 c1 = _mm_mul_ps(half, _mm_sub_ps(s2, s0));
+				__m128 c2 = _mm_sub_ps(_mm_add_ps(s0, _mm_mul_ps(_mm_set1_ps(2.0f), s2)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.5f), s1), _mm_mul_ps(half, s3)));
+				__m128 c3 = _mm_add_ps(_mm_mul_ps(half, _mm_sub_ps(s3, s0)), _mm_mul_ps(_mm_set1_ps(1.5f), _mm_sub_ps(s1, s2)));
+				return _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(c3, t), c2), t), c1), t), s1);
+			}
+#endif
+		};
+
+		// 8 tap Blackman windowed sinc, one row of weights per 1/256 of a sample.
+		// Playing more than one point per output sample the cutoff has to follow the output rate, at 1 / advance
+		//  of the sample's Nyquist, or the points above it alias. Each band is a table with a lower cutoff,
+		//  sincBand picks the highest one that does not alias at an advance.
+		const int   sinc_bands = 7;
+		const float sinc_cutoffs[sinc_bands] = { 1, 0.8f, 2 / 3.0f, 0.5f, 0.4f, 1 / 3.0f, 0.25f };
+
+		inline int sincBand(float advance)
+		{
+			int band = 0;
+			while (band + 1 < sinc_bands && sinc_cutoffs[band] * fabsf(advance) > 1) ++band;
+			return band;
+		}
+
+		template <int Band>
+		struct sinc_kernel
+		{
+			static const int before = 3;
+			static const int after = 4;
+			static const int phases = 256;
+
+			struct table
+			{
+				alignas(16) float weights[phases + 1][8];
+
+				table()
+				{
+					const double pi = 3.14159265358979323846;
+					const double cutoff = 0.95 * sinc_cutoffs[Band];   // a little below, the window does not stop sharply
+
+					for (int p = 0; p <= phases; ++p)
+					{
+						double t = (double)p / phases;
+						double sum = 0;
+
+						for (int k = 0; k < 8; ++k)
+						{
+							double x = (k - before) - t;
+							double sinc = x == 0 ? 1.0 : sin(pi * cutoff * x) / (pi * cutoff * x);
+							double w = (x + 4) / 8;
+							double window = 0.42 - 0.5 * cos(2 * pi * w) + 0.08 * cos(4 * pi * w);
+							weights[p][k] = (float)(cutoff * sinc * window);
+							sum += weights[p][k];
+						}
+
+						// unity gain at every phase
+						for (int k = 0; k < 8; ++k)
+							weights[p][k] = (float)(weights[p][k] / sum);
+					}
+				}
+			};
+
+			static const table& weights()
+			{
+				static const table t;
+				return t;
+			}
+
+			static float sample(const float* data, size_t a, float t)
+			{
+				const float* w = weights().weights[(int)(t * phases + 0.5f)];
+				const float* d = data + a - before;
+
+				float x = 0;
+				for (int k = 0; k < 8; ++k)
+					x += d[k] * w[k];
+				return x;
+			}
+
+#ifdef XM_SSE2
+			static __m128 sample4(const float* data, const int32_t* a, __m128 t)
+			{
+				const table& w = weights();
+				alignas(16) int32_t phase[4];
+				_mm_store_si128((__m128i*)phase, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(t, _mm_set1_ps((float)phases)), _mm_set1_ps(0.5f))));
+
+				__m128 x0 = dot(data + a[0] - before, w.weights[phase[0]]);
+				__m128 x1 = dot(data + a[1] - before, w.weights[phase[1]]);
+				__m128 x2 = dot(data + a[2] - before, w.weights[phase[2]]);
+				__m128 x3 = dot(data + a[3] - before, w.weights[phase[3]]);
+
+				// horizontal sums of the four partial products
+				_MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+				return _mm_add_ps(_mm_add_ps(x0, x1), _mm_add_ps(x2, x3));
+			}
+
+			static __m128 dot(const float* d, const float* w)
+			{
+				return _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(d), _mm_load_ps(w)), _mm_mul_ps(_mm_loadu_ps(d + 4), _mm_load_ps(w + 4)));
+			}
+#endif
+		};
+
+		// Interpolates the sample at pos + i * step for i from begin to end and adds it to left[i] and right[i].
+		// data holds the points from first on. Every position must have the kernel's taps inside data, the caller
+		//  splits the output at loop boundaries.
+		template <typename Kernel>
+		void mixRun(const float* data, size_t first, float pos, float step, size_t begin, size_t end, float* left, float* right, float volLeft, float volRight)
+		{
+			size_t i = begin;
+
+#ifdef XM_SSE2
+			const __m128 vpos = _mm_set1_ps(pos);
+			const __m128 vstep = _mm_set1_ps(step);
+			const __m128 four = _mm_set1_ps(4);
+			const __m128 vl = _mm_set1_ps(volLeft);
+			const __m128 vr = _mm_set1_ps(volRight);
+
+			const __m128i vfirst = _mm_set1_epi32((int32_t)first);
+
+			// the lane's index as float, exact as long as a run is shorter than 2^24
+			__m128 index = _mm_setr_ps((float)i, (float)(i + 1), (float)(i + 2), (float)(i + 3));
+
+			// the points are read through the lane indices in memory, which is cheaper than extracting them from a
+			//  register; two groups of four per iteration overlap their loads
+			alignas(16) int32_t a[8];
+			for (; i + 8 <= end; i += 8)
+			{
+				__m128 p0 = _mm_add_ps(vpos, _mm_mul_ps(index, vstep));
+				index = _mm_add_ps(index, four);
+				__m128 p1 = _mm_add_ps(vpos, _mm_mul_ps(index, vstep));
+				index = _mm_add_ps(index, four);
+
+				__m128i a0 = _mm_cvttps_epi32(p0);
+				__m128i a1 = _mm_cvttps_epi32(p1);
+				_mm_store_si128((__m128i*)a, _mm_sub_epi32(a0, vfirst));
+				_mm_store_si128((__m128i*)(a + 4), _mm_sub_epi32(a1, vfirst));
+
+				__m128 x0 = Kernel::sample4(data, a, _mm_sub_ps(p0, _mm_cvtepi32_ps(a0)));
+				__m128 x1 = Kernel::sample4(data, a + 4, _mm_sub_ps(p1, _mm_cvtepi32_ps(a1)));
+
+				_mm_storeu_ps(left + i, _mm_add_ps(_mm_loadu_ps(left + i), _mm_mul_ps(vl, x0)));
+				_mm_storeu_ps(right + i, _mm_add_ps(_mm_loadu_ps(right + i), _mm_mul_ps(vr, x0)));
+				_mm_storeu_ps(left + i + 4, _mm_add_ps(_mm_loadu_ps(left + i + 4), _mm_mul_ps(vl, x1)));
+				_mm_storeu_ps(right + i + 4, _mm_add_ps(_mm_loadu_ps(right + i + 4), _mm_mul_ps(vr, x1)));
+			}
+
+			if (i + 4 <= end)
+			{
+				__m128 p = _mm_add_ps(vpos, _mm_mul_ps(index, vstep));
+				__m128i a0 = _mm_cvttps_epi32(p);
+				_mm_store_si128((__m128i*)a, _mm_sub_epi32(a0, vfirst));
+				__m128 x = Kernel::sample4(data, a, _mm_sub_ps(p, _mm_cvtepi32_ps(a0)));
+
+				_mm_storeu_ps(left + i, _mm_add_ps(_mm_loadu_ps(left + i), _mm_mul_ps(vl, x)));
+				_mm_storeu_ps(right + i, _mm_add_ps(_mm_loadu_ps(right + i), _mm_mul_ps(vr, x)));
+				i += 4;
+			}
+#endif
+
+			for (; i < end; ++i)
+			{
+				float p = pos + i * step;
+				size_t a = (size_t)p;
+				float x = Kernel::sample(data, a - first, p - a);
+
+				left[i] += volLeft * x;
+				right[i] += volRight * x;
+			}
+		}
+
+		// mixRun for int16 points, converted to float in blocks that cover a part of the run. The positions are
+		//  the ones of the whole run, so the same points and fractions are interpolated as with float points.
+		template <typename Kernel>
+		void mixRun16(const sample_data& data, float pos, float step, size_t samples, float* left, float* right, float volLeft, float volRight)
+		{
+			const size_t points = 1024;
+			float block[points + Kernel::before + Kernel::after + 4];
+
+			size_t perBlock = std::max((size_t)1, (size_t)(points / fabsf(step)));
+
+			for (size_t i = 0; i < samples;)
+			{
+				size_t m = std::min(samples - i, perBlock);
+				float p0 = pos + i * step;
+				float p1 = pos + (i + m - 1) * step;
+
+				size_t first = (size_t)std::min(p0, p1) - Kernel::before;
+				size_t last = std::min(data.points16.size() - 1, (size_t)std::max(p0, p1) + Kernel::after);
+
+				for (size_t k = first; k <= last; ++k)
+					block[k - first] = data.points16[k] * data.scale;
+
+				mixRun<Kernel>(block, first, pos, step, i, i + m, left, right, volLeft, volRight);
+				i += m;
+			}
+		}
+
 		channel::channel(document* doc, short index)
 			: doc(doc)
 			, index(index) { }
@@ -153,6 +421,27 @@ namespace bb
 			}
 		}
 
+		void channel::trigger(const sample* s, float advance, float volume, float panning)
+		{
+			currentSample = s;
+			samplePosition = 0;
+			sampleAdvance = advance;
+			samplePingPong = true;
+			pitch = 0;
+
+			fadeoutVolume = 1;
+			envelopeVolumeValue = 1.0f;
+			envelopePanningValue = 0.5f;
+
+			setVolume(volume, panning);
+		}
+
+		void channel::setVolume(float volume, float panning)
+		{
+			this->volume = volume;
+			this->panning = panning;
+		}
+
 		void channel::cut() 
 		{
 			volume = 0;
@@ -212,89 +501,194 @@ namespace bb
 			}
 		}
 
-		void channel::mix(float* left, float* right, size_t samples)
+		void channel::mix(float* left, float* right, size_t samples, interpolation quality)
 		{
 			if (currentSample && samplePosition >= 0 && pitch < 97)
 			{
-				//float FinalVol = (FadeOutVol / 65536)*(EnvelopeVol / 64)*(GlobalVol / 64)*(Vol / 64)*Scale;
-				float finalVolume = fadeoutVolume * envelopeVolumeValue * volume;
-				float finalPanning = (panning - 0.5f) + (envelopePanningValue - 0.5f) * (0.5f - fabsf(panning - 0.5f));
-				float volLeft  = (0.5f - finalPanning)*finalVolume;
-				float volRight = (0.5f + finalPanning)*finalVolume;
+				const sample_data& data = currentSample->decode(doc ? doc->cache : nullptr);
+
+				float volLeft, volRight;
+				panVolumes(volLeft, volRight);
 
-				for (size_t i = 0; i < samples; ++i)
+				switch (quality)
 				{
-					if (samplePosition < 0)
+				case interpolation::Nearest: mixRuns<nearest_kernel>(data, left, right, samples, volLeft, volRight); break;
+				case interpolation::Linear:  mixRuns<linear_kernel>(data, left, right, samples, volLeft, volRight); break;
+				case interpolation::Cubic:   mixRuns<cubic_kernel>(data, left, right, samples, volLeft, volRight); break;
+				case interpolation::Sinc:
+					switch (sincBand(sampleAdvance))
 					{
-						continue;
+					case 0: mixRuns<sinc_kernel<0>>(data, left, right, samples, volLeft, volRight); break;
+					case 1: mixRuns<sinc_kernel<1>>(data, left, right, samples, volLeft, volRight); break;
+					case 2: mixRuns<sinc_kernel<2>>(data, left, right, samples, volLeft, volRight); break;
+					case 3: mixRuns<sinc_kernel<3>>(data, left, right, samples, volLeft, volRight); break;
+					case 4: mixRuns<sinc_kernel<4>>(data, left, right, samples, volLeft, volRight); break;
+					case 5: mixRuns<sinc_kernel<5>>(data, left, right, samples, volLeft, volRight); break;
+					default: mixRuns<sinc_kernel<6>>(data, left, right, samples, volLeft, volRight); break;
 					}
+					break;
+				}
+			}
+		}
 
-					size_t a = (size_t)samplePosition;
-					size_t b = a + 1;
-					float t = samplePosition - a;
-					float u = currentSample->samples[a];
-					float v = 0;
+		void channel::mixPerSample(float* left, float* right, size_t samples)
+		{
+			if (currentSample && samplePosition >= 0 && pitch < 97)
+			{
+				const sample_data& data = currentSample->decode(doc ? doc->cache : nullptr);
 
-					switch (currentSample->type & 0x3)
-					{
-					case 0: // no loop
-						v = (b >= currentSample->length) ? 0.0f : currentSample->samples[b];
+				float volLeft, volRight;
+				panVolumes(volLeft, volRight);
 
-						samplePosition += sampleAdvance;
-						if (samplePosition >= currentSample->length)
-							samplePosition = -1;
-						break;
+				for (size_t i = 0; i < samples && samplePosition >= 0; ++i)
+					mixSample(data, left[i], right[i], volLeft, volRight);
+			}
+		}
 
-					case 1: // forward loop
-						v = (b >= currentSample->loopEnd) ? currentSample->samples[currentSample->loopStart] : currentSample->samples[b];
+		void channel::panVolumes(float& volLeft, float& volRight) const
+		{
+			//float FinalVol = (FadeOutVol / 65536)*(EnvelopeVol / 64)*(GlobalVol / 64)*(Vol / 64)*Scale;
+			float finalVolume = fadeoutVolume * envelopeVolumeValue * volume;
+			float finalPanning = (panning - 0.5f) + (envelopePanningValue - 0.5f) * (0.5f - fabsf(panning - 0.5f));
+			volLeft  = (0.5f - finalPanning)*finalVolume;
+			volRight = (0.5f + finalPanning)*finalVolume;
+		}
 
-						samplePosition += sampleAdvance;
-						while (samplePosition >= currentSample->loopEnd)
-							samplePosition -= (currentSample->loopEnd - currentSample->loopStart);
-						break;
+		template <typename Kernel>
+		void channel::mixRuns(const sample_data& data, float* left, float* right, size_t samples, float volLeft, float volRight)
+		{
+			// runs between boundaries go through the interpolation kernel, the samples on
+			//  a boundary (loop wrap, ping-pong turn, end of sample) through mixSample
+			size_t i = 0;
+			while (i < samples && samplePosition >= 0)
+			{
+				size_t n = mixSpan(samples - i, Kernel::before, Kernel::after);
+				if (n)
+				{
+					// backwards interpolates one sample back like mixSample does, the fraction stays the same
+					bool backwards = (currentSample->type & 0x3) == 2 && !samplePingPong;
+					float start = backwards ? samplePosition - 1 : samplePosition;
+					float step = backwards ? -sampleAdvance : sampleAdvance;
 
-					case 2: // pingpong loop
-						if (samplePingPong)
-						{
-							v = (b >= currentSample->loopEnd) ? currentSample->samples[a] : currentSample->samples[b];
-							samplePosition += sampleAdvance;
-
-							if (samplePosition >= currentSample->loopEnd)
-							{
-								samplePingPong = false;
-								samplePosition = (currentSample->loopEnd * 2) - samplePosition;
-							}
-							if (samplePosition >= currentSample->length)
-							{
-								samplePingPong = false;
-								samplePosition = (float)(currentSample->length - 1);
-							}
-						}
-						else
-						{
-							v = u;
-							u = (b == 1 || b - 2 <= currentSample->loopStart) ? currentSample->samples[a] : currentSample->samples[b - 2];
-
-							samplePosition -= sampleAdvance;
-
-							if (samplePosition <= currentSample->loopStart)
-							{
-								samplePingPong = true;
-								samplePosition = (currentSample->loopStart * 2) - samplePosition;
-							}
-							if (samplePosition < 0)
-							{
-								samplePingPong = true;
-								samplePosition = 0;
-							}
-						}
-						break;
+					if (!data.points.empty())
+						mixRun<Kernel>(data.points.data(), 0, start, step, 0, n, left + i, right + i, volLeft, volRight);
+					else
+						mixRun16<Kernel>(data, start, step, n, left + i, right + i, volLeft, volRight);
+
+					samplePosition += n * step;
+					i += n;
+				}
+
+				if (i < samples)
+				{
+					mixSample(data, left[i], right[i], volLeft, volRight);
+					++i;
+				}
+			}
+		}
+
+		size_t channel::mixSpan(size_t samples, int before, int after) const
+		{
+			if (sampleAdvance <= 0) return 0;
+
+			size_t n;
+
+			if ((currentSample->type & 0x3) == 2 && !samplePingPong)
+			{
+				// backwards: the first tap one sample back must lie after the loop start, the last one inside
+				//  the sample, and the position after the run must not have reached the turn yet
+				float limit = (float)(currentSample->loopStart + 2 + before);
+				float end = (float)currentSample->loopStart;
+
+				if (samplePosition < limit || samplePosition - 1 + after >= currentSample->length) return 0;
+
+				n = std::min(samples, (size_t)((samplePosition - limit) / sampleAdvance) + 1);
+				while (n > 0 && (samplePosition - (n - 1) * sampleAdvance < limit || samplePosition - n * sampleAdvance <= end))
+					--n;
+			}
+			else
+			{
+				// forwards: the taps must lie inside the sample and before the loop end (or the sample end without
+				//  a loop), and the position after the run must not need a wrap, turn or stop yet
+				float end = (float)(((currentSample->type & 0x3) == 0) ? currentSample->length : currentSample->loopEnd);
+				float limit = end - after;
+
+				if (samplePosition >= limit || samplePosition < before) return 0;
+
+				n = std::min(samples, (size_t)((limit - samplePosition) / sampleAdvance) + 1);
+				while (n > 0 && (samplePosition + (n - 1) * sampleAdvance >= limit || samplePosition + n * sampleAdvance >= end))
+					--n;
+			}
+
+			return n;
+		}
+
+		void channel::mixSample(const sample_data& data, float& left, float& right, float volLeft, float volRight)
+		{
+			size_t a = (size_t)samplePosition;
+			size_t b = a + 1;
+			float t = samplePosition - a;
+			float u = data.at(a);
+			float v = 0;
+
+			switch (currentSample->type & 0x3)
+			{
+			case 0: // no loop
+				v = (b >= currentSample->length) ? 0.0f : data.at(b);
+
+				samplePosition += sampleAdvance;
+				if (samplePosition >= currentSample->length)
+					samplePosition = -1;
+				break;
+
+			case 1: // forward loop
+				v = (b >= currentSample->loopEnd) ? data.at(currentSample->loopStart) : data.at(b);
+
+				samplePosition += sampleAdvance;
+				while (samplePosition >= currentSample->loopEnd)
+					samplePosition -= (currentSample->loopEnd - currentSample->loopStart);
+				break;
+
+			case 2: // pingpong loop
+				if (samplePingPong)
+				{
+					v = (b >= currentSample->loopEnd) ? data.at(a) : data.at(b);
+					samplePosition += sampleAdvance;
+
+					if (samplePosition >= currentSample->loopEnd)
+					{
+						samplePingPong = false;
+						samplePosition = (currentSample->loopEnd * 2) - samplePosition;
+					}
+					if (samplePosition >= currentSample->length)
+					{
+						samplePingPong = false;
+						samplePosition = (float)(currentSample->length - 1);
 					}
-				
-					left[i]  += volLeft  * (u+(v-u)*t);
-					right[i] += volRight * (u+(v-u)*t);
 				}
+				else
+				{
+					v = u;
+					u = (b == 1 || b - 2 <= currentSample->loopStart) ? data.at(a) : data.at(b - 2);
+
+					samplePosition -= sampleAdvance;
+
+					if (samplePosition <= currentSample->loopStart)
+					{
+						samplePingPong = true;
+						samplePosition = (currentSample->loopStart * 2) - samplePosition;
+					}
+					if (samplePosition < 0)
+					{
+						samplePingPong = true;
+						samplePosition = 0;
+					}
+				}
+				break;
 			}
+		
+			left  += volLeft  * (u+(v-u)*t);
+			right += volRight * (u+(v-u)*t);
 		}
 
 		void channel::tick(const pattern* pat, player* play, const short row, const short tick, float* left, float* right, size_t samples)
@@ -347,16 +741,17 @@ namespace bb
 			if (tick % 3 == 1) period -= 64.0f * arp0;
 			if (tick % 3 == 2) period -= 64.0f * arp1;
 			sampleFrequency = 8363 * powf(2, (6 * 12 * 16 * 4 - period) / (12 * 16 * 4));
-			sampleAdvance = sampleFrequency / 44100.0f;
+			sampleAdvance = sampleFrequency / (float)play->sampleRate;
 			assert(sampleAdvance < 100);
 
-			mix(left, right, samples);
+			mix(left, right, samples, play->quality);
 		}
 
-		player::player(document* doc)
+		player::player(document* doc, int sampleRate)
 			: doc(doc) 
 			, currentBPM(doc->bpm)
 			, currentTempo(doc->tempo)
+			, sampleRate(sampleRate)
 		{ 
 			for (short i = 0; i < doc->channels; ++i)
 				channels.emplace_back(doc, i);
@@ -368,6 +763,42 @@ namespace bb
 		}
 		
 		void player::mix(short* buffer, size_t length)
+		{
+			mixInterleaved(buffer, length, [this](float x) { return (short)(x * 0x1fff * currentVolume); });
+		}
+
+		void player::mix(float* buffer, size_t length)
+		{
+			mixInterleaved(buffer, length, [this](float x) { return x * (0x1fff / 32768.0f) * currentVolume; });
+		}
+
+		void player::mixAdd(float* left, float* right, size_t frames, float volLeft, float volRight)
+		{
+			volLeft *= currentVolume;
+			volRight *= currentVolume;
+
+			while (frames)
+			{
+				if (samplesLeft == 0) tick();
+
+				size_t n = std::min(samplesLeft, frames);
+
+				for (size_t i = 0; i < n; ++i)
+				{
+					left[i] += gleft[i] * volLeft;
+					right[i] += gright[i] * volRight;
+				}
+				gleft = &gleft[n];
+				gright = &gright[n];
+				left += n;
+				right += n;
+				frames -= n;
+				samplesLeft -= n;
+			}
+		}
+
+		template <typename T, typename Convert>
+		void player::mixInterleaved(T* buffer, size_t length, Convert convert)
 		{
 			size_t samplesTodo = length / 2;
 			size_t offset = 0;
@@ -380,8 +811,8 @@ namespace bb
 
 				for (size_t i = 0; i < n; ++i)
 				{
-					buffer[offset + i * 2 + 0] = (short)(gleft[i] * 0x1fff * currentVolume);
-					buffer[offset + i * 2 + 1] = (short)(gright[i] * 0x1fff * currentVolume);
+					buffer[offset + i * 2 + 0] = convert(gleft[i]);
+					buffer[offset + i * 2 + 1] = convert(gright[i]);
 				}
 				gleft = &gleft[n];
 				gright = &gright[n];
@@ -403,7 +834,8 @@ namespace bb
 
 		void player::tick()
 		{
-			samplesLeft = 110250 / currentBPM;
+			// BPM * 2 / 5 ticks per second
+			samplesLeft = sampleRate * 5 / (2 * currentBPM);
 
 			if (currentPattern >= doc->length)
 				return;
@@ -422,7 +854,10 @@ namespace bb
 					currentTick = 0;
 					
 					if (currentPattern >= doc->length)
+					{
 						currentPattern = doc->restart_position;
+						loopCount++;
+					}
 				}
 
 				jumpToRow = 0xffff;
@@ -455,6 +890,10 @@ namespace bb
 
 				if (jumpToPattern < 0xffff)
 				{
+					// position jumps do not depend on any state, so jumping back means the song repeats
+					if (jumpToPattern <= currentPattern)
+						loopCount++;
+
 					currentPattern = jumpToPattern;
 					currentRow = 0;
 					currentTick = 0;
@@ -1,12 +1,20 @@
 #pragma once
 #include "xmfile.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define XM_SSE2
+#endif
+
 namespace bb
 {
 	namespace xm
 	{
 		class player;
 
+		// how samples are read between their points, in order of quality and cost
+		enum class interpolation { Nearest, Linear, Cubic, Sinc };
+
 		class channel
 		{
 		public:
@@ -38,11 +46,34 @@ namespace bb
 
 			void cut();
 
-			void mix(float* left, float* right, size_t samples);
+			void mix(float* left, float* right, size_t samples, interpolation quality = interpolation::Linear);
+
+			// linear, every sample through the boundary handling like the mixer before the runs; the reference
+			//  of runMixBenchmark
+			void mixPerSample(float* left, float* right, size_t samples);
+
+			// plays a sample without instrument, envelopes or note data, e.g. a one-shot sound effect
+			void trigger(const sample* s, float advance, float volume, float panning);
+
+			void setVolume(float volume, float panning);
+
+			bool playing() const { return currentSample && samplePosition >= 0; }
 
 			void tick(const pattern* pat, player* play, const short row, const short tick, float* left, float* right, size_t samples);
 
 		private:
+			// samples that can be mixed before the position reaches a loop boundary or the end of the sample
+			//  with before and after points of the interpolation around a position
+			size_t mixSpan(size_t samples, int before, int after) const;
+
+			template <typename Kernel>
+			void mixRuns(const sample_data& data, float* left, float* right, size_t samples, float volLeft, float volRight);
+
+			// one sample with the complete boundary handling
+			void mixSample(const sample_data& data, float& left, float& right, float volLeft, float volRight);
+
+			void panVolumes(float& volLeft, float& volRight) const;
+
 			document* doc;
 			short index;
 			
@@ -100,10 +131,19 @@ namespace bb
 		class player
 		{
 		public:
-			player(document* doc);
+			player(document* doc, int sampleRate = 44100);
 
+			// interleaved stereo, length counts values (two per frame)
 			void mix(short* buffer, size_t length);
 
+			// same levels as the short version divided by 32768
+			void mix(float* buffer, size_t length);
+
+			// adds frames to separate left and right buffers at the level of channel::mix, scaled by currentVolume
+			void mixAdd(float* left, float* right, size_t frames, float volLeft, float volRight);
+
+			size_t channelCount() const { return channels.size(); }
+
 			void jump(unsigned char pattern);
 
 			void patternBreak(unsigned char row);
@@ -116,10 +156,18 @@ namespace bb
 			int currentBPM;
 			int currentTempo;
 			float currentVolume = 1;
+			int sampleRate;
+			interpolation quality = interpolation::Linear;
+
+			// number of times the order list wrapped to the restart position
+			int loopCount = 0;
 
 		private:
 			void tick();
 
+			template <typename T, typename Convert>
+			void mixInterleaved(T* buffer, size_t length, Convert convert);
+
 			document* doc;
 
 			unsigned short jumpToPattern = 0xffff;
@@ -0,0 +1,628 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include "xmrender.h"
+
+namespace bb
+{
+	namespace xm
+	{
+		namespace
+		{
+			template <typename T>
+			void put(std::ostream& stream, T value)
+			{
+				stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+			}
+
+			template <typename T>
+			T get(std::istream& stream)
+			{
+				T value;
+				if (!stream.read(reinterpret_cast<char*>(&value), sizeof(T)))
+					throw std::exception("unexpected end of wav file");
+				return value;
+			}
+		}
+
+		void load(document& doc, const fs::path& file)
+		{
+			std::ifstream stream(file, std::ios::binary);
+			if (!stream)
+				throw std::exception("could not open xm file");
+
+			BinaryDeserializer in(stream);
+			doc.reflect(in);
+
+			if (!stream || memcmp(doc.head, "Extended Module: ", 17) != 0)
+				throw std::exception("not an xm file");
+		}
+
+		render_result render(document& doc, std::vector<float>& buffer, const render_options& options)
+		{
+			const size_t chunk = 1024;
+			const size_t maxFrames = (size_t)(options.maxSeconds * options.sampleRate);
+
+			render_result result;
+			result.sampleRate = options.sampleRate;
+
+			buffer.clear();
+
+			auto start = std::chrono::steady_clock::now();
+
+			player play(&doc, options.sampleRate);
+			play.quality = options.quality;
+			while (play.loopCount <= options.loops && result.frames < maxFrames)
+			{
+				size_t n = std::min(chunk, maxFrames - result.frames);
+				buffer.resize((result.frames + n) * 2);
+				play.mix(&buffer[result.frames * 2], n * 2);
+				result.frames += n;
+			}
+
+			result.renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return result;
+		}
+
+		render_result renderWav(document& doc, const fs::path& file, const render_options& options)
+		{
+			std::vector<float> buffer;
+			render_result result = render(doc, buffer, options);
+
+			std::ofstream stream(file, std::ios::binary);
+			if (!stream)
+				throw std::exception("could not create wav file");
+
+			writeWav(stream, buffer.data(), result.frames, result.sampleRate, options.format);
+			return result;
+		}
+
+		void writeWav(std::ostream& stream, const float* buffer, size_t frames, int sampleRate, wav_format format)
+		{
+			const bool pcm = format == wav_format::Pcm16;
+			const uint16_t bits = pcm ? 16 : 32;
+			const uint16_t blockAlign = 2 * bits / 8;
+			const uint32_t dataSize = (uint32_t)(frames * blockAlign);
+
+			// float data needs the extended fmt chunk and a fact chunk
+			const uint32_t fmtSize = pcm ? 16 : 18;
+			const uint32_t riffSize = 4 + (8 + fmtSize) + (pcm ? 0 : 12) + (8 + dataSize);
+
+			stream.write("RIFF", 4);
+			put<uint32_t>(stream, riffSize);
+			stream.write("WAVE", 4);
+
+			stream.write("fmt ", 4);
+			put<uint32_t>(stream, fmtSize);
+			put<uint16_t>(stream, pcm ? 1 : 3);
+			put<uint16_t>(stream, 2);
+			put<uint32_t>(stream, (uint32_t)sampleRate);
+			put<uint32_t>(stream, (uint32_t)sampleRate * blockAlign);
+			put<uint16_t>(stream, blockAlign);
+			put<uint16_t>(stream, bits);
+			if (!pcm)
+			{
+				put<uint16_t>(stream, 0);
+
+				stream.write("fact", 4);
+				put<uint32_t>(stream, 4);
+				put<uint32_t>(stream, (uint32_t)frames);
+			}
+
+			stream.write("data", 4);
+			put<uint32_t>(stream, dataSize);
+
+			if (pcm)
+			{
+				std::vector<int16_t> data(frames * 2);
+				for (size_t i = 0; i < data.size(); ++i)
+					data[i] = (int16_t)std::max(-32768.0f, std::min(32767.0f, std::round(buffer[i] * 32768.0f)));
+				stream.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(int16_t));
+			}
+			else
+			{
+				stream.write(reinterpret_cast<const char*>(buffer), frames * 2 * sizeof(float));
+			}
+
+			if (!stream)
+				throw std::exception("could not write wav file");
+		}
+
+		int readWav(std::istream& stream, std::vector<float>& buffer)
+		{
+			char id[4];
+
+			stream.read(id, 4);
+			get<uint32_t>(stream);
+			if (memcmp(id, "RIFF", 4) != 0 || !stream.read(id, 4) || memcmp(id, "WAVE", 4) != 0)
+				throw std::exception("not a wav file");
+
+			uint16_t tag = 0;
+			uint16_t bits = 0;
+			uint32_t sampleRate = 0;
+
+			while (stream.read(id, 4))
+			{
+				uint32_t size = get<uint32_t>(stream);
+
+				if (memcmp(id, "fmt ", 4) == 0)
+				{
+					tag = get<uint16_t>(stream);
+					uint16_t channels = get<uint16_t>(stream);
+					sampleRate = get<uint32_t>(stream);
+					get<uint32_t>(stream);
+					get<uint16_t>(stream);
+					bits = get<uint16_t>(stream);
+					stream.ignore(size - 16);
+
+					if (channels != 2 || !((tag == 1 && bits == 16) || (tag == 3 && bits == 32)))
+						throw std::exception("unsupported wav format, expected 16 bit PCM or 32 bit float stereo");
+				}
+				else if (memcmp(id, "data", 4) == 0)
+				{
+					if (!tag)
+						throw std::exception("wav data before format");
+
+					buffer.resize(size / (bits / 8));
+					if (tag == 1)
+					{
+						std::vector<int16_t> data(buffer.size());
+						stream.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(int16_t));
+						for (size_t i = 0; i < data.size(); ++i)
+							buffer[i] = data[i] / 32768.0f;
+					}
+					else
+					{
+						stream.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(float));
+					}
+
+					if (!stream)
+						throw std::exception("unexpected end of wav file");
+					return (int)sampleRate;
+				}
+				else
+				{
+					// chunks are padded to an even size
+					stream.ignore(size + (size & 1));
+				}
+			}
+
+			throw std::exception("wav file without data");
+		}
+
+		float compareRenders(const std::vector<float>& a, const std::vector<float>& b)
+		{
+			float difference = 0;
+			for (size_t i = 0; i < std::max(a.size(), b.size()); ++i)
+			{
+				float x = i < a.size() ? a[i] : 0.0f;
+				float y = i < b.size() ? b[i] : 0.0f;
+				difference = std::max(difference, fabsf(x - y));
+			}
+			return difference;
+		}
+
+		double benchmark_report::seconds() const
+		{
+			double total = 0;
+			for (auto& e : entries) total += e.result.seconds();
+			return total;
+		}
+
+		double benchmark_report::renderMs() const
+		{
+			double total = 0;
+			for (auto& e : entries) total += e.result.renderMs;
+			return total;
+		}
+
+		void benchmark_report::print(std::ostream& out) const
+		{
+			for (auto& e : entries)
+			{
+				out << e.name << ": " << e.result.seconds() << " s in " << e.result.renderMs << " ms, "
+					<< e.result.realtimeFactor() << "x realtime, ";
+				if (e.difference < 0) out << "reference written\n";
+				else out << "max difference " << e.difference << "\n";
+			}
+
+			double ms = renderMs();
+			out << "total: " << seconds() << " s in " << ms << " ms, " << (ms > 0 ? seconds() * 1000.0 / ms : 0) << "x realtime\n";
+		}
+
+		namespace
+		{
+			// compares a render with reference, or writes it when it is missing and recording.
+			//  returns false when the reference is missing and not recording
+			bool checkReference(benchmark_report::entry& e, std::vector<float>& buffer, const fs::path& reference, const render_options& options, reference_mode mode)
+			{
+				if (fs::exists(reference))
+				{
+					std::ifstream stream(reference, std::ios::binary);
+					std::vector<float> expected;
+					if (readWav(stream, expected) != options.sampleRate)
+						throw std::exception("reference render has a different sample rate");
+
+					// compare at the precision of the reference
+					if (options.format == wav_format::Pcm16)
+						for (float& x : buffer) x = std::max(-32768.0f, std::min(32767.0f, std::round(x * 32768.0f))) / 32768.0f;
+
+					e.difference = compareRenders(buffer, expected);
+					return true;
+				}
+
+				if (mode == reference_mode::Verify)
+					return false;
+
+				fs::create_directories(reference.parent_path());
+				std::ofstream stream(reference, std::ios::binary);
+				writeWav(stream, buffer.data(), e.result.frames, e.result.sampleRate, options.format);
+				e.difference = -1;
+				return true;
+			}
+		}
+
+		benchmark_report runBenchmark(const fs::path& corpus, const fs::path& references, const render_options& options, float tolerance, reference_mode mode)
+		{
+			benchmark_report report;
+
+			std::vector<fs::path> files;
+			for (auto& item : fs::directory_iterator(corpus))
+			{
+				std::string extension = item.path().extension().string();
+				std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+				if (extension == ".xm")
+					files.push_back(item.path());
+			}
+			std::sort(files.begin(), files.end());
+
+			if (files.empty())
+				throw std::exception("no .xm files in the corpus");
+
+			std::string failed, missing;
+			for (auto& file : files)
+			{
+				document doc;
+				load(doc, file);
+
+				benchmark_report::entry e;
+				e.name = file.filename().string();
+
+				std::vector<float> buffer;
+				e.result = render(doc, buffer, options);
+
+				fs::path reference = references / file.filename().replace_extension(".wav");
+				if (!checkReference(e, buffer, reference, options, mode))
+					missing += " " + e.name;
+				else if (e.difference > tolerance)
+					failed += " " + e.name;
+
+				report.entries.push_back(e);
+			}
+
+			if (!missing.empty())
+				throw std::exception(("no reference render for:" + missing).c_str());
+			if (!failed.empty())
+				throw std::exception(("render differs from reference:" + failed).c_str());
+
+			return report;
+		}
+
+		void makeTestSong(document& doc)
+		{
+			doc = document();
+			memcpy(doc.head, "Extended Module: ", 17);
+			memcpy(doc.track_name, "test song", 9);
+			doc.magic_id = 0x1a;
+			doc.tracker_major = 4;
+			doc.tracker_minor = 1;
+			doc.header_size = 276;
+			doc.length = 2;
+			doc.channels = 4;
+			doc.patternCount = 2;
+			doc.instrumentCount = 3;
+			doc.flags = 1;
+			doc.tempo = 4;
+			doc.bpm = 125;
+			doc.pattern_order[0] = 0;
+			doc.pattern_order[1] = 1;
+
+			// raw data is delta coded like in a file
+			auto makeSample = [](sample& s, const std::vector<int>& points, bool sixteenBit, unsigned char loop, unsigned loopStart)
+			{
+				s = sample();
+				s.volume = 64;
+				s.pan = 128;
+				s.type = loop | (sixteenBit ? 0x10 : 0);
+				s.length = (unsigned)points.size();
+				s.loopStart = loopStart;
+				s.loopEnd = s.length;
+				s.loopLength = (s.loopEnd - s.loopStart) * (sixteenBit ? 2 : 1);
+
+				int previous = 0;
+				for (int p : points)
+				{
+					int16_t delta = (int16_t)(p - previous);
+					previous = p;
+					if (sixteenBit)
+					{
+						s.data.push_back((char)(delta & 0xff));
+						s.data.push_back((char)(delta >> 8));
+					}
+					else
+					{
+						s.data.push_back((char)delta);
+					}
+				}
+			};
+
+			auto makeInstrument = [](instrument& ins)
+			{
+				ins = instrument();
+				ins.length = 263;
+				ins.instrumentSampleCount = 1;
+				ins.instrumentSampleHeaderLength = 40;
+				ins.instrumentSamples.resize(1);
+			};
+
+			doc.instruments.resize(doc.instrumentCount);
+			for (auto& ins : doc.instruments)
+				makeInstrument(ins);
+
+			std::vector<int> points;
+
+			// 1: 8 bit forward loop, a single cycle with an overtone, attack and decay envelope
+			for (int i = 0; i < 64; ++i)
+				points.push_back((int)std::round(90 * sin(i * 6.2831853 / 64) + 25 * sin(i * 3 * 6.2831853 / 64)));
+			makeSample(doc.instruments[0].instrumentSamples[0], points, false, 1, 0);
+			envelope& volume = doc.instruments[0].volume;
+			volume.type = 1;
+			volume.pointCount = 4;
+			volume.points[0] = { 0, 0 };
+			volume.points[1] = { 3, 64 };
+			volume.points[2] = { 12, 32 };
+			volume.points[3] = { 40, 48 };
+			doc.instruments[0].volumeFadeout = 0x400;
+
+			// 2: 16 bit ping-pong loop over the second half, two cycles with a little noise
+			points.clear();
+			uint32_t noise = 1;
+			for (int i = 0; i < 200; ++i)
+			{
+				noise = noise * 1664525 + 1013904223;
+				points.push_back((int)std::round(20000 * sin(i * 6.2831853 / 100)) + (int)(noise >> 22) - 512);
+			}
+			makeSample(doc.instruments[1].instrumentSamples[0], points, true, 2, 100);
+
+			// 3: 8 bit one shot, decaying noise
+			points.clear();
+			for (int i = 0; i < 1500; ++i)
+			{
+				noise = noise * 1664525 + 1013904223;
+				points.push_back((int)(((int)(noise >> 24) - 128) * (1500 - i) / 1500));
+			}
+			makeSample(doc.instruments[2].instrumentSamples[0], points, false, 0, 0);
+
+			// pitch 49 plays a sample at 8363 Hz, 97 releases the note
+			struct event { int pattern, row, channel; unsigned char pitch, instrument, volume, effect, parameter; };
+			static const event events[] =
+			{
+				{ 0, 0, 0, 49, 1, 0,    0x00, 0x47 },   // arpeggio
+				{ 0, 0, 1, 37, 2, 0x30, 0,    0 },
+				{ 0, 1, 1, 0,  0, 0,    0x04, 0x46 },   // vibrato
+				{ 0, 1, 2, 56, 2, 0,    0,    0 },
+				{ 0, 2, 3, 61, 1, 0,    0x0c, 0x20 },   // set volume
+				{ 0, 3, 1, 0,  0, 0,    0x0a, 0x02 },   // volume slide
+				{ 0, 3, 2, 61, 0, 0,    0x03, 0x10 },   // tone portamento
+				{ 0, 4, 0, 53, 1, 0,    0x01, 0x08 },   // portamento up
+				{ 0, 4, 3, 73, 2, 0,    0,    0 },      // above the output rate
+				{ 0, 5, 1, 44, 2, 0,    0x08, 0x20 },   // panning
+				{ 0, 6, 0, 97, 0, 0,    0,    0 },
+				{ 0, 6, 2, 0,  0, 0,    0x02, 0x04 },   // portamento down
+				{ 0, 7, 1, 0,  0, 0,    0x0c, 0x30 },
+				{ 1, 0, 0, 25, 3, 0,    0,    0 },
+				{ 1, 0, 1, 49, 2, 0,    0x00, 0x37 },
+				{ 1, 1, 2, 85, 1, 0x28, 0,    0 },
+				{ 1, 2, 3, 61, 3, 0,    0x09, 0x02 },   // sample offset
+				{ 1, 3, 0, 37, 3, 0,    0,    0 },
+				{ 1, 4, 1, 97, 0, 0,    0,    0 },
+				{ 1, 4, 2, 0,  0, 0,    0x0a, 0x40 },
+				{ 1, 5, 3, 68, 2, 0,    0x04, 0x8f },
+				{ 1, 6, 0, 49, 1, 0,    0x0e, 0x12 },   // fine portamento up
+				{ 1, 7, 2, 97, 0, 0,    0,    0 },
+			};
+
+			doc.patterns.resize(2, pattern(doc.channels));
+			for (auto& p : doc.patterns)
+			{
+				p.length = 9;
+				p.packType = 0;
+				p.rowCount = 8;
+				p.dataSize = 1;
+				p.rows.resize(p.rowCount, row(doc.channels));
+				for (auto& r : p.rows)
+					r.notes.resize(doc.channels);
+			}
+
+			for (auto& e : events)
+			{
+				note& n = doc.patterns[e.pattern].rows[e.row].notes[e.channel];
+				n.pitch = e.pitch;
+				n.instrument = e.instrument;
+				n.volume = e.volume;
+				n.effect = e.effect;
+				n.effectParameter = e.parameter;
+			}
+		}
+
+		benchmark_report runGoldenTest(const fs::path& references, float tolerance, reference_mode mode)
+		{
+			static const char* names[] = { "nearest", "linear", "cubic", "sinc" };
+
+			benchmark_report report;
+
+			document doc;
+			makeTestSong(doc);
+
+			std::string failed, missing;
+			for (auto quality : { interpolation::Nearest, interpolation::Linear, interpolation::Cubic, interpolation::Sinc })
+			{
+				render_options options;
+				options.sampleRate = 11025;
+				options.quality = quality;
+
+				benchmark_report::entry e;
+				e.name = std::string("test_song_") + names[(int)quality];
+
+				std::vector<float> buffer;
+				e.result = render(doc, buffer, options);
+
+				if (!checkReference(e, buffer, references / (e.name + ".wav"), options, mode))
+					missing += " " + e.name;
+				else if (e.difference > tolerance)
+					failed += " " + e.name;
+
+				report.entries.push_back(e);
+			}
+
+			if (!missing.empty())
+				throw std::exception(("no reference render for:" + missing).c_str());
+			if (!failed.empty())
+				throw std::exception(("render differs from reference:" + failed).c_str());
+
+			return report;
+		}
+
+		void quality_report::print(std::ostream& out) const
+		{
+			static const char* names[] = { "nearest", "linear", "cubic", "sinc" };
+
+			for (auto& e : entries)
+			{
+				out << e.sampleRate << " Hz " << names[(int)e.quality] << ": " << e.result.renderMs << " ms, "
+					<< e.result.realtimeFactor() << "x realtime\n";
+			}
+		}
+
+		void mix_report::print(std::ostream& out) const
+		{
+			static const char* names[] = { "nearest", "linear", "cubic", "sinc" };
+
+			out << channels << " channels, " << ticks << " ticks of " << frames << " frames\n";
+			out << "per sample: " << perSampleMs << " ms\n";
+			for (int q = 0; q < 4; ++q)
+				out << names[q] << " runs: " << runMs[q] << " ms\n";
+			out << "linear runs " << speedup() << "x faster than per sample, max difference " << difference << "\n";
+		}
+
+		mix_report runMixBenchmark(unsigned channels, size_t frames, unsigned ticks)
+		{
+			mix_report report;
+			report.channels = channels;
+			report.frames = frames;
+			report.ticks = ticks;
+
+			// samples of a few thousand points, looping over their second half
+			std::mt19937 random(1);
+
+			std::vector<sample> samples(channels);
+			std::vector<float> advances(channels);
+			for (unsigned c = 0; c < channels; ++c)
+			{
+				sample& s = samples[c];
+				s = sample();
+				s.length = 4000 + (unsigned)(random() % 16000);
+				s.loopStart = s.length / 2;
+				s.loopLength = s.length - s.loopStart;
+				s.loopEnd = s.length;
+				s.type = 1;
+
+				auto data = std::make_shared<sample_data>();
+				data->points.resize(s.length);
+				for (unsigned i = 0; i < s.length; ++i)
+					data->points[i] = 0.6f * sinf(i * 0.05f) + 0.3f * sinf(i * 0.011f);
+				s.samples = data;
+
+				// rates of 0.25 to 2 in steps exact in float, so accumulated positions are exact too
+				advances[c] = (16 + random() % 112) / 64.0f;
+			}
+
+			std::vector<channel> mixers(channels, channel(nullptr, 0));
+			std::vector<float> left(frames), right(frames);
+
+			// best of five, every pass starts all channels at their beginning
+			auto run = [&](auto mix)
+			{
+				double best = 0;
+				for (int pass = 0; pass < 5; ++pass)
+				{
+					for (unsigned c = 0; c < channels; ++c)
+						mixers[c].trigger(&samples[c], advances[c], 0.5f, (float)c / channels);
+
+					auto start = std::chrono::steady_clock::now();
+					for (unsigned t = 0; t < ticks; ++t)
+					{
+						std::fill(left.begin(), left.end(), 0.0f);
+						std::fill(right.begin(), right.end(), 0.0f);
+						for (auto& m : mixers)
+							mix(m);
+					}
+					double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+					best = pass ? std::min(best, ms) : ms;
+				}
+				return best;
+			};
+
+			report.perSampleMs = run([&](channel& m) { m.mixPerSample(left.data(), right.data(), frames); });
+			for (auto quality : { interpolation::Nearest, interpolation::Linear, interpolation::Cubic, interpolation::Sinc })
+				report.runMs[(int)quality] = run([&](channel& m) { m.mix(left.data(), right.data(), frames, quality); });
+
+			// with exact steps the mixers give the same results apart from the order of the additions
+			std::vector<float> expected(frames), mixed(frames), scratch(frames);
+			for (unsigned c = 0; c < channels; ++c)
+			{
+				mixers[c].trigger(&samples[c], advances[c], 0.5f, (float)c / channels);
+				mixers[c].mixPerSample(expected.data(), scratch.data(), frames);
+				mixers[c].trigger(&samples[c], advances[c], 0.5f, (float)c / channels);
+				mixers[c].mix(mixed.data(), scratch.data(), frames, interpolation::Linear);
+			}
+			for (size_t i = 0; i < frames; ++i)
+				report.difference = std::max(report.difference, fabsf(mixed[i] - expected[i]));
+
+			if (report.difference > 1e-5f)
+				throw std::exception("linear runs differ from the per sample mixer");
+
+			return report;
+		}
+
+		quality_report runQualityBenchmark(const fs::path& file, const std::vector<int>& sampleRates)
+		{
+			quality_report report;
+
+			document doc;
+			load(doc, file);
+
+			std::vector<float> buffer;
+			for (int sampleRate : sampleRates)
+			{
+				for (auto quality : { interpolation::Nearest, interpolation::Linear, interpolation::Cubic, interpolation::Sinc })
+				{
+					render_options options;
+					options.sampleRate = sampleRate;
+					options.quality = quality;
+
+					quality_report::entry e;
+					e.sampleRate = sampleRate;
+					e.quality = quality;
+					e.result = render(doc, buffer, options);
+					report.entries.push_back(e);
+				}
+			}
+
+			return report;
+		}
+	}
+}
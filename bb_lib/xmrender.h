@@ -0,0 +1,127 @@
+#pragma once
+
+#include <ostream>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "xmplay.h"
+
+namespace bb
+{
+	namespace xm
+	{
+		enum class wav_format { Pcm16, Float32 };
+
+		struct render_options
+		{
+			int           sampleRate = 44100;
+			interpolation quality    = interpolation::Linear;
+			wav_format    format     = wav_format::Pcm16;
+			double        maxSeconds = 600;   // songs that never reach their end are cut here
+			int           loops      = 0;     // repeats of the song after the first pass
+		};
+
+		struct render_result
+		{
+			size_t frames = 0;
+			int    sampleRate = 0;
+			double renderMs = 0;
+
+			double seconds() const { return (double)frames / sampleRate; }
+
+			// seconds of audio per second of rendering
+			double realtimeFactor() const { return renderMs > 0 ? seconds() * 1000.0 / renderMs : 0; }
+		};
+
+		// reads an XM file, throws when it is not one
+		void load(document& doc, const fs::path& file);
+
+		// renders the whole song with a new player, interleaved stereo with the levels of player::mix(float*)
+		render_result render(document& doc, std::vector<float>& buffer, const render_options& options = render_options());
+
+		render_result renderWav(document& doc, const fs::path& file, const render_options& options = render_options());
+
+		// interleaved stereo, 16 bit values are scaled by 32768 and clipped
+		void writeWav(std::ostream& stream, const float* buffer, size_t frames, int sampleRate, wav_format format);
+
+		// 16 bit PCM or 32 bit float stereo, returns the sample rate
+		int readWav(std::istream& stream, std::vector<float>& buffer);
+
+		// largest difference of two interleaved renders, a missing tail counts as silence on the other side
+		float compareRenders(const std::vector<float>& a, const std::vector<float>& b);
+
+		//------------------------------------------------------------------------------------------------------------
+		// Renders every .xm file in corpus and compares it with <name>.wav in references. Throws when a render
+		//  differs by more than tolerance, and by default when a reference is missing. Record writes missing
+		//  references instead; record them with a mixer the output is known to be right for, not the one under test.
+		enum class reference_mode { Verify, Record };
+
+		struct benchmark_report
+		{
+			struct entry
+			{
+				std::string   name;
+				render_result result;
+				float         difference = 0;   // against the reference, -1 when the reference was just written
+			};
+
+			std::vector<entry> entries;
+
+			double seconds() const;
+			double renderMs() const;
+
+			void print(std::ostream& out) const;
+		};
+
+		benchmark_report runBenchmark(const fs::path& corpus, const fs::path& references, const render_options& options = render_options(), float tolerance = 1.0f / 4096, reference_mode mode = reference_mode::Verify);
+
+		// A song of about a second built in code, no file needed: looping 8 and 16 bit and one shot samples,
+		//  an envelope and the common effects on four channels.
+		void makeTestSong(document& doc);
+
+		// Renders the test song at 11025 Hz with every interpolation and compares the renders with
+		//  test_song_<interpolation>.wav in references, the ones in bb_lib/xm_reference are checked in.
+		//  Throws like runBenchmark. The tolerance covers float differences between compilers.
+		benchmark_report runGoldenTest(const fs::path& references, float tolerance = 1.0f / 4096, reference_mode mode = reference_mode::Verify);
+
+		//------------------------------------------------------------------------------------------------------------
+		// Render cost of one module at every combination of output rate and interpolation.
+		struct quality_report
+		{
+			struct entry
+			{
+				int           sampleRate;
+				interpolation quality;
+				render_result result;
+			};
+
+			std::vector<entry> entries;
+
+			void print(std::ostream& out) const;
+		};
+
+		quality_report runQualityBenchmark(const fs::path& file, const std::vector<int>& sampleRates = { 22050, 44100, 48000, 96000 });
+
+		//------------------------------------------------------------------------------------------------------------
+		// Cost of channel::mix for channels playing forward looping samples at random rates, in ticks of frames,
+		//  against mixing every sample through the boundary handling (channel::mixPerSample). Throws when the
+		//  linear runs give other results in the first tick.
+		struct mix_report
+		{
+			unsigned channels = 0;
+			size_t   frames = 0;        // per tick
+			unsigned ticks = 0;
+
+			double   perSampleMs = 0;
+			double   runMs[4] = {};     // by interpolation
+			float    difference = 0;    // largest of linear runs against per sample, first tick
+
+			double speedup() const { return runMs[1] > 0 ? perSampleMs / runMs[1] : 0; }
+
+			void print(std::ostream& out) const;
+		};
+
+		mix_report runMixBenchmark(unsigned channels = 32, size_t frames = 2205, unsigned ticks = 200);
+	}
+}
@@ -0,0 +1,258 @@
+#include <chrono>
+#include <cmath>
+#include <random>
+#include "xmstream.h"
+#include "xmrender.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+namespace bb
+{
+	namespace xm
+	{
+		stream::stream(document* doc, const stream_options& options)
+			: doc(doc)
+			, play(doc, options.sampleRate)
+			, options(options)
+			, output((options.latency + options.block) * 2)
+			, commands(256)
+			, scratch(options.block * 2)
+		{
+			play.quality = options.quality;
+		}
+
+		stream::~stream()
+		{
+			stop();
+		}
+
+		void stream::start()
+		{
+			if (running) return;
+
+			// the mixer thread must not be the first to decode a sample
+			doc->decodeAll();
+
+			// the consumer may start reading right away, so the first latency is rendered here
+			while (framesBuffered() + options.block <= options.latency)
+			{
+				play.mix(scratch.data(), scratch.size());
+				output.write(scratch.data(), scratch.size());
+			}
+
+			running = true;
+			thread = std::thread(&stream::run, this);
+		}
+
+		void stream::stop()
+		{
+			running = false;
+			if (thread.joinable())
+				thread.join();
+		}
+
+		size_t stream::read(float* buffer, size_t frames)
+		{
+			size_t n = output.read(buffer, frames * 2) / 2;
+			if (n < frames)
+			{
+				std::fill(buffer + n * 2, buffer + frames * 2, 0.0f);
+				if (running.load(std::memory_order_relaxed))
+					underrunCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			return n;
+		}
+
+		size_t stream::read(short* buffer, size_t frames)
+		{
+			float chunk[512];
+			size_t total = 0;
+
+			for (size_t done = 0; done < frames;)
+			{
+				size_t n = std::min(frames - done, sizeof(chunk) / sizeof(float) / 2);
+				total += read(chunk, n);
+
+				for (size_t i = 0; i < n * 2; ++i)
+					buffer[done * 2 + i] = (short)std::max(-32768.0f, std::min(32767.0f, chunk[i] * 32768.0f));
+				done += n;
+			}
+			return total;
+		}
+
+		void stream::jump(unsigned char pattern)
+		{
+			send({ command::Jump, pattern, 0 });
+		}
+
+		void stream::patternBreak(unsigned char row)
+		{
+			send({ command::PatternBreak, row, 0 });
+		}
+
+		void stream::volume(float volume)
+		{
+			send({ command::Volume, 0, volume });
+		}
+
+		void stream::solo(int channel)
+		{
+			send({ command::Solo, channel, 0 });
+		}
+
+		void stream::send(const command& c)
+		{
+			if (running)
+			{
+				// the render thread empties the queue between blocks
+				while (!commands.push(c))
+					std::this_thread::yield();
+			}
+			else
+			{
+				// without a render thread the player is ours, keep the order of anything still queued
+				command queued;
+				while (commands.pop(queued))
+					apply(queued);
+				apply(c);
+			}
+		}
+
+		void stream::apply(const command& c)
+		{
+			switch (c.type)
+			{
+			case command::Jump:         play.jump((unsigned char)c.value); break;
+			case command::PatternBreak: play.patternBreak((unsigned char)c.value); break;
+			case command::Volume:       play.currentVolume = c.volume; break;
+			case command::Solo:         play.chan(c.value); break;
+			}
+		}
+
+		void stream::run()
+		{
+#ifdef _WIN32
+			SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#endif
+
+			// wake up four times per latency, the Windows scheduler granularity is far below a default latency
+			const auto wait = std::chrono::microseconds((long long)(options.latency * 250000.0 / options.sampleRate));
+
+			while (running)
+			{
+				while (framesBuffered() + options.block <= options.latency)
+				{
+					command c;
+					while (commands.pop(c))
+						apply(c);
+
+					play.mix(scratch.data(), scratch.size());
+					output.write(scratch.data(), scratch.size());
+				}
+
+				std::this_thread::sleep_for(wait);
+			}
+		}
+
+		void stream_stress_report::print(std::ostream& out) const
+		{
+			out << frames << " frames in " << reads << " reads, " << commands << " commands, "
+				<< underruns << " underruns, lowest fill " << minBuffered << " frames\n";
+		}
+
+		stream_stress_report runStreamStress(document& doc, double seconds, unsigned loadThreads, const stream_options& options)
+		{
+			stream_stress_report report;
+
+			const size_t total = (size_t)(seconds * options.sampleRate);
+			const size_t half = total / 2;
+			const size_t period = options.block;
+
+			// what the first half has to sound like
+			std::vector<float> expected;
+			render_options offline;
+			offline.sampleRate = options.sampleRate;
+			offline.quality = options.quality;
+			offline.maxSeconds = seconds / 2 + 1;
+			offline.loops = 1 << 30;
+			render(doc, expected, offline);
+			expected.resize(half * 2);
+
+			std::atomic<bool> loading{ true };
+			std::vector<std::thread> load;
+			for (unsigned i = 0; i < loadThreads; ++i)
+			{
+				load.emplace_back([&loading]
+				{
+					volatile double x = 1;
+					while (loading.load(std::memory_order_relaxed))
+						x = sqrt(x + 1.0);
+				});
+			}
+
+			std::vector<float> received;
+			received.reserve(half * 2);
+			std::vector<float> buffer(period * 2);
+
+			std::mt19937 random(1);
+			report.minBuffered = options.latency;
+
+			stream s(&doc, options);
+			s.start();
+
+			// a device consumes frames at the sample rate, so a late consumer catches up with several reads
+			auto start = std::chrono::steady_clock::now();
+			while (report.frames < total)
+			{
+				double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				size_t due = (size_t)(elapsed * options.sampleRate) + period;
+				size_t n = std::min(period, total - report.frames);
+
+				if (due < report.frames + n)
+				{
+					std::this_thread::sleep_for(std::chrono::microseconds((long long)(period * 250000.0 / options.sampleRate)));
+					continue;
+				}
+
+				report.minBuffered = std::min(report.minBuffered, s.framesBuffered());
+				s.read(buffer.data(), n);
+				report.reads++;
+
+				if (report.frames < half)
+				{
+					size_t keep = std::min(n, half - report.frames);
+					received.insert(received.end(), buffer.begin(), buffer.begin() + keep * 2);
+				}
+				else
+				{
+					switch (random() % 4)
+					{
+					case 0: s.jump((unsigned char)(random() % doc.length)); break;
+					case 1: s.patternBreak(0); break;
+					case 2: s.volume((random() % 100) / 100.0f); break;
+					case 3: s.solo((int)(random() % (doc.channels + 1)) - 1); break;
+					}
+					report.commands++;
+				}
+
+				report.frames += n;
+			}
+
+			s.stop();
+			report.underruns = s.underruns();
+
+			loading = false;
+			for (auto& t : load)
+				t.join();
+
+			if (received != expected)
+				throw std::exception("streamed output differs from the offline render");
+			if (report.underruns)
+				throw std::exception("stream underrun");
+
+			return report;
+		}
+	}
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "xmplay.h"
+
+namespace bb
+{
+	namespace xm
+	{
+		// Lock-free queue for exactly one producer and one consumer thread, capacity is rounded up to a power of two.
+		template <typename T>
+		class spsc_ring
+		{
+		public:
+			spsc_ring(size_t capacity)
+			{
+				size_t size = 1;
+				while (size < capacity) size *= 2;
+				items.resize(size);
+				mask = size - 1;
+			}
+
+			size_t capacity() const { return items.size(); }
+
+			// producer side
+			size_t writable() const { return items.size() - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire)); }
+
+			size_t write(const T* data, size_t count)
+			{
+				size_t h = head.load(std::memory_order_relaxed);
+				count = std::min(count, items.size() - (h - tail.load(std::memory_order_acquire)));
+
+				for (size_t i = 0; i < count; ++i)
+					items[(h + i) & mask] = data[i];
+
+				head.store(h + count, std::memory_order_release);
+				return count;
+			}
+
+			bool push(const T& item) { return write(&item, 1) == 1; }
+
+			// consumer side
+			size_t readable() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed); }
+
+			size_t read(T* data, size_t count)
+			{
+				size_t t = tail.load(std::memory_order_relaxed);
+				count = std::min(count, head.load(std::memory_order_acquire) - t);
+
+				for (size_t i = 0; i < count; ++i)
+					data[i] = items[(t + i) & mask];
+
+				tail.store(t + count, std::memory_order_release);
+				return count;
+			}
+
+			bool pop(T& item) { return read(&item, 1) == 1; }
+
+		private:
+			std::vector<T> items;
+			size_t         mask;
+
+			// written by one side each, kept on separate cache lines
+			alignas(64) std::atomic<size_t> head{ 0 };
+			alignas(64) std::atomic<size_t> tail{ 0 };
+		};
+
+		struct stream_options
+		{
+			int           sampleRate = 44100;
+			interpolation quality    = interpolation::Linear;
+			size_t        latency    = 4096;   // frames rendered ahead of the consumer
+			size_t        block      = 256;    // frames rendered at a time
+		};
+
+		// Plays a document on its own thread into a ring buffer, read() is meant for the audio callback and never
+		//  blocks. Control calls go through a command queue and are applied by the render thread between blocks,
+		//  so they must come from one thread (usually the game thread).
+		class stream
+		{
+		public:
+			stream(document* doc, const stream_options& options = stream_options());
+			~stream();
+
+			stream(const stream&) = delete;
+			stream& operator=(const stream&) = delete;
+
+			void start();
+			void stop();
+
+			// interleaved stereo, missing frames are filled with silence and counted as an underrun
+			size_t read(float* buffer, size_t frames);
+			size_t read(short* buffer, size_t frames);
+
+			void jump(unsigned char pattern);
+			void patternBreak(unsigned char row);
+			void volume(float volume);
+			void solo(int channel);   // -1 plays all channels
+
+			size_t underruns() const     { return underrunCount.load(std::memory_order_relaxed); }
+			size_t framesBuffered() const { return output.readable() / 2; }
+
+		private:
+			struct command
+			{
+				enum type_t { Jump, PatternBreak, Volume, Solo };
+
+				type_t type;
+				int    value;
+				float  volume;
+			};
+
+			void run();
+			void send(const command& c);
+			void apply(const command& c);
+
+			document*           doc;
+			player              play;
+			stream_options      options;
+
+			spsc_ring<float>    output;
+			spsc_ring<command>  commands;
+			std::vector<float>  scratch;
+
+			std::thread         thread;
+			std::atomic<bool>   running{ false };
+			std::atomic<size_t> underrunCount{ 0 };
+		};
+
+		//------------------------------------------------------------------------------------------------------------
+		// Plays a document through a stream while loadThreads threads keep the CPU busy and a consumer reads in
+		//  periods like an audio device. The first half must match an offline render exactly, the second half sends
+		//  a storm of control commands. Throws on a mismatch or an underrun.
+		struct stream_stress_report
+		{
+			size_t frames = 0;
+			size_t reads = 0;
+			size_t commands = 0;
+			size_t underruns = 0;
+			size_t minBuffered = 0;   // lowest fill level the consumer saw, in frames
+
+			void print(std::ostream& out) const;
+		};
+
+		stream_stress_report runStreamStress(document& doc, double seconds = 10, unsigned loadThreads = 0, const stream_options& options = stream_options());
+	}
+}
@@ -0,0 +1,53 @@
+// Headless driver for bb::net::run_sim_benchmark, needs nothing beyond the standard library:
+//   g++ -std=c++17 -O2 -I../bb_lib main.cpp ../bb_lib/net_sim.cpp ../bb_lib/net_sim_benchmark.cpp ../bb_lib/vec2.cpp -o net_sim
+
+#include "net_sim.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+	bb::net::sim_benchmark_config config;
+
+	for (int o = 1; o < argc; o += 2)
+	{
+		string option = argv[o];
+		const char* val = o + 1 < argc ? argv[o + 1] : nullptr;
+
+		if (!val) option = "";
+		else if (option == "-clients")   config.clients = (unsigned)atoi(val);
+		else if (option == "-entities")  config.entities = (unsigned)atoi(val);
+		else if (option == "-rate")      config.tick_rate = (unsigned)atoi(val);
+		else if (option == "-active")    config.active_ticks = (unsigned)atoi(val);
+		else if (option == "-max")       config.max_ticks = (unsigned)atoi(val);
+		else if (option == "-moving")    config.moving = strtof(val, nullptr);
+		else if (option == "-batching")  config.batching = atoi(val) != 0;
+		else if (option == "-snapshots") config.snapshots = atoi(val) != 0;
+		else if (option == "-world")     config.world_size = strtof(val, nullptr);
+		else if (option == "-radius")    config.interest_radius = strtof(val, nullptr);
+		else if (option == "-interval")  config.interest_interval = (unsigned)atoi(val);
+		else if (option == "-latency")   config.link.latency = strtod(val, nullptr);
+		else if (option == "-jitter")    config.link.jitter = strtod(val, nullptr);
+		else if (option == "-loss")      config.link.loss = strtod(val, nullptr);
+		else if (option == "-bandwidth") config.link.bandwidth = strtod(val, nullptr);
+		else if (option == "-seed")      config.seed = strtoull(val, nullptr, 10);
+		else option = "";
+
+		if (option.empty())
+		{
+			cout << "usage: net_sim \\" << endl;
+			cout << "   [-clients <n>] [-entities <n>] [-rate <ticks per second>] \\" << endl;
+			cout << "   [-active <ticks>] [-max <ticks>] [-moving <0..1>] [-batching 0|1] [-snapshots 0|1] \\" << endl;
+			cout << "   [-world <size>] [-radius <interest radius>] [-interval <max interval>] \\" << endl;
+			cout << "   [-latency <s>] [-jitter <s>] [-loss <0..1>] [-bandwidth <bytes/s>] [-seed <n>]" << endl;
+			return 1;
+		}
+	}
+
+	bb::net::run_sim_benchmark(config).print(cout);
+	return 0;
+}